@@ -1,7 +1,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_FAILURE_USERMSG
 #include <STB/stb_image.h>
+#include <float.h>
 #include <iostream>
+#include <algorithm>
 #include "Cubemap_texture.h"
 #include "Util.h"
 
@@ -31,6 +33,8 @@ CubemapTexture::CubemapTexture(const string& Directory,
     m_fileNames[5] = BaseDir + NegZFilename;
 
     m_textureObj = 0;
+    // The sky is seen at grazing angles near the horizon, so it gets all the GPU supports
+    m_maxAnisotropy = FLT_MAX;
 }
 
 CubemapTexture::~CubemapTexture() {
@@ -38,28 +42,90 @@ CubemapTexture::~CubemapTexture() {
         glDeleteTextures(1, &m_textureObj);
 }
 
-bool CubemapTexture::Load() {
+bool CubemapTexture::Load(ThreadPool* pPool) {
+    const long long Start = GetCurrentTimeMicros();
     stbi_set_flip_vertically_on_load(0);
+
+    // Every face is decoded on its own thread, as RGB whatever the file has
+    unsigned char* pFaces[ARRAY_SIZE_IN_ELEMENTS(types)] = { NULL };
+    int Widths[ARRAY_SIZE_IN_ELEMENTS(types)] = { 0 };
+    int Heights[ARRAY_SIZE_IN_ELEMENTS(types)] = { 0 };
+    auto DecodeFaces = [&](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++) {
+            int bpp = 0;
+            pFaces[i] = stbi_load(m_fileNames[i].c_str(), &Widths[i], &Heights[i], &bpp, 3);
+        }
+    };
+
+    unsigned int NumThreads = 0;
+    if (pPool) {
+        pPool->ParallelFor(ARRAY_SIZE_IN_ELEMENTS(types), DecodeFaces, 1);
+        NumThreads = pPool->GetNumThreads();
+    }
+    else {
+        ThreadPool Pool;
+        Pool.ParallelFor(ARRAY_SIZE_IN_ELEMENTS(types), DecodeFaces, 1);
+        NumThreads = Pool.GetNumThreads();
+    }
+    const long long DecodeTime = GetCurrentTimeMicros() - Start;
+
+    bool Ret = true;
+    for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(types); i++) {
+        if (!pFaces[i]) {
+            // stbi keeps the failure reason per thread, so it is lost here
+            printf("Can't load texture from %s\n", m_fileNames[i].c_str());
+            Ret = false;
+        }
+        else if (Widths[i] != Widths[0] || Heights[i] != Widths[0]) {
+            printf("The cube map face %s is %dx%d, expected %dx%d\n", m_fileNames[i].c_str(), Widths[i], Heights[i], Widths[0], Widths[0]);
+            Ret = false;
+        }
+    }
+
+    if (!Ret) {
+        for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(types); i++)
+            if (pFaces[i])
+                stbi_image_free(pFaces[i]);
+        return false;
+    }
+
+    const int Size = Widths[0];
+    GLsizei NumMips = 1;
+    while ((Size >> NumMips) > 0)
+        NumMips++;
+
     glGenTextures(1, &m_textureObj);
     glBindTexture(GL_TEXTURE_CUBE_MAP, m_textureObj);
+    // The storage of all faces and levels is allocated once
+    const bool Immutable = GLEW_ARB_texture_storage != 0;
+    if (Immutable)
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, NumMips, GL_RGB8, Size, Size);
 
+    // Rows of RGB images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     for (unsigned int i = 0; i < ARRAY_SIZE_IN_ELEMENTS(types); i++) {
-        int widht = 0, height = 0, bpp = 0;
-        unsigned char* image_data = stbi_load(m_fileNames[i].c_str(), &widht, &height, &bpp, 0);
-
-        if (!image_data) {
-            printf("Can't load texture from %s - %s\n", m_fileNames[i].c_str(), stbi_failure_reason());
-            exit(0);
-        }
-        glTexImage2D(types[i], 0, GL_RGB, widht, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
+        if (Immutable)
+            glTexSubImage2D(types[i], 0, 0, 0, Size, Size, GL_RGB, GL_UNSIGNED_BYTE, pFaces[i]);
+        else
+            glTexImage2D(types[i], 0, GL_RGB8, Size, Size, 0, GL_RGB, GL_UNSIGNED_BYTE, pFaces[i]);
+        stbi_image_free(pFaces[i]);
     }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        float Supported = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &Supported);
+        glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::max(1.0f, std::min(m_maxAnisotropy, Supported)));
+    }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
+    printf("Loaded cube map %dx%d, decoded in %.2f ms on %u threads, total %.2f ms\n", Size, Size, DecodeTime / 1000.0, NumThreads,
+        (GetCurrentTimeMicros() - Start) / 1000.0);
     return true;
 }
 
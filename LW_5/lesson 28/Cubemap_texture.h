@@ -4,6 +4,8 @@
 #include <string>
 #include <GL/glew.h>
 
+#include "Thread_pool.h"
+
 using namespace std;
 
 class CubemapTexture {
@@ -18,11 +20,21 @@ public:
 
     ~CubemapTexture();
 
-    bool Load();
+    // Anisotropy of the trilinear filtering, clamped to what the GPU supports, which is also the
+    // default. Set before Load.
+    void SetMaxAnisotropy(float MaxAnisotropy) {
+        m_maxAnisotropy = MaxAnisotropy;
+    }
+
+    // Decodes the six faces in parallel on pPool, or on a pool of its own when it is NULL, then
+    // uploads them into immutable storage and builds their mip chains. The faces must be square
+    // and of the same size. Must not run on a thread of pPool.
+    bool Load(ThreadPool* pPool = NULL);
 
     void Bind(GLenum TextureUnit);
 private:
     string m_fileNames[6];
     GLuint m_textureObj;
+    float m_maxAnisotropy;
 };
 #endif	/* CUBEMAP_H */
\ No newline at end of file
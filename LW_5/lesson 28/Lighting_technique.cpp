@@ -170,8 +170,10 @@ vec3 CalcBumpedNormal()
     vec3 Tangent = normalize(Tangent0);                                                     \n\
     Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);                           \n\
     vec3 Bitangent = cross(Tangent, Normal);                                                \n\
-    vec3 BumpMapNormal = texture(gNormalMap, TexCoord0).xyz;                                \n\
-    BumpMapNormal = 2.0 * BumpMapNormal - vec3(1.0, 1.0, 1.0);                              \n\
+    // Only x and y are read, BC5 normal maps have no z                                     \n\
+    vec3 BumpMapNormal;                                                                     \n\
+    BumpMapNormal.xy = 2.0 * texture(gNormalMap, TexCoord0).xy - vec2(1.0, 1.0);            \n\
+    BumpMapNormal.z = sqrt(max(0.0, 1.0 - dot(BumpMapNormal.xy, BumpMapNormal.xy)));        \n\
     vec3 NewNormal;                                                                         \n\
     mat3 TBN = mat3(Tangent, Bitangent, Normal);                                            \n\
     NewNormal = TBN * BumpMapNormal;                                                        \n\
@@ -0,0 +1,123 @@
+#ifndef MAPPED_FILE_H
+#define	MAPPED_FILE_H
+
+#include <stddef.h>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() {
+#ifdef _WIN32
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = NULL;
+#else
+        m_fd = -1;
+#endif
+        m_pData = NULL;
+        m_size = 0;
+    }
+
+    ~MappedFile() {
+        Close();
+    }
+
+    bool Open(const std::string& Filename) {
+        Close();
+#ifdef _WIN32
+        m_file = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER Size;
+        if (!GetFileSizeEx(m_file, &Size) || Size.QuadPart == 0) {
+            Close();
+            return false;
+        }
+        m_size = (size_t)Size.QuadPart;
+
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+            m_pData = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        m_fd = open(Filename.c_str(), O_RDONLY);
+        if (m_fd < 0)
+            return false;
+
+        struct stat Info;
+        if (fstat(m_fd, &Info) != 0 || Info.st_size == 0) {
+            Close();
+            return false;
+        }
+        m_size = (size_t)Info.st_size;
+
+        void* p = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (p != MAP_FAILED)
+            m_pData = (const unsigned char*)p;
+#endif
+        if (!m_pData) {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close() {
+#ifdef _WIN32
+        if (m_pData)
+            UnmapViewOfFile(m_pData);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+        m_mapping = NULL;
+#else
+        if (m_pData)
+            munmap((void*)m_pData, m_size);
+        if (m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+#endif
+        m_pData = NULL;
+        m_size = 0;
+    }
+
+    const unsigned char* GetData() const {
+        return m_pData;
+    }
+
+    size_t GetSize() const {
+        return m_size;
+    }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+#ifdef _WIN32
+    HANDLE m_file;
+    HANDLE m_mapping;
+#else
+    int m_fd;
+#endif
+    const unsigned char* m_pData;
+    size_t m_size;
+};
+
+#endif
\ No newline at end of file
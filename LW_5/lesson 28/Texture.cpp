@@ -1,9 +1,14 @@
 #include "Texture.h"
+#include "Texture_cache.h"
+#include "Util.h"
 //#define STB_IMAGE_IMPLEMENTATION
 //#define STB_FAILURE_USERMSG
 #include <STB/stb_image.h>
 
 bool Texture::Load() {
+    if (m_compression != TEXTURE_COMPRESS_NONE)
+        return LoadCompressed();
+
     stbi_set_flip_vertically_on_load(1);
     int widht = 0, height = 0, bpp = 0;
     unsigned char* image_data = stbi_load(m_fileName.c_str(), &widht, &height, &bpp, 0);
@@ -28,5 +33,56 @@ bool Texture::Load() {
     //glTexParameterf(m_textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP);
     glBindTexture(m_textureTarget, 0);
 
+    return true;
+}
+
+bool Texture::LoadCompressed() {
+    if (m_textureTarget != GL_TEXTURE_2D) {
+        printf("Support for texture target %x is not implemented\n", m_textureTarget);
+        exit(1);
+    }
+
+    const bool NormalMap = m_compression == TEXTURE_COMPRESS_NORMAL_MAP;
+    std::vector<TextureMip> Mips;
+    std::vector<unsigned char> Data;
+    unsigned int Format = 0, FirstLevel = 0;
+    const long long Start = GetCurrentTimeMicros();
+    if (ReadTextureCache(m_fileName, NormalMap, 0, Format, Mips, FirstLevel, Data))
+        printf("Read %s from the texture cache in %.2f ms\n", m_fileName.c_str(), (GetCurrentTimeMicros() - Start) / 1000.0);
+    else {
+        stbi_set_flip_vertically_on_load(1);
+        int Width = 0, Height = 0, Channels = 0;
+        unsigned char* pPixels = stbi_load(m_fileName.c_str(), &Width, &Height, &Channels, 4);
+        if (!pPixels) {
+            printf("Can't load texture from %s - %s\n", m_fileName.c_str(), stbi_failure_reason());
+            exit(0);
+        }
+
+        if (NormalMap)
+            Format = TEXTURE_FORMAT_BC5;
+        else
+            Format = HasTransparentPixels(pPixels, Width * Height) ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+        CompressMipChain(pPixels, Width, Height, Format, NormalMap, Mips, Data);
+        stbi_image_free(pPixels);
+        printf("Compressed %s to BC%u, %u mips, in %.2f ms\n", m_fileName.c_str(), Format, (unsigned int)Mips.size(),
+            (GetCurrentTimeMicros() - Start) / 1000.0);
+        WriteTextureCache(m_fileName, NormalMap, Format, Mips, Data);
+    }
+
+    // The raw path uploads level 0 as GL_RGB
+    printf("%ux%u: %.2f KB compressed with mips, %.2f KB raw without\n", Mips[0].Width, Mips[0].Height, Data.size() / 1024.0,
+        Mips[0].Width * Mips[0].Height * 3 / 1024.0);
+
+    const GLenum InternalFormat = Format == TEXTURE_FORMAT_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+                                  Format == TEXTURE_FORMAT_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RG_RGTC2;
+    glGenTextures(1, &m_textureObj);
+    glBindTexture(m_textureTarget, m_textureObj);
+    for (unsigned int i = 0; i < Mips.size(); i++)
+        glCompressedTexImage2D(m_textureTarget, i, InternalFormat, Mips[i].Width, Mips[i].Height, 0, Mips[i].Size, &Data[Mips[i].Offset]);
+    glTexParameteri(m_textureTarget, GL_TEXTURE_MAX_LEVEL, (GLint)Mips.size() - 1);
+    glTexParameterf(m_textureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(m_textureTarget, 0);
+
     return true;
 }
\ No newline at end of file
@@ -2,15 +2,31 @@
 #define	TEXTURE_H
 
 #include <string>
+#include <vector>
 #include <GL/glew.h>
 
+#include "Texture_compressor.h"
 
+#define TEXTURE_COMPRESS_NONE       0
+#define TEXTURE_COMPRESS_COLOR      1 // BC1, or BC3 when the image has alpha
+#define TEXTURE_COMPRESS_NORMAL_MAP 2 // BC5 with x and y only, the lighting shader rebuilds z
 
 class Texture {
 public:
     Texture(GLenum TextureTarget, const std::string& FileName) {
         m_textureTarget = TextureTarget;
         m_fileName = FileName;
+        m_compression = TEXTURE_COMPRESS_NONE;
+    }
+
+    // TEXTURE_COMPRESS_*, set before Load. The compressed mip chain is encoded on the first load
+    // and read from <image>.texcache afterwards, see Texture_cache.h.
+    void SetCompression(unsigned int Compression) {
+        m_compression = Compression;
+    }
+
+    static bool IsCompressionSupported() {
+        return GLEW_EXT_texture_compression_s3tc && GLEW_ARB_texture_compression_rgtc;
     }
 
     bool Load();
@@ -21,8 +37,11 @@ public:
     }
 
 private:
+    bool LoadCompressed();
+
     std::string m_fileName;
     GLenum m_textureTarget;
     GLuint m_textureObj;
+    unsigned int m_compression;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#ifndef THREAD_POOL_H
+#define	THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    typedef std::function<void()> Task;
+    typedef std::function<void(unsigned int Begin, unsigned int End)> RangeFunc;
+
+    // NumWorkers == 0 means one worker per hardware thread except the calling one
+    ThreadPool(unsigned int NumWorkers = 0) {
+        m_stop = false;
+
+        if (NumWorkers == 0) {
+            const unsigned int NumCores = std::thread::hardware_concurrency();
+            NumWorkers = (NumCores > 1) ? NumCores - 1 : 1;
+        }
+
+        for (unsigned int i = 0; i < NumWorkers; i++)
+            m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> Lock(m_mutex);
+            m_stop = true;
+        }
+        m_taskCond.notify_all();
+
+        for (unsigned int i = 0; i < m_workers.size(); i++)
+            m_workers[i].join();
+    }
+
+    // Number of threads taking part in ParallelFor, including the calling one
+    unsigned int GetNumThreads() const {
+        return (unsigned int)m_workers.size() + 1;
+    }
+
+    void Submit(const Task& t) {
+        {
+            std::lock_guard<std::mutex> Lock(m_mutex);
+            m_tasks.push_back(t);
+        }
+        m_taskCond.notify_one();
+    }
+
+    // Splits [0, Count) into ranges and runs Func on them using the workers and the calling thread.
+    // Returns when every range has been processed.
+    void ParallelFor(unsigned int Count, const RangeFunc& Func, unsigned int MinRangeSize = 64) {
+        if (Count == 0)
+            return;
+
+        unsigned int RangeSize = Count / (GetNumThreads() * 4);
+        if (RangeSize < MinRangeSize)
+            RangeSize = MinRangeSize;
+
+        const unsigned int NumRanges = (Count + RangeSize - 1) / RangeSize;
+        unsigned int NumHelpers = NumRanges - 1;
+        if (NumHelpers > m_workers.size())
+            NumHelpers = (unsigned int)m_workers.size();
+
+        std::atomic<unsigned int> NextRange(0);
+        unsigned int NumActiveHelpers = NumHelpers;
+
+        auto ProcessRanges = [&]() {
+            for (;;) {
+                const unsigned int Range = NextRange++;
+                if (Range >= NumRanges)
+                    break;
+
+                const unsigned int Begin = Range * RangeSize;
+                const unsigned int End = (Begin + RangeSize < Count) ? Begin + RangeSize : Count;
+                Func(Begin, End);
+            }
+        };
+
+        for (unsigned int i = 0; i < NumHelpers; i++) {
+            Submit([&]() {
+                ProcessRanges();
+                std::lock_guard<std::mutex> Lock(m_mutex);
+                NumActiveHelpers--;
+                m_doneCond.notify_all();
+            });
+        }
+
+        ProcessRanges();
+
+        // The helpers reference our stack, so wait until all of them are out of it
+        std::unique_lock<std::mutex> Lock(m_mutex);
+        m_doneCond.wait(Lock, [&]() { return NumActiveHelpers == 0; });
+    }
+
+private:
+    void WorkerLoop() {
+        for (;;) {
+            Task t;
+            {
+                std::unique_lock<std::mutex> Lock(m_mutex);
+                m_taskCond.wait(Lock, [this]() { return m_stop || !m_tasks.empty(); });
+
+                if (m_stop && m_tasks.empty())
+                    return;
+
+                t = m_tasks.front();
+                m_tasks.pop_front();
+            }
+            t();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::deque<Task> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_taskCond;
+    std::condition_variable m_doneCond;
+    bool m_stop;
+};
+
+#endif
\ No newline at end of file
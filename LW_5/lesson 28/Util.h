@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <chrono>
 
 #define ZERO_MEM(a) memset(a, 0, sizeof(a))
 
@@ -25,4 +26,8 @@
 
 #define GLCheckError() (glGetError() == GL_NO_ERROR)
 
+inline long long GetCurrentTimeMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #endif
\ No newline at end of file
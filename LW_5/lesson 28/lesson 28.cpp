@@ -81,13 +81,20 @@ public:
         if (!m_pGround->LoadMesh("C:/tmp/quad.obj"))
             return false;
 
+        // The shader rebuilds the normal from x and y either way, so only the texture formats
+        // depend on the support for block compression
+        const bool Compress = Texture::IsCompressionSupported();
         m_pTexture = new Texture(GL_TEXTURE_2D, "C:/tmp/bricks.jpg");
+        if (Compress)
+            m_pTexture->SetCompression(TEXTURE_COMPRESS_COLOR);
         if (!m_pTexture->Load())
             return false;
 
         m_pTexture->Bind(COLOR_TEXTURE_UNIT);
 
         m_pNormalMap = new Texture(GL_TEXTURE_2D, "C:/tmp/normal_map.jpg");
+        if (Compress)
+            m_pNormalMap->SetCompression(TEXTURE_COMPRESS_NORMAL_MAP);
         if (!m_pNormalMap->Load())
             return false;
 
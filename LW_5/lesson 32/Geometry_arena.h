@@ -0,0 +1,247 @@
+#ifndef GEOMETRY_ARENA_H
+#define	GEOMETRY_ARENA_H
+
+#include <algorithm>
+#include <map>
+#include <GL/glew.h>
+
+#include "Util.h"
+#include "Math_3d.h"
+
+#define ARENA_INITIAL_VERTICES (1 << 18)
+#define ARENA_INITIAL_INDICES  (1 << 20)
+
+#define ARENA_INDEX_BUFFER 0
+#define ARENA_POS_VB       1
+#define ARENA_NORMAL_VB    2
+#define ARENA_TEXCOORD_VB  3
+
+// First fit allocator of element ranges. Freed ranges are merged with their free neighbours.
+class RangeAllocator {
+public:
+    void Init(unsigned int Capacity) {
+        m_freeRanges.clear();
+        m_capacity = Capacity;
+        if (Capacity > 0)
+            m_freeRanges[0] = Capacity;
+    }
+
+    bool Allocate(unsigned int Size, unsigned int& Offset) {
+        for (std::map<unsigned int, unsigned int>::iterator it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+            if (it->second < Size)
+                continue;
+
+            Offset = it->first;
+            const unsigned int Remaining = it->second - Size;
+            m_freeRanges.erase(it);
+            if (Remaining > 0)
+                m_freeRanges[Offset + Size] = Remaining;
+            return true;
+        }
+        return false;
+    }
+
+    void Free(unsigned int Offset, unsigned int Size) {
+        if (Size == 0)
+            return;
+
+        std::map<unsigned int, unsigned int>::iterator Next = m_freeRanges.lower_bound(Offset);
+        // Merge with the following free range
+        if (Next != m_freeRanges.end() && Offset + Size == Next->first) {
+            Size += Next->second;
+            Next = m_freeRanges.erase(Next);
+        }
+        // Merge with the preceding free range
+        if (Next != m_freeRanges.begin()) {
+            std::map<unsigned int, unsigned int>::iterator Prev = Next;
+            --Prev;
+            if (Prev->first + Prev->second == Offset) {
+                Prev->second += Size;
+                return;
+            }
+        }
+        m_freeRanges[Offset] = Size;
+    }
+
+    // Adds [OldCapacity, NewCapacity) as free space
+    void Grow(unsigned int NewCapacity) {
+        const unsigned int OldCapacity = m_capacity;
+        m_capacity = NewCapacity;
+        Free(OldCapacity, NewCapacity - OldCapacity);
+    }
+
+    unsigned int GetCapacity() const {
+        return m_capacity;
+    }
+
+    unsigned int GetNumFreeRanges() const {
+        return (unsigned int)m_freeRanges.size();
+    }
+
+private:
+    std::map<unsigned int, unsigned int> m_freeRanges; // Offset -> size
+    unsigned int m_capacity = 0;
+};
+
+// Process wide vertex and index storage shared by all meshes. Every mesh sub-allocates its
+// vertices and indices here, so a single VAO serves the whole scene and draws of different
+// meshes need no state change between them. The buffers grow on demand.
+class GeometryArena {
+public:
+    static GeometryArena& Get() {
+        static GeometryArena Arena;
+        return Arena;
+    }
+
+    // Returns the first vertex and index of the allocated ranges
+    bool Allocate(unsigned int NumVertices, unsigned int NumIndices, unsigned int& BaseVertex, unsigned int& BaseIndex) {
+        if (m_VAO == 0)
+            Init();
+
+        while (!m_vertices.Allocate(NumVertices, BaseVertex)) {
+            if (!GrowVertices(NumVertices))
+                return false;
+        }
+        while (!m_indices.Allocate(NumIndices, BaseIndex)) {
+            if (!GrowIndices(NumIndices)) {
+                m_vertices.Free(BaseVertex, NumVertices);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Free(unsigned int BaseVertex, unsigned int NumVertices, unsigned int BaseIndex, unsigned int NumIndices) {
+        m_vertices.Free(BaseVertex, NumVertices);
+        m_indices.Free(BaseIndex, NumIndices);
+    }
+
+    void Upload(unsigned int BaseVertex, unsigned int NumVertices,
+        const Vector3f* pPositions, const Vector3f* pNormals, const Vector2f* pTexCoords,
+        unsigned int BaseIndex, unsigned int NumIndices, const unsigned int* pIndices) {
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_POS_VB]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vector3f) * BaseVertex, sizeof(Vector3f) * NumVertices, pPositions);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_NORMAL_VB]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vector3f) * BaseVertex, sizeof(Vector3f) * NumVertices, pNormals);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_TEXCOORD_VB]);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vector2f) * BaseVertex, sizeof(Vector2f) * NumVertices, pTexCoords);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_Buffers[ARENA_INDEX_BUFFER]);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, sizeof(unsigned int) * BaseIndex, sizeof(unsigned int) * NumIndices, pIndices);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    void Bind() {
+        glBindVertexArray(m_VAO);
+    }
+
+    void Unbind() {
+        glBindVertexArray(0);
+    }
+
+    // Must be called while the GL context is still current
+    void Release() {
+        if (m_Buffers[0] != 0) {
+            glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
+            ZERO_MEM(m_Buffers);
+        }
+
+        if (m_VAO != 0) {
+            glDeleteVertexArrays(1, &m_VAO);
+            m_VAO = 0;
+        }
+    }
+
+private:
+    GeometryArena() {
+        m_VAO = 0;
+        ZERO_MEM(m_Buffers);
+    }
+
+    GeometryArena(const GeometryArena&);
+    GeometryArena& operator=(const GeometryArena&);
+
+    void Init() {
+        glGenVertexArrays(1, &m_VAO);
+        glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
+
+        m_vertices.Init(ARENA_INITIAL_VERTICES);
+        m_indices.Init(ARENA_INITIAL_INDICES);
+        AllocateBuffer(ARENA_POS_VB, GL_ARRAY_BUFFER, sizeof(Vector3f) * ARENA_INITIAL_VERTICES);
+        AllocateBuffer(ARENA_NORMAL_VB, GL_ARRAY_BUFFER, sizeof(Vector3f) * ARENA_INITIAL_VERTICES);
+        AllocateBuffer(ARENA_TEXCOORD_VB, GL_ARRAY_BUFFER, sizeof(Vector2f) * ARENA_INITIAL_VERTICES);
+        AllocateBuffer(ARENA_INDEX_BUFFER, GL_ARRAY_BUFFER, sizeof(unsigned int) * ARENA_INITIAL_INDICES);
+        SetupVAO();
+    }
+
+    void AllocateBuffer(unsigned int Index, GLenum Target, GLsizeiptr Size) {
+        glBindBuffer(Target, m_Buffers[Index]);
+        glBufferData(Target, Size, NULL, GL_STATIC_DRAW);
+        glBindBuffer(Target, 0);
+    }
+
+    // Replaces the buffer by a bigger one with the same contents
+    void GrowBuffer(unsigned int Index, GLsizeiptr OldSize, GLsizeiptr NewSize) {
+        GLuint NewBuffer = 0;
+        glGenBuffers(1, &NewBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, NewBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, NewSize, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, m_Buffers[Index]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, OldSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        glDeleteBuffers(1, &m_Buffers[Index]);
+        m_Buffers[Index] = NewBuffer;
+    }
+
+    bool GrowVertices(unsigned int MinFree) {
+        const unsigned int OldCapacity = m_vertices.GetCapacity();
+        const unsigned int NewCapacity = std::max(OldCapacity * 2, OldCapacity + MinFree);
+        GrowBuffer(ARENA_POS_VB, sizeof(Vector3f) * OldCapacity, sizeof(Vector3f) * NewCapacity);
+        GrowBuffer(ARENA_NORMAL_VB, sizeof(Vector3f) * OldCapacity, sizeof(Vector3f) * NewCapacity);
+        GrowBuffer(ARENA_TEXCOORD_VB, sizeof(Vector2f) * OldCapacity, sizeof(Vector2f) * NewCapacity);
+        m_vertices.Grow(NewCapacity);
+        SetupVAO();
+        return GLCheckError();
+    }
+
+    bool GrowIndices(unsigned int MinFree) {
+        const unsigned int OldCapacity = m_indices.GetCapacity();
+        const unsigned int NewCapacity = std::max(OldCapacity * 2, OldCapacity + MinFree);
+        GrowBuffer(ARENA_INDEX_BUFFER, sizeof(unsigned int) * OldCapacity, sizeof(unsigned int) * NewCapacity);
+        m_indices.Grow(NewCapacity);
+        SetupVAO();
+        return GLCheckError();
+    }
+
+    // The VAO keeps the buffer objects, so it is set up again whenever a buffer is replaced
+    void SetupVAO() {
+        glBindVertexArray(m_VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_POS_VB]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_TEXCOORD_VB]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[ARENA_NORMAL_VB]);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[ARENA_INDEX_BUFFER]);
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GLuint m_VAO;
+    GLuint m_Buffers[4];
+    RangeAllocator m_vertices;
+    RangeAllocator m_indices;
+};
+
+#endif
\ No newline at end of file
@@ -12,6 +12,7 @@
 #include "Util.h"
 #include "Math_3d.h"
 #include "Texture.h"
+#include "Geometry_arena.h"
 
 using namespace std;
 
@@ -30,16 +31,15 @@ struct Vertex {
 };
 
 #define INVALID_MATERIAL 0xFFFFFFFF
-#define INDEX_BUFFER 0    
-#define POS_VB       1
-#define NORMAL_VB    2
-#define TEXCOORD_VB  3       
 
+// The vertices and indices live in the shared GeometryArena, the mesh only keeps its ranges
 class Mesh {
 public:
     Mesh() {
-        m_VAO = 0;
-        ZERO_MEM(m_Buffers);
+        m_baseVertex = 0;
+        m_numVertices = 0;
+        m_baseIndex = 0;
+        m_numIndices = 0;
     }
 
     ~Mesh() {
@@ -49,11 +49,6 @@ public:
     bool LoadMesh(const std::string& Filename) {
         // Release the previously loaded mesh (if it exists)
         Clear();
-        // Create the VAO
-        glGenVertexArrays(1, &m_VAO);
-        glBindVertexArray(m_VAO);
-        // Create the buffers for the vertices attributes
-        glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
 
         bool Ret = false;
         Assimp::Importer Importer;
@@ -63,14 +58,19 @@ public:
             Ret = InitFromScene(pScene, Filename);
         else
             printf("Error parsing '%s': '%s'\n", Filename.c_str(), Importer.GetErrorString());
-        // Make sure the VAO is not changed from the outside
-        glBindVertexArray(0);
         return Ret;
     }
 
     void Render() {
-        glBindVertexArray(m_VAO);
+        GeometryArena::Get().Bind();
+        Draw();
+        // Make sure the VAO is not changed from the outside
+        GeometryArena::Get().Unbind();
+    }
 
+    // Issues the draws without touching the VAO. Several meshes can be drawn in a row after a
+    // single GeometryArena::Bind().
+    void Draw() {
         for (unsigned int i = 0; i < m_Entries.size(); i++) {
             const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
 
@@ -84,8 +84,6 @@ public:
                 (void*)(sizeof(unsigned int) * m_Entries[i].BaseIndex),
                 m_Entries[i].BaseVertex);
         }
-        // Make sure the VAO is not changed from the outside    
-        glBindVertexArray(0);
     }
 
 private:
@@ -124,24 +122,23 @@ private:
 
         if (!InitMaterials(pScene, Filename))
             return false;
-        // Generate and populate the buffers with vertex attributes and the indices
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        // Without faces there is nothing to draw and no range to take from the arena
+        if (NumVertices == 0 || NumIndices == 0)
+            return true;
+        // Sub-allocate the ranges in the shared buffers and move the entries into them
+        GeometryArena& Arena = GeometryArena::Get();
+        if (!Arena.Allocate(NumVertices, NumIndices, m_baseVertex, m_baseIndex))
+            return false;
+        m_numVertices = NumVertices;
+        m_numIndices = NumIndices;
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            m_Entries[i].BaseVertex += m_baseVertex;
+            m_Entries[i].BaseIndex += m_baseIndex;
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
+        Arena.Upload(m_baseVertex, NumVertices, Positions.data(), Normals.data(), TexCoords.data(),
+            m_baseIndex, NumIndices, Indices.data());
 
         return GLCheckError();
     }
@@ -211,18 +208,19 @@ private:
     void Clear() {
         for (unsigned int i = 0; i < m_Textures.size(); i++)
             SAFE_DELETE(m_Textures[i]);
-
-        if (m_Buffers[0] != 0)
-            glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
-
-        if (m_VAO != 0) {
-            glDeleteVertexArrays(1, &m_VAO);
-            m_VAO = 0;
+        // Return the ranges to the arena for reuse by the next mesh
+        if (m_numVertices != 0 || m_numIndices != 0) {
+            GeometryArena::Get().Free(m_baseVertex, m_numVertices, m_baseIndex, m_numIndices);
+            m_numVertices = 0;
+            m_numIndices = 0;
         }
+        m_Entries.clear();
     }
 
-    GLuint m_VAO;
-    GLuint m_Buffers[4];
+    unsigned int m_baseVertex;
+    unsigned int m_numVertices;
+    unsigned int m_baseIndex;
+    unsigned int m_numIndices;
 
     struct MeshEntry {
         MeshEntry() {
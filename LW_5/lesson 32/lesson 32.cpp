@@ -42,6 +42,7 @@ public:
         SAFE_DELETE(m_pMesh1);
         SAFE_DELETE(m_pMesh2);
         SAFE_DELETE(m_pMesh3);
+        GeometryArena::Get().Release();
     }
 
     bool Init() {
@@ -93,24 +94,28 @@ public:
         p.SetCamera(m_pGameCamera->GetPos(), m_pGameCamera->GetTarget(), m_pGameCamera->GetUp());
         p.Rotate(0.0f, m_scale, 0.0f);
         p.SetPerspectiveProj(m_persProjInfo);
+        // All the meshes share the arena VAO, so it is bound once for the whole scene
+        GeometryArena::Get().Bind();
 
         p.Scale(0.05f, 0.05f, 0.05f);
         p.WorldPos(-6.0f, -2.0f, 10.0f);
         m_pEffect->SetWVP(p.GetWVPTrans());
         m_pEffect->SetWorldMatrix(p.GetWorldTrans());
-        m_pMesh1->Render();
+        m_pMesh1->Draw();
 
         p.Scale(0.01f, 0.01f, 0.01f);
         p.WorldPos(6.0f, -2.0f, 10.0f);
         m_pEffect->SetWVP(p.GetWVPTrans());
         m_pEffect->SetWorldMatrix(p.GetWorldTrans());
-        m_pMesh2->Render();
+        m_pMesh2->Draw();
 
         p.Scale(0.04f, 0.04f, 0.04f);
         p.WorldPos(0.0f, 6.0f, 10.0f);
         m_pEffect->SetWVP(p.GetWVPTrans());
         m_pEffect->SetWorldMatrix(p.GetWorldTrans());
-        m_pMesh3->Render();
+        m_pMesh3->Draw();
+
+        GeometryArena::Get().Unbind();
 
         glutSwapBuffers();
     }
@@ -0,0 +1,392 @@
+#ifndef BENCHMARK_H
+#define	BENCHMARK_H
+
+#include <stdio.h>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "Util.h"
+#include "Math_3d.h"
+#include "Pipeline.h"
+#include "Thread_pool.h"
+#include "Mapped_file.h"
+#include "Gltf_loader.h"
+#include "Obj_loader.h"
+#include "Texture_cache.h"
+#include <STB/stb_image.h>
+
+// CPU micro benchmarks, run with "-bench" on the command line instead of opening the window
+
+static void InitRandomMatrices(std::vector<Matrix4f>& Mats) {
+    for (unsigned int i = 0; i < Mats.size(); i++)
+        for (unsigned int j = 0; j < 4; j++)
+            for (unsigned int k = 0; k < 4; k++)
+                Mats[i].m[j][k] = (float)(rand() % 1000) / 1000.0f;
+}
+
+static float Checksum(const std::vector<Matrix4f>& Mats) {
+    float Sum = 0.0f;
+    for (unsigned int i = 0; i < Mats.size(); i++)
+        Sum += Mats[i].m[0][0] + Mats[i].m[3][3];
+    return Sum;
+}
+
+static void BenchmarkMatrixMul() {
+    const unsigned int NumMatrices = 1024; // Must be a power of two
+    const unsigned int NumPasses = 10000;
+
+    std::vector<Matrix4f> Left(NumMatrices), Right(NumMatrices), Result(NumMatrices);
+    InitRandomMatrices(Left);
+    InitRandomMatrices(Right);
+
+    long long Start = GetCurrentTimeMicros();
+    for (unsigned int Pass = 0; Pass < NumPasses; Pass++)
+        for (unsigned int i = 0; i < NumMatrices; i++)
+            Result[i] = Left[i].MulScalar(Right[(i + Pass) & (NumMatrices - 1)]);
+    long long ScalarTime = GetCurrentTimeMicros() - Start;
+    float ScalarSum = Checksum(Result);
+
+    Start = GetCurrentTimeMicros();
+    for (unsigned int Pass = 0; Pass < NumPasses; Pass++)
+        for (unsigned int i = 0; i < NumMatrices; i++)
+            Result[i] = Left[i] * Right[(i + Pass) & (NumMatrices - 1)];
+    long long SimdTime = GetCurrentTimeMicros() - Start;
+    float SimdSum = Checksum(Result);
+
+    const double NumMuls = (double)NumMatrices * NumPasses;
+#if defined(MATH_3D_AVX)
+    const char* pPath = "AVX";
+#elif defined(MATH_3D_SSE)
+    const char* pPath = "SSE";
+#else
+    const char* pPath = "scalar";
+#endif
+    printf("Matrix4f multiply: scalar %.1f M/s, %s %.1f M/s (checksum %f / %f)\n",
+        NumMuls / (double)(ScalarTime + 1), pPath, NumMuls / (double)(SimdTime + 1), ScalarSum, SimdSum);
+}
+
+static void InitBenchmarkPipeline(Pipeline& p) {
+    PersProjInfo PersProj = { 60.0f, 1280.0f, 1024.0f, 1.0f, 100.0f };
+    p.SetCamera(Vector3f(7.0f, 3.0f, 0.0f), Vector3f(0.0f, -0.2f, 1.0f), Vector3f(0.0f, 1.0f, 0.0f));
+    p.SetPerspectiveProj(PersProj);
+    p.Rotate(0.0f, 90.0f, 0.0f);
+    p.Scale(0.005f, 0.005f, 0.005f);
+}
+
+static void BenchmarkInstanceTrans() {
+    const unsigned int NumInstances = 100000;
+
+    std::vector<Vector3f> Positions(NumInstances);
+    for (unsigned int i = 0; i < NumInstances; i++)
+        Positions[i] = Vector3f((float)(i % 100), (float)(rand() % 5), (float)(i / 100));
+
+    std::vector<Matrix4f> WVPMats(NumInstances), WorldMats(NumInstances);
+    Pipeline p;
+    InitBenchmarkPipeline(p);
+
+    long long Start = GetCurrentTimeMicros();
+    for (unsigned int i = 0; i < NumInstances; i++) {
+        p.WorldPos(Positions[i]);
+        WVPMats[i] = p.GetWVPTrans().Transpose();
+        WorldMats[i] = p.GetWorldTrans().Transpose();
+    }
+    long long PerInstanceTime = GetCurrentTimeMicros() - Start;
+    float PerInstanceSum = Checksum(WVPMats);
+
+    Start = GetCurrentTimeMicros();
+    p.GetInstanceTrans(NumInstances, &Positions[0], NULL, NULL, &WVPMats[0], &WorldMats[0]);
+    long long BatchTime = GetCurrentTimeMicros() - Start;
+    float BatchSum = Checksum(WVPMats);
+
+    printf("%u instance transforms: per instance %.2f ms, batched %.2f ms (checksum %f / %f)\n",
+        NumInstances, PerInstanceTime / 1000.0, BatchTime / 1000.0, PerInstanceSum, BatchSum);
+}
+
+static void BenchmarkParallelInstanceTrans() {
+    static const unsigned int Sizes[] = { 1000, 10000, 100000, 1000000 };
+
+    ThreadPool Pool;
+    Pipeline p;
+    InitBenchmarkPipeline(p);
+    p.PrepareInstanceTrans();
+
+    for (unsigned int s = 0; s < ARRAY_SIZE_IN_ELEMENTS(Sizes); s++) {
+        const unsigned int NumInstances = Sizes[s];
+
+        std::vector<Vector3f> Base(NumInstances), Positions(NumInstances);
+        std::vector<float> Velocity(NumInstances);
+        for (unsigned int i = 0; i < NumInstances; i++) {
+            Base[i] = Vector3f((float)(i % 1000), (float)(rand() % 5), (float)(i / 1000));
+            Velocity[i] = (float)(rand() % 100) / 100.0f;
+        }
+        std::vector<Matrix4f> WVPMats(NumInstances), WorldMats(NumInstances);
+
+        auto Update = [&](unsigned int Begin, unsigned int End) {
+            const float Offset = sinf(0.5f);
+            for (unsigned int i = Begin; i < End; i++) {
+                Positions[i] = Base[i];
+                Positions[i].y += Offset * Velocity[i];
+            }
+            p.CalcInstanceTrans(Begin, End, &Positions[0], NULL, NULL, &WVPMats[0], &WorldMats[0]);
+        };
+
+        Update(0, NumInstances); // Warm up the caches and the page tables
+
+        long long Start = GetCurrentTimeMicros();
+        Update(0, NumInstances);
+        long long SerialTime = GetCurrentTimeMicros() - Start;
+
+        Start = GetCurrentTimeMicros();
+        Pool.ParallelFor(NumInstances, Update);
+        long long ParallelTime = GetCurrentTimeMicros() - Start;
+
+        printf("%7u instances: 1 thread %.2f ms, %u threads %.2f ms (x%.1f)\n", NumInstances, SerialTime / 1000.0,
+            Pool.GetNumThreads(), ParallelTime / 1000.0, (double)SerialTime / (double)(ParallelTime + 1));
+    }
+}
+
+// CPU side of loading a GLB file into the Mesh arrays: Assimp import and copy against the native
+// reader, which uses the mapped file in place when it can. Run with "-bench-glb <file.glb>".
+static void BenchmarkGlbLoad(const char* pFilename) {
+    const unsigned int NumRuns = 5;
+    long long AssimpTime = 0;
+    long long NativeTime = 0;
+    unsigned int AssimpVertices = 0;
+    unsigned int NativeVertices = 0;
+    bool InPlace = false;
+
+    for (unsigned int Run = 0; Run < NumRuns; Run++) {
+        long long Start = GetCurrentTimeMicros();
+        {
+            Assimp::Importer Importer;
+            const aiScene* pScene = Importer.ReadFile(pFilename, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+            if (!pScene) {
+                printf("Error parsing '%s': '%s'\n", pFilename, Importer.GetErrorString());
+                return;
+            }
+
+            std::vector<Vector3f> Positions, Normals;
+            std::vector<Vector2f> TexCoords;
+            std::vector<unsigned int> Indices;
+            for (unsigned int i = 0; i < pScene->mNumMeshes; i++) {
+                const aiMesh* paiMesh = pScene->mMeshes[i];
+                for (unsigned int v = 0; v < paiMesh->mNumVertices; v++) {
+                    const aiVector3D& p = paiMesh->mVertices[v];
+                    const aiVector3D& n = paiMesh->mNormals[v];
+                    Positions.push_back(Vector3f(p.x, p.y, p.z));
+                    Normals.push_back(Vector3f(n.x, n.y, n.z));
+                    TexCoords.push_back(paiMesh->HasTextureCoords(0) ?
+                        Vector2f(paiMesh->mTextureCoords[0][v].x, paiMesh->mTextureCoords[0][v].y) : Vector2f(0.0f, 0.0f));
+                }
+                for (unsigned int f = 0; f < paiMesh->mNumFaces; f++)
+                    Indices.insert(Indices.end(), paiMesh->mFaces[f].mIndices, paiMesh->mFaces[f].mIndices + 3);
+            }
+            AssimpVertices = (unsigned int)Positions.size();
+        }
+        AssimpTime += GetCurrentTimeMicros() - Start;
+
+        Start = GetCurrentTimeMicros();
+        {
+            MappedFile File;
+            GltfFile Gltf;
+            if (!File.Open(pFilename) || !ReadGlb(File.GetData(), File.GetSize(), ".", Gltf)) {
+                printf("Error parsing '%s'\n", pFilename);
+                return;
+            }
+
+            const Vector3f* pPositions;
+            const Vector3f* pNormals;
+            const Vector2f* pTexCoords;
+            const unsigned int* pIndices;
+            InPlace = GetGltfArraysInPlace(Gltf, pPositions, pNormals, pTexCoords, pIndices);
+
+            NativeVertices = 0;
+            unsigned int NumIndices = 0;
+            for (unsigned int i = 0; i < Gltf.Primitives.size(); i++) {
+                NativeVertices += Gltf.Primitives[i].Positions.Count;
+                NumIndices += GetGltfNumIndices(Gltf.Primitives[i]);
+            }
+
+            if (!InPlace) {
+                std::vector<Vector3f> Positions(NativeVertices), Normals(NativeVertices);
+                std::vector<Vector2f> TexCoords(NativeVertices);
+                std::vector<unsigned int> Indices(NumIndices);
+                unsigned int BaseVertex = 0;
+                unsigned int BaseIndex = 0;
+                for (unsigned int i = 0; i < Gltf.Primitives.size(); i++) {
+                    CopyGltfPrimitive(Gltf.Primitives[i], Positions.data() + BaseVertex, Normals.data() + BaseVertex,
+                        TexCoords.data() + BaseVertex, Indices.data() + BaseIndex);
+                    BaseVertex += Gltf.Primitives[i].Positions.Count;
+                    BaseIndex += GetGltfNumIndices(Gltf.Primitives[i]);
+                }
+            }
+        }
+        NativeTime += GetCurrentTimeMicros() - Start;
+    }
+
+    printf("GLB load of %u vertices: Assimp %.2f ms, native %.2f ms %s(x%.1f)\n", NativeVertices,
+        AssimpTime / 1000.0 / NumRuns, NativeTime / 1000.0 / NumRuns, InPlace ? "in place " : "",
+        (double)AssimpTime / (double)(NativeTime + 1));
+    if (AssimpVertices != NativeVertices)
+        printf("Assimp returned %u vertices\n", AssimpVertices);
+}
+
+// Assimp against the chunked OBJ reader on one thread and on the pool
+static void BenchmarkObjLoad(const char* pFilename) {
+    const unsigned int NumRuns = 5;
+    ThreadPool Pool;
+    long long AssimpTime = 0;
+    long long NativeTime[2] = { 0, 0 };
+    unsigned int AssimpVertices = 0;
+    unsigned int NativeVertices = 0;
+
+    for (unsigned int Run = 0; Run < NumRuns; Run++) {
+        long long Start = GetCurrentTimeMicros();
+        {
+            Assimp::Importer Importer;
+            const aiScene* pScene = Importer.ReadFile(pFilename, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+            if (!pScene) {
+                printf("Error parsing '%s': '%s'\n", pFilename, Importer.GetErrorString());
+                return;
+            }
+
+            AssimpVertices = 0;
+            for (unsigned int i = 0; i < pScene->mNumMeshes; i++)
+                AssimpVertices += pScene->mMeshes[i]->mNumVertices;
+        }
+        AssimpTime += GetCurrentTimeMicros() - Start;
+
+        for (unsigned int p = 0; p < 2; p++) {
+            Start = GetCurrentTimeMicros();
+            MappedFile File;
+            ObjFile Obj;
+            if (!File.Open(pFilename) || !ReadObj(File.GetData(), File.GetSize(), ".", p == 0 ? NULL : &Pool, Obj)) {
+                printf("Error parsing '%s'\n", pFilename);
+                return;
+            }
+            NativeVertices = (unsigned int)Obj.Positions.size();
+            NativeTime[p] += GetCurrentTimeMicros() - Start;
+        }
+    }
+
+    printf("OBJ load: Assimp %.2f ms (%u vertices), native %.2f ms on 1 thread, %.2f ms on %u threads (%u vertices)\n",
+        AssimpTime / 1000.0 / NumRuns, AssimpVertices, NativeTime[0] / 1000.0 / NumRuns, NativeTime[1] / 1000.0 / NumRuns,
+        Pool.GetNumThreads(), NativeVertices);
+}
+
+// Color part of level 0 of a BC1 or BC3 image back to RGBA8, to measure the encoder error
+static void DecodeColorBlocks(const unsigned char* pBlocks, unsigned int Format, unsigned int Width, unsigned int Height,
+    std::vector<unsigned char>& Pixels) {
+    Pixels.resize(Width * Height * 4);
+    const unsigned int BlockSize = GetBlockSize(Format);
+    for (unsigned int y = 0; y < Height; y += 4) {
+        for (unsigned int x = 0; x < Width; x += 4, pBlocks += BlockSize) {
+            const unsigned char* pColor = pBlocks + BlockSize - 8;
+            int Palette[4][3];
+            UnpackColor565((unsigned short)(pColor[0] | (pColor[1] << 8)), Palette[0]);
+            UnpackColor565((unsigned short)(pColor[2] | (pColor[3] << 8)), Palette[1]);
+            for (unsigned int c = 0; c < 3; c++) {
+                Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+                Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+            }
+
+            const unsigned int Indices = pColor[4] | (pColor[5] << 8) | (pColor[6] << 16) | ((unsigned int)pColor[7] << 24);
+            for (unsigned int i = 0; i < 16; i++) {
+                const unsigned int px = x + (i & 3);
+                const unsigned int py = y + (i >> 2);
+                if (px >= Width || py >= Height)
+                    continue;
+                unsigned char* p = &Pixels[(py * Width + px) * 4];
+                for (unsigned int c = 0; c < 3; c++)
+                    p[c] = (unsigned char)Palette[(Indices >> (i * 2)) & 3][c];
+                p[3] = 255;
+            }
+        }
+    }
+}
+
+static double CalcColorPSNR(const unsigned char* pA, const unsigned char* pB, unsigned int NumPixels) {
+    double Error = 0.0;
+    for (unsigned int i = 0; i < NumPixels; i++) {
+        for (unsigned int c = 0; c < 3; c++) {
+            const double d = (double)pA[i * 4 + c] - pB[i * 4 + c];
+            Error += d * d;
+        }
+    }
+    Error /= NumPixels * 3.0;
+    return Error > 0.0 ? 10.0 * log10(255.0 * 255.0 / Error) : 99.0;
+}
+
+// Memory and load time of the raw texture path against the block compressed one. Writes the
+// texture cache of the image like the first compressed load in the demo. The sampling cost is
+// measured in the demo itself: compare the GPU draw time with and without -bc.
+static void BenchmarkTextureLoad(const char* pFilename) {
+    const unsigned int NumRuns = 5;
+    int Width = 0, Height = 0, Channels = 0;
+    unsigned char* pPixels = NULL;
+
+    long long DecodeTime = 0;
+    for (unsigned int Run = 0; Run < NumRuns; Run++) {
+        if (pPixels)
+            stbi_image_free(pPixels);
+        long long Start = GetCurrentTimeMicros();
+        pPixels = stbi_load(pFilename, &Width, &Height, &Channels, 4);
+        DecodeTime += GetCurrentTimeMicros() - Start;
+        if (!pPixels) {
+            printf("Can't load texture from %s - %s\n", pFilename, stbi_failure_reason());
+            return;
+        }
+    }
+
+    // The raw path uploads level 0 only, in the channels of the file
+    const double RawSize = (double)Width * Height * Channels;
+
+    const unsigned int NumPixels = (unsigned int)(Width * Height);
+    const unsigned int ColorFormat = HasTransparentPixels(pPixels, NumPixels) ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+    const unsigned int Formats[2] = { ColorFormat, TEXTURE_FORMAT_BC5 };
+    std::vector<TextureMip> Mips[2];
+    std::vector<unsigned char> Data[2];
+    long long EncodeTime[2] = { 0, 0 };
+    for (unsigned int f = 0; f < 2; f++) {
+        for (unsigned int Run = 0; Run < NumRuns; Run++) {
+            long long Start = GetCurrentTimeMicros();
+            CompressMipChain(pPixels, Width, Height, Formats[f], f == 1, Mips[f], Data[f]);
+            EncodeTime[f] += GetCurrentTimeMicros() - Start;
+        }
+    }
+
+    std::vector<unsigned char> Decoded;
+    DecodeColorBlocks(&Data[0][0], ColorFormat, Width, Height, Decoded);
+    const double PSNR = CalcColorPSNR(pPixels, &Decoded[0], NumPixels);
+    stbi_image_free(pPixels);
+
+    long long CacheTime = 0;
+    if (WriteTextureCache(pFilename, false, ColorFormat, Mips[0], Data[0])) {
+        for (unsigned int Run = 0; Run < NumRuns; Run++) {
+            unsigned int Format = 0, FirstLevel = 0;
+            long long Start = GetCurrentTimeMicros();
+            if (!ReadTextureCache(pFilename, false, 0, Format, Mips[0], FirstLevel, Data[0])) {
+                printf("Error reading the texture cache of '%s'\n", pFilename);
+                return;
+            }
+            CacheTime += GetCurrentTimeMicros() - Start;
+        }
+    }
+
+    const double MB = 1024.0 * 1024.0;
+    printf("Texture '%s' %dx%d: raw %.2f MB without mips, decode %.2f ms\n", pFilename, Width, Height, RawSize / MB, DecodeTime / 1000.0 / NumRuns);
+    printf("  BC%u %.2f MB with %u mips, encode %.2f ms, PSNR %.2f dB, cache load %.2f ms\n", ColorFormat, Data[0].size() / MB,
+        (unsigned int)Mips[0].size(), EncodeTime[0] / 1000.0 / NumRuns, PSNR, CacheTime / 1000.0 / NumRuns);
+    printf("  BC5 %.2f MB with %u mips, encode %.2f ms (as a normal map)\n", Data[1].size() / MB, (unsigned int)Mips[1].size(),
+        EncodeTime[1] / 1000.0 / NumRuns);
+}
+
+static void RunBenchmarks() {
+    BenchmarkMatrixMul();
+    BenchmarkInstanceTrans();
+    BenchmarkParallelInstanceTrans();
+}
+
+#endif
\ No newline at end of file
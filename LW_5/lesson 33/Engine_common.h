@@ -12,4 +12,6 @@
 #define DISPLACEMENT_TEXTURE_UNIT       GL_TEXTURE4
 #define DISPLACEMENT_TEXTURE_UNIT_INDEX 4
 
+#define MESH_MAX_MULTI_DRAW_ENTRIES 64 // Size of the per-entry material table of the multi draw shaders
+
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef FRUSTUM_H
+#define	FRUSTUM_H
+
+#include <math.h>
+
+#include "Math_3d.h"
+
+#define FRUSTUM_NUM_PLANES 6
+
+// Axis aligned box and the sphere around it, in model space
+struct BoundingVolume {
+    BoundingVolume() {
+        Min = Vector3f(0.0f, 0.0f, 0.0f);
+        Max = Vector3f(0.0f, 0.0f, 0.0f);
+        Center = Vector3f(0.0f, 0.0f, 0.0f);
+        Radius = 0.0f;
+    }
+
+    Vector3f Min;
+    Vector3f Max;
+    Vector3f Center;
+    float Radius;
+};
+
+// The six clip planes of a view projection matrix in world space, taken from the rows of the
+// matrix (Gribb/Hartmann). The planes are normalized and their normals point into the frustum.
+class Frustum {
+public:
+    // Usually called with Pipeline::GetVPTrans()
+    void Init(const Matrix4f& VP) {
+        for (unsigned int i = 0; i < 3; i++) {
+            // Row 3 + row i gives the left, bottom and near plane, row 3 - row i the opposite one
+            for (unsigned int Side = 0; Side < 2; Side++) {
+                const float Sign = Side == 0 ? 1.0f : -1.0f;
+                Vector4f& Plane = m_planes[i * 2 + Side];
+                Plane.x = VP.m[3][0] + Sign * VP.m[i][0];
+                Plane.y = VP.m[3][1] + Sign * VP.m[i][1];
+                Plane.z = VP.m[3][2] + Sign * VP.m[i][2];
+                Plane.w = VP.m[3][3] + Sign * VP.m[i][3];
+
+                const float Length = sqrtf(Plane.x * Plane.x + Plane.y * Plane.y + Plane.z * Plane.z);
+                if (Length > 0.0f) {
+                    Plane.x /= Length;
+                    Plane.y /= Length;
+                    Plane.z /= Length;
+                    Plane.w /= Length;
+                }
+            }
+        }
+    }
+
+    // Conservative: true when the sphere is not entirely outside one of the planes
+    bool IsSphereVisible(const Vector3f& Center, float Radius) const {
+        for (unsigned int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+            const Vector4f& p = m_planes[i];
+            if (p.x * Center.x + p.y * Center.y + p.z * Center.z + p.w < -Radius)
+                return false;
+        }
+        return true;
+    }
+
+    // Tests the corner of the box furthest along every plane normal
+    bool IsBoxVisible(const Vector3f& Min, const Vector3f& Max) const {
+        for (unsigned int i = 0; i < FRUSTUM_NUM_PLANES; i++) {
+            const Vector4f& p = m_planes[i];
+            const float x = p.x >= 0.0f ? Max.x : Min.x;
+            const float y = p.y >= 0.0f ? Max.y : Min.y;
+            const float z = p.z >= 0.0f ? Max.z : Min.z;
+            if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // Plane i as (normal, distance), the order is left, right, bottom, top, near, far
+    const Vector4f& GetPlane(unsigned int i) const {
+        return m_planes[i];
+    }
+
+private:
+    Vector4f m_planes[FRUSTUM_NUM_PLANES];
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,614 @@
+#ifndef GLTF_LOADER_H
+#define	GLTF_LOADER_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Util.h"
+#include "Math_3d.h"
+
+// Reader for binary glTF 2.0 files (.glb). The file is used in place: the accessors point into
+// the BIN chunk of the mapped file, so when the arrays already have the layout of the Mesh
+// buffers they are uploaded without any copy. Only triangle lists with float positions, normals
+// and texcoords are supported, and only the base color texture of the materials is used.
+
+#define GLB_MAGIC      0x46546C67 // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN  0x004E4942
+
+#define GLTF_FLOAT          5126
+#define GLTF_UNSIGNED_BYTE  5121
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT   5125
+#define GLTF_TRIANGLES      4
+
+#define JSON_MAX_DEPTH 64
+
+// Minimal JSON document, enough for the glTF chunk
+struct JsonValue {
+    enum {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT
+    };
+
+    JsonValue() {
+        Type = JSON_NULL;
+        Number = 0.0;
+    }
+
+    const JsonValue* Find(const char* pKey) const {
+        if (Type != JSON_OBJECT)
+            return NULL;
+        for (unsigned int i = 0; i < Keys.size(); i++)
+            if (Keys[i] == pKey)
+                return &Items[i];
+        return NULL;
+    }
+
+    const JsonValue* At(int Index) const {
+        return (Type == JSON_ARRAY && Index >= 0 && Index < (int)Items.size()) ? &Items[Index] : NULL;
+    }
+
+    unsigned int Size() const {
+        return Type == JSON_ARRAY ? (unsigned int)Items.size() : 0;
+    }
+
+    int GetInt(const char* pKey, int Default) const {
+        const JsonValue* p = Find(pKey);
+        return (p && p->Type == JSON_NUMBER) ? (int)p->Number : Default;
+    }
+
+    std::string GetString(const char* pKey) const {
+        const JsonValue* p = Find(pKey);
+        return (p && p->Type == JSON_STRING) ? p->String : std::string();
+    }
+
+    int Type;
+    double Number;                // Also 0 or 1 for booleans
+    std::string String;
+    std::vector<JsonValue> Items; // Array elements or object values
+    std::vector<std::string> Keys; // Object keys, one per item
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* pBegin, const char* pEnd) {
+        m_p = pBegin;
+        m_pEnd = pEnd;
+    }
+
+    bool Parse(JsonValue& Value) {
+        if (!ParseValue(Value, 0))
+            return false;
+        // The GLB JSON chunk is padded with spaces
+        SkipSpace();
+        return m_p == m_pEnd;
+    }
+
+private:
+    void SkipSpace() {
+        while (m_p < m_pEnd && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+            m_p++;
+    }
+
+    bool Match(const char* pWord) {
+        const size_t Length = strlen(pWord);
+        if ((size_t)(m_pEnd - m_p) < Length || strncmp(m_p, pWord, Length) != 0)
+            return false;
+        m_p += Length;
+        return true;
+    }
+
+    bool ParseValue(JsonValue& Value, unsigned int Depth) {
+        SkipSpace();
+        if (m_p >= m_pEnd || Depth > JSON_MAX_DEPTH)
+            return false;
+
+        switch (*m_p) {
+        case '{':
+            return ParseObject(Value, Depth);
+        case '[':
+            return ParseArray(Value, Depth);
+        case '"':
+            Value.Type = JsonValue::JSON_STRING;
+            return ParseString(Value.String);
+        case 't':
+            Value.Type = JsonValue::JSON_BOOL;
+            Value.Number = 1.0;
+            return Match("true");
+        case 'f':
+            Value.Type = JsonValue::JSON_BOOL;
+            return Match("false");
+        case 'n':
+            return Match("null");
+        default:
+            Value.Type = JsonValue::JSON_NUMBER;
+            return ParseNumber(Value.Number);
+        }
+    }
+
+    bool ParseObject(JsonValue& Value, unsigned int Depth) {
+        Value.Type = JsonValue::JSON_OBJECT;
+        m_p++;
+        SkipSpace();
+        if (m_p < m_pEnd && *m_p == '}') {
+            m_p++;
+            return true;
+        }
+
+        for (;;) {
+            SkipSpace();
+            std::string Key;
+            if (m_p >= m_pEnd || *m_p != '"' || !ParseString(Key))
+                return false;
+            SkipSpace();
+            if (m_p >= m_pEnd || *m_p++ != ':')
+                return false;
+
+            Value.Keys.push_back(Key);
+            Value.Items.push_back(JsonValue());
+            if (!ParseValue(Value.Items.back(), Depth + 1))
+                return false;
+
+            SkipSpace();
+            if (m_p >= m_pEnd)
+                return false;
+            if (*m_p == '}') {
+                m_p++;
+                return true;
+            }
+            if (*m_p++ != ',')
+                return false;
+        }
+    }
+
+    bool ParseArray(JsonValue& Value, unsigned int Depth) {
+        Value.Type = JsonValue::JSON_ARRAY;
+        m_p++;
+        SkipSpace();
+        if (m_p < m_pEnd && *m_p == ']') {
+            m_p++;
+            return true;
+        }
+
+        for (;;) {
+            Value.Items.push_back(JsonValue());
+            if (!ParseValue(Value.Items.back(), Depth + 1))
+                return false;
+
+            SkipSpace();
+            if (m_p >= m_pEnd)
+                return false;
+            if (*m_p == ']') {
+                m_p++;
+                return true;
+            }
+            if (*m_p++ != ',')
+                return false;
+        }
+    }
+
+    static void AppendUtf8(std::string& s, unsigned int c) {
+        if (c < 0x80)
+            s += (char)c;
+        else if (c < 0x800) {
+            s += (char)(0xC0 | (c >> 6));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000) {
+            s += (char)(0xE0 | (c >> 12));
+            s += (char)(0x80 | ((c >> 6) & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+        else {
+            s += (char)(0xF0 | (c >> 18));
+            s += (char)(0x80 | ((c >> 12) & 0x3F));
+            s += (char)(0x80 | ((c >> 6) & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    bool ParseHex4(unsigned int& c) {
+        if (m_pEnd - m_p < 4)
+            return false;
+        c = 0;
+        for (unsigned int i = 0; i < 4; i++) {
+            const char h = *m_p++;
+            c <<= 4;
+            if (h >= '0' && h <= '9')
+                c |= h - '0';
+            else if (h >= 'a' && h <= 'f')
+                c |= h - 'a' + 10;
+            else if (h >= 'A' && h <= 'F')
+                c |= h - 'A' + 10;
+            else
+                return false;
+        }
+        return true;
+    }
+
+    bool ParseString(std::string& s) {
+        m_p++;
+        while (m_p < m_pEnd && *m_p != '"') {
+            if (*m_p != '\\') {
+                s += *m_p++;
+                continue;
+            }
+
+            if (++m_p >= m_pEnd)
+                return false;
+            const char Escape = *m_p++;
+            switch (Escape) {
+            case 'b': s += '\b'; break;
+            case 'f': s += '\f'; break;
+            case 'n': s += '\n'; break;
+            case 'r': s += '\r'; break;
+            case 't': s += '\t'; break;
+            case 'u': {
+                unsigned int c;
+                if (!ParseHex4(c))
+                    return false;
+                // Surrogate pair
+                if (c >= 0xD800 && c < 0xDC00 && m_pEnd - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+                    m_p += 2;
+                    unsigned int Low;
+                    if (!ParseHex4(Low))
+                        return false;
+                    c = 0x10000 + ((c - 0xD800) << 10) + (Low - 0xDC00);
+                }
+                AppendUtf8(s, c);
+                break;
+            }
+            default:
+                s += Escape;
+            }
+        }
+
+        if (m_p >= m_pEnd)
+            return false;
+        m_p++;
+        return true;
+    }
+
+    bool ParseNumber(double& Number) {
+        char Text[64];
+        unsigned int Length = 0;
+        while (m_p < m_pEnd && Length + 1 < sizeof(Text) && strchr("0123456789+-.eE", *m_p) && *m_p)
+            Text[Length++] = *m_p++;
+        Text[Length] = 0;
+
+        char* pEnd = NULL;
+        Number = strtod(Text, &pEnd);
+        return Length > 0 && pEnd == Text + Length;
+    }
+
+    const char* m_p;
+    const char* m_pEnd;
+};
+
+// Typed view of an accessor inside the BIN chunk
+struct GltfAccessor {
+    GltfAccessor() {
+        pData = NULL;
+        Count = 0;
+        ComponentType = 0;
+        NumComponents = 0;
+        Stride = 0;
+    }
+
+    unsigned int GetElementSize() const {
+        const unsigned int ComponentSize = ComponentType == GLTF_UNSIGNED_BYTE ? 1 : (ComponentType == GLTF_UNSIGNED_SHORT ? 2 : 4);
+        return ComponentSize * NumComponents;
+    }
+
+    // Elements are packed without padding
+    bool IsTight() const {
+        return Stride == GetElementSize();
+    }
+
+    const unsigned char* pData;
+    unsigned int Count;
+    unsigned int ComponentType;
+    unsigned int NumComponents;
+    unsigned int Stride;
+};
+
+struct GltfPrimitive {
+    GltfAccessor Positions;
+    GltfAccessor Normals;   // Count is 0 when the file has no normals
+    GltfAccessor TexCoords; // Count is 0 when the file has no texcoords
+    GltfAccessor Indices;   // Count is 0 for non indexed primitives
+    unsigned int MaterialIndex;
+};
+
+// Base color image of a material: a file next to the model or a range of the BIN chunk
+struct GltfImage {
+    GltfImage() {
+        pData = NULL;
+        Size = 0;
+    }
+
+    std::string Path;
+    const unsigned char* pData;
+    size_t Size;
+};
+
+struct GltfFile {
+    std::vector<GltfPrimitive> Primitives;
+    std::vector<GltfImage> MaterialImages; // One per material, plus the default material when used
+};
+
+static bool ReadGltfAccessor(const JsonValue& Root, const unsigned char* pBin, size_t BinSize, int Index,
+    unsigned int NumComponents, GltfAccessor& Accessor) {
+    const JsonValue* pAccessor = Root.Find("accessors") ? Root.Find("accessors")->At(Index) : NULL;
+    if (!pAccessor)
+        return false;
+
+    const JsonValue* pView = Root.Find("bufferViews") ? Root.Find("bufferViews")->At(pAccessor->GetInt("bufferView", -1)) : NULL;
+    // Sparse accessors and accessors without a buffer view are not supported
+    if (!pView || pView->GetInt("buffer", 0) != 0 || pAccessor->Find("sparse"))
+        return false;
+
+    static const char* TypeNames[] = { "", "SCALAR", "VEC2", "VEC3", "VEC4" };
+    if (NumComponents >= ARRAY_SIZE_IN_ELEMENTS(TypeNames) || pAccessor->GetString("type") != TypeNames[NumComponents])
+        return false;
+
+    Accessor.Count = (unsigned int)pAccessor->GetInt("count", 0);
+    Accessor.ComponentType = (unsigned int)pAccessor->GetInt("componentType", 0);
+    Accessor.NumComponents = NumComponents;
+    const size_t Offset = (size_t)pView->GetInt("byteOffset", 0) + (size_t)pAccessor->GetInt("byteOffset", 0);
+    const size_t ViewEnd = (size_t)pView->GetInt("byteOffset", 0) + (size_t)pView->GetInt("byteLength", 0);
+    Accessor.Stride = (unsigned int)pView->GetInt("byteStride", 0);
+    if (Accessor.Stride == 0)
+        Accessor.Stride = Accessor.GetElementSize();
+
+    if (Accessor.Count == 0)
+        return true;
+    // The last element must lie inside both the buffer view and the BIN chunk
+    const size_t End = Offset + (size_t)Accessor.Stride * (Accessor.Count - 1) + Accessor.GetElementSize();
+    if (End > ViewEnd || End > BinSize)
+        return false;
+
+    Accessor.pData = pBin + Offset;
+    return true;
+}
+
+// Splits the mapped GLB file into primitives and material images. Dir is the directory of the
+// file, used for the images stored next to it.
+static bool ReadGlb(const unsigned char* pFile, size_t FileSize, const std::string& Dir, GltfFile& File) {
+    unsigned int Header[5];
+    if (FileSize < sizeof(Header))
+        return false;
+    memcpy(Header, pFile, sizeof(Header));
+    if (Header[0] != GLB_MAGIC || Header[1] != 2 || Header[2] > FileSize || Header[4] != GLB_CHUNK_JSON ||
+        sizeof(Header) + (size_t)Header[3] > Header[2]) {
+        printf("Not a glTF 2.0 binary file\n");
+        return false;
+    }
+
+    const char* pJson = (const char*)pFile + sizeof(Header);
+    JsonValue Root;
+    JsonParser Parser(pJson, pJson + Header[3]);
+    if (!Parser.Parse(Root)) {
+        printf("Invalid glTF JSON chunk\n");
+        return false;
+    }
+
+    // The BIN chunk follows the JSON chunk
+    const unsigned char* pBin = NULL;
+    size_t BinSize = 0;
+    const size_t BinHeader = sizeof(Header) + Header[3];
+    if (BinHeader + 8 <= Header[2]) {
+        unsigned int Chunk[2];
+        memcpy(Chunk, pFile + BinHeader, sizeof(Chunk));
+        if (Chunk[1] == GLB_CHUNK_BIN && BinHeader + 8 + Chunk[0] <= Header[2]) {
+            pBin = pFile + BinHeader + 8;
+            BinSize = Chunk[0];
+        }
+    }
+
+    // Materials with their base color image
+    const JsonValue* pMaterials = Root.Find("materials");
+    const JsonValue* pTextures = Root.Find("textures");
+    const JsonValue* pImages = Root.Find("images");
+    const JsonValue* pViews = Root.Find("bufferViews");
+    const unsigned int NumMaterials = pMaterials ? pMaterials->Size() : 0;
+    File.MaterialImages.resize(NumMaterials);
+
+    for (unsigned int i = 0; i < NumMaterials; i++) {
+        const JsonValue* pPbr = pMaterials->At(i)->Find("pbrMetallicRoughness");
+        const JsonValue* pBaseColor = pPbr ? pPbr->Find("baseColorTexture") : NULL;
+        const JsonValue* pTexture = (pBaseColor && pTextures) ? pTextures->At(pBaseColor->GetInt("index", -1)) : NULL;
+        const JsonValue* pImage = (pTexture && pImages) ? pImages->At(pTexture->GetInt("source", -1)) : NULL;
+        if (!pImage)
+            continue;
+
+        const std::string Uri = pImage->GetString("uri");
+        const JsonValue* pView = pViews ? pViews->At(pImage->GetInt("bufferView", -1)) : NULL;
+        if (!Uri.empty() && Uri.compare(0, 5, "data:") != 0)
+            File.MaterialImages[i].Path = Dir + "/" + Uri;
+        else if (pView && pBin) {
+            const size_t Offset = (size_t)pView->GetInt("byteOffset", 0);
+            const size_t Size = (size_t)pView->GetInt("byteLength", 0);
+            if (Offset + Size <= BinSize) {
+                char Name[32];
+                SNPRINTF(Name, sizeof(Name), "#image%d", pTexture->GetInt("source", -1));
+                File.MaterialImages[i].Path = Name;
+                File.MaterialImages[i].pData = pBin + Offset;
+                File.MaterialImages[i].Size = Size;
+            }
+        }
+        else
+            printf("Unsupported image in material %u\n", i);
+    }
+
+    // Every triangle primitive of every mesh becomes an entry. Like the Assimp path, the node
+    // transforms are not applied.
+    const JsonValue* pMeshes = Root.Find("meshes");
+    bool DefaultMaterial = false;
+    for (unsigned int m = 0; pMeshes && m < pMeshes->Size(); m++) {
+        const JsonValue* pPrimitives = pMeshes->At(m)->Find("primitives");
+
+        for (unsigned int p = 0; pPrimitives && p < pPrimitives->Size(); p++) {
+            const JsonValue& Primitive = *pPrimitives->At(p);
+            const JsonValue* pAttributes = Primitive.Find("attributes");
+            if (Primitive.GetInt("mode", GLTF_TRIANGLES) != GLTF_TRIANGLES || !pAttributes || !pAttributes->Find("POSITION")) {
+                printf("Skipping a glTF primitive which is not a triangle list\n");
+                continue;
+            }
+
+            GltfPrimitive Prim;
+            if (!ReadGltfAccessor(Root, pBin, BinSize, pAttributes->GetInt("POSITION", -1), 3, Prim.Positions) ||
+                (pAttributes->Find("NORMAL") && !ReadGltfAccessor(Root, pBin, BinSize, pAttributes->GetInt("NORMAL", -1), 3, Prim.Normals)) ||
+                (pAttributes->Find("TEXCOORD_0") && !ReadGltfAccessor(Root, pBin, BinSize, pAttributes->GetInt("TEXCOORD_0", -1), 2, Prim.TexCoords)) ||
+                (Primitive.Find("indices") && !ReadGltfAccessor(Root, pBin, BinSize, Primitive.GetInt("indices", -1), 1, Prim.Indices))) {
+                printf("Invalid accessor in glTF mesh %u\n", m);
+                return false;
+            }
+
+            if (Prim.Positions.ComponentType != GLTF_FLOAT ||
+                (Prim.Normals.Count > 0 && (Prim.Normals.ComponentType != GLTF_FLOAT || Prim.Normals.Count != Prim.Positions.Count)) ||
+                (Prim.TexCoords.Count > 0 && (Prim.TexCoords.ComponentType != GLTF_FLOAT || Prim.TexCoords.Count != Prim.Positions.Count))) {
+                printf("Unsupported vertex format in glTF mesh %u\n", m);
+                return false;
+            }
+
+            const int Material = Primitive.GetInt("material", -1);
+            if (Material < 0 || Material >= (int)NumMaterials) {
+                Prim.MaterialIndex = NumMaterials;
+                DefaultMaterial = true;
+            }
+            else
+                Prim.MaterialIndex = (unsigned int)Material;
+
+            File.Primitives.push_back(Prim);
+        }
+    }
+
+    if (DefaultMaterial)
+        File.MaterialImages.push_back(GltfImage());
+
+    return true;
+}
+
+// Number of indices of the primitive, also for non indexed ones
+inline unsigned int GetGltfNumIndices(const GltfPrimitive& Prim) {
+    return Prim.Indices.Count > 0 ? Prim.Indices.Count : Prim.Positions.Count;
+}
+
+// When every array of every primitive has the type and the layout of the Mesh buffers and the
+// primitives follow each other in the file, the mapped file can be used as is.
+static bool GetGltfArraysInPlace(const GltfFile& File, const Vector3f*& pPositions, const Vector3f*& pNormals,
+    const Vector2f*& pTexCoords, const unsigned int*& pIndices) {
+    if (File.Primitives.empty())
+        return false;
+
+    for (unsigned int i = 0; i < File.Primitives.size(); i++) {
+        const GltfPrimitive& Prim = File.Primitives[i];
+        if (Prim.Positions.Count == 0 || Prim.Normals.Count == 0 || Prim.TexCoords.Count == 0 ||
+            Prim.Indices.ComponentType != GLTF_UNSIGNED_INT ||
+            !Prim.Positions.IsTight() || !Prim.Normals.IsTight() || !Prim.TexCoords.IsTight() || !Prim.Indices.IsTight())
+            return false;
+
+        // The float and index arrays are read directly, so they must be 4 byte aligned
+        if (((size_t)Prim.Positions.pData | (size_t)Prim.Normals.pData | (size_t)Prim.TexCoords.pData | (size_t)Prim.Indices.pData) & 3)
+            return false;
+
+        if (i > 0) {
+            const GltfPrimitive& Prev = File.Primitives[i - 1];
+            if (Prim.Positions.pData != Prev.Positions.pData + sizeof(Vector3f) * Prev.Positions.Count ||
+                Prim.Normals.pData != Prev.Normals.pData + sizeof(Vector3f) * Prev.Normals.Count ||
+                Prim.TexCoords.pData != Prev.TexCoords.pData + sizeof(Vector2f) * Prev.TexCoords.Count ||
+                Prim.Indices.pData != Prev.Indices.pData + sizeof(unsigned int) * Prev.Indices.Count)
+                return false;
+        }
+
+        // Broken indices would make the GPU read outside the vertex buffer
+        const unsigned int* pPrimIndices = (const unsigned int*)Prim.Indices.pData;
+        for (unsigned int j = 0; j < Prim.Indices.Count; j++)
+            if (pPrimIndices[j] >= Prim.Positions.Count)
+                return false;
+    }
+
+    pPositions = (const Vector3f*)File.Primitives[0].Positions.pData;
+    pNormals = (const Vector3f*)File.Primitives[0].Normals.pData;
+    pTexCoords = (const Vector2f*)File.Primitives[0].TexCoords.pData;
+    pIndices = (const unsigned int*)File.Primitives[0].Indices.pData;
+    return true;
+}
+
+// Area weighted vertex normals, for the primitives without normals
+static void CalcGltfNormals(const unsigned int* pIndices, unsigned int NumIndices, const Vector3f* pPositions,
+    unsigned int NumVertices, Vector3f* pNormals) {
+    for (unsigned int i = 0; i < NumVertices; i++)
+        pNormals[i] = Vector3f(0.0f, 0.0f, 0.0f);
+
+    for (unsigned int i = 0; i + 2 < NumIndices; i += 3) {
+        const unsigned int a = pIndices[i], b = pIndices[i + 1], c = pIndices[i + 2];
+        if (a >= NumVertices || b >= NumVertices || c >= NumVertices)
+            continue;
+        const Vector3f n = (pPositions[b] - pPositions[a]).Cross(pPositions[c] - pPositions[a]);
+        pNormals[a] += n;
+        pNormals[b] += n;
+        pNormals[c] += n;
+    }
+
+    for (unsigned int i = 0; i < NumVertices; i++) {
+        const Vector3f& n = pNormals[i];
+        const float Length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+        pNormals[i] = Length > 0.0f ? n * (1.0f / Length) : Vector3f(0.0f, 1.0f, 0.0f);
+    }
+}
+
+// Converts one primitive into the Mesh arrays: tight floats, 32 bit indices and generated
+// normals when the file has none
+static void CopyGltfPrimitive(const GltfPrimitive& Prim, Vector3f* pPositions, Vector3f* pNormals,
+    Vector2f* pTexCoords, unsigned int* pIndices) {
+    const unsigned int NumVertices = Prim.Positions.Count;
+
+    for (unsigned int i = 0; i < NumVertices; i++)
+        memcpy(&pPositions[i], Prim.Positions.pData + (size_t)Prim.Positions.Stride * i, sizeof(Vector3f));
+
+    for (unsigned int i = 0; i < NumVertices; i++) {
+        if (Prim.TexCoords.Count > 0)
+            memcpy(&pTexCoords[i], Prim.TexCoords.pData + (size_t)Prim.TexCoords.Stride * i, sizeof(Vector2f));
+        else
+            pTexCoords[i] = Vector2f(0.0f, 0.0f);
+    }
+
+    const unsigned int NumIndices = GetGltfNumIndices(Prim);
+    for (unsigned int i = 0; i < NumIndices; i++) {
+        const unsigned char* p = Prim.Indices.pData + (size_t)Prim.Indices.Stride * i;
+        if (Prim.Indices.Count == 0)
+            pIndices[i] = i;
+        else if (Prim.Indices.ComponentType == GLTF_UNSIGNED_BYTE)
+            pIndices[i] = *p;
+        else if (Prim.Indices.ComponentType == GLTF_UNSIGNED_SHORT) {
+            unsigned short Index;
+            memcpy(&Index, p, sizeof(Index));
+            pIndices[i] = Index;
+        }
+        else
+            memcpy(&pIndices[i], p, sizeof(unsigned int));
+        // Keep broken files from reading outside the vertex buffer
+        if (pIndices[i] >= NumVertices)
+            pIndices[i] = 0;
+    }
+
+    if (Prim.Normals.Count > 0) {
+        for (unsigned int i = 0; i < NumVertices; i++)
+            memcpy(&pNormals[i], Prim.Normals.pData + (size_t)Prim.Normals.Stride * i, sizeof(Vector3f));
+    }
+    else
+        CalcGltfNormals(pIndices, NumIndices, pPositions, NumVertices, pNormals);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef GPU_TIMER_H
+#define	GPU_TIMER_H
+
+#include <GL/glew.h>
+
+#define GPU_TIMER_NUM_QUERIES 4 // Frames in flight before a result is read
+
+// GPU time of a range of GL commands, averaged over the frames since the last Reset. The result
+// of a frame is read a few frames later so that the render thread never waits for the GPU.
+class GpuTimer {
+public:
+    GpuTimer() {
+        for (unsigned int i = 0; i < GPU_TIMER_NUM_QUERIES; i++) {
+            m_queries[i] = 0;
+            m_pending[i] = false;
+        }
+        m_next = 0;
+        m_totalTime = 0;
+        m_numFrames = 0;
+    }
+
+    // Must be called while the GL context is still current
+    ~GpuTimer() {
+        if (m_queries[0] != 0)
+            glDeleteQueries(GPU_TIMER_NUM_QUERIES, m_queries);
+    }
+
+    void Begin() {
+        if (m_queries[0] == 0)
+            glGenQueries(GPU_TIMER_NUM_QUERIES, m_queries);
+
+        // The oldest query is reused, its result must be in by now
+        if (m_pending[m_next]) {
+            GLuint64 Time = 0;
+            glGetQueryObjectui64v(m_queries[m_next], GL_QUERY_RESULT, &Time);
+            m_totalTime += Time;
+            m_numFrames++;
+            m_pending[m_next] = false;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, m_queries[m_next]);
+    }
+
+    void End() {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_pending[m_next] = true;
+        m_next = (m_next + 1) % GPU_TIMER_NUM_QUERIES;
+    }
+
+    double GetAverageMillis() const {
+        return m_numFrames ? m_totalTime / 1000000.0 / m_numFrames : 0.0;
+    }
+
+    void Reset() {
+        m_totalTime = 0;
+        m_numFrames = 0;
+    }
+
+private:
+    GLuint m_queries[GPU_TIMER_NUM_QUERIES];
+    bool m_pending[GPU_TIMER_NUM_QUERIES];
+    unsigned int m_next;
+    GLuint64 m_totalTime;
+    unsigned int m_numFrames;
+};
+
+#endif
\ No newline at end of file
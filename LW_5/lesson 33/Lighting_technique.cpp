@@ -1,3 +1,4 @@
+#include <assert.h>
 #include <limits.h>
 #include <string.h>
 
@@ -14,18 +15,99 @@ layout (location = 2) in vec3 Normal;
 layout (location = 3) in mat4 WVP;                                                  \n\
 layout (location = 7) in mat4 World;                                                \n\
                                                                                     \n\
+// Quantized vertices, see Mesh::GetPositionDecode and Mesh_quantizer.h             \n\
+uniform vec3 gPosOffset = vec3(0.0);                                                \n\
+uniform vec3 gPosScale = vec3(1.0);                                                 \n\
+uniform bool gOctNormals = false;                                                   \n\
+                                                                                    \n\
 out vec2 TexCoord0;                                                                 \n\
 out vec3 Normal0;                                                                   \n\
 out vec3 WorldPos0;                                                                 \n\
 flat out int InstanceID;                                                            \n\
+#ifdef MULTI_DRAW                                                                   \n\
+// Texture array layer of every entry, the draws go LOD after LOD                   \n\
+uniform int gEntryMaterials[MAX_DRAW_ENTRIES];                                      \n\
+uniform int gNumEntries;                                                            \n\
+flat out int MaterialLayer;                                                         \n\
+#endif                                                                              \n\
+                                                                                    \n\
+vec3 OctDecode(vec2 e)                                                              \n\
+{                                                                                   \n\
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));                                    \n\
+    vec2 s = vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);                \n\
+    if (n.z < 0.0)                                                                  \n\
+        n.xy = (1.0 - abs(e.yx)) * s;                                               \n\
+    return normalize(n);                                                            \n\
+}                                                                                   \n\
                                                                                     \n\
 void main()                                                                         \n\
 {                                                                                   \n\
-    gl_Position = WVP * vec4(Position, 1.0);                                        \n\
+    vec3 Pos = gPosOffset + Position * gPosScale;                                   \n\
+    vec3 N = gOctNormals ? OctDecode(Normal.xy) : Normal;                           \n\
+    gl_Position = WVP * vec4(Pos, 1.0);                                             \n\
     TexCoord0   = TexCoord;                                                         \n\
-    Normal0     = (World * vec4(Normal, 0.0)).xyz;                                  \n\
-    WorldPos0   = (World * vec4(Position, 1.0)).xyz;                                \n\
+    Normal0     = (World * vec4(N, 0.0)).xyz;                                       \n\
+    WorldPos0   = (World * vec4(Pos, 1.0)).xyz;                                     \n\
     InstanceID = gl_InstanceID;                                                     \n\
+#ifdef MULTI_DRAW                                                                   \n\
+    MaterialLayer = gEntryMaterials[gl_DrawIDARB % gNumEntries];                    \n\
+#endif                                                                              \n\
+}";
+
+// Builds World and WVP from a compact per-instance translation, rotation quaternion and scale
+static const char* pVSCompact = "                                                          \n\
+#version 410                                                                        \n\
+                                                                                    \n\
+layout (location = 0) in vec3 Position;                                             \n\
+layout (location = 1) in vec2 TexCoord;                                             \n\
+layout (location = 2) in vec3 Normal;                                               \n\
+layout (location = 11) in vec3 InstancePos;                                         \n\
+layout (location = 12) in vec4 InstanceRot;                                         \n\
+layout (location = 13) in vec3 InstanceScale;                                       \n\
+                                                                                    \n\
+uniform mat4 gVP;                                                                   \n\
+// Quantized vertices, see Mesh::GetPositionDecode and Mesh_quantizer.h             \n\
+uniform vec3 gPosOffset = vec3(0.0);                                                \n\
+uniform vec3 gPosScale = vec3(1.0);                                                 \n\
+uniform bool gOctNormals = false;                                                   \n\
+                                                                                    \n\
+out vec2 TexCoord0;                                                                 \n\
+out vec3 Normal0;                                                                   \n\
+out vec3 WorldPos0;                                                                 \n\
+flat out int InstanceID;                                                            \n\
+#ifdef MULTI_DRAW                                                                   \n\
+// Texture array layer of every entry, the draws go LOD after LOD                   \n\
+uniform int gEntryMaterials[MAX_DRAW_ENTRIES];                                      \n\
+uniform int gNumEntries;                                                            \n\
+flat out int MaterialLayer;                                                         \n\
+#endif                                                                              \n\
+                                                                                    \n\
+vec3 QuatRotate(vec4 q, vec3 v)                                                     \n\
+{                                                                                   \n\
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);                       \n\
+}                                                                                   \n\
+                                                                                    \n\
+vec3 OctDecode(vec2 e)                                                              \n\
+{                                                                                   \n\
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));                                    \n\
+    vec2 s = vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);                \n\
+    if (n.z < 0.0)                                                                  \n\
+        n.xy = (1.0 - abs(e.yx)) * s;                                               \n\
+    return normalize(n);                                                            \n\
+}                                                                                   \n\
+                                                                                    \n\
+void main()                                                                         \n\
+{                                                                                   \n\
+    vec3 Pos = gPosOffset + Position * gPosScale;                                   \n\
+    vec3 N = gOctNormals ? OctDecode(Normal.xy) : Normal;                           \n\
+    WorldPos0   = QuatRotate(InstanceRot, Pos * InstanceScale) + InstancePos;       \n\
+    gl_Position = gVP * vec4(WorldPos0, 1.0);                                       \n\
+    TexCoord0   = TexCoord;                                                         \n\
+    Normal0     = QuatRotate(InstanceRot, N * InstanceScale);                       \n\
+    InstanceID = gl_InstanceID;                                                     \n\
+#ifdef MULTI_DRAW                                                                   \n\
+    MaterialLayer = gEntryMaterials[gl_DrawIDARB % gNumEntries];                    \n\
+#endif                                                                              \n\
 }";
 
 static const char* pFS = "                                                          \n\
@@ -38,6 +120,9 @@ in vec2 TexCoord0;
 in vec3 Normal0;                                                                    \n\
 in vec3 WorldPos0;                                                                  \n\
 flat in int InstanceID;                                                             \n\
+#ifdef MULTI_DRAW                                                                   \n\
+flat in int MaterialLayer;                                                          \n\
+#endif                                                                              \n\
                                                                                     \n\
 out vec4 FragColor;                                                                 \n\
                                                                                     \n\
@@ -80,7 +165,11 @@ uniform int gNumSpotLights;
 uniform DirectionalLight gDirectionalLight;                                                 \n\
 uniform PointLight gPointLights[MAX_POINT_LIGHTS];                                          \n\
 uniform SpotLight gSpotLights[MAX_SPOT_LIGHTS];                                             \n\
+#ifdef MULTI_DRAW                                                                           \n\
+uniform sampler2DArray gColorMap;                                                           \n\
+#else                                                                                       \n\
 uniform sampler2D gColorMap;                                                                \n\
+#endif                                                                                      \n\
 uniform vec3 gEyeWorldPos;                                                                  \n\
 uniform float gMatSpecularIntensity;                                                        \n\
 uniform float gSpecularPower;                                                               \n\
@@ -156,17 +245,34 @@ void main()
         TotalLight += CalcSpotLight(gSpotLights[i], Normal);                                \n\
     }                                                                                       \n\
                                                                                             \n\
-    FragColor = texture(gColorMap, TexCoord0.xy) * TotalLight * gColor[InstanceID % 4];     \n\
+#ifdef MULTI_DRAW                                                                           \n\
+    vec4 Color = texture(gColorMap, vec3(TexCoord0.xy, MaterialLayer));                     \n\
+#else                                                                                       \n\
+    vec4 Color = texture(gColorMap, TexCoord0.xy);                                          \n\
+#endif                                                                                      \n\
+    FragColor = Color * TotalLight * gColor[InstanceID % 4];                                \n\
 }";
 
-LightingTechnique::LightingTechnique() {}
+// MAX_DRAW_ENTRIES is filled in from the class constant
+static const char* pMultiDrawDefines = "\
+#extension GL_ARB_shader_draw_parameters : require\n\
+#define MULTI_DRAW\n\
+#define MAX_DRAW_ENTRIES %u\n";
+
+LightingTechnique::LightingTechnique(bool CompactInstances, bool MultiDraw) {
+    m_compactInstances = CompactInstances;
+    m_multiDraw = MultiDraw;
+}
 
 bool LightingTechnique::Init() {
     if (!Technique::Init())
         return false;
-    if (!AddShader(GL_VERTEX_SHADER, pVS))
+    char MultiDrawDefines[128];
+    SNPRINTF(MultiDrawDefines, sizeof(MultiDrawDefines), pMultiDrawDefines, MAX_DRAW_ENTRIES);
+    const char* pDefines = m_multiDraw ? MultiDrawDefines : NULL;
+    if (!AddShader(GL_VERTEX_SHADER, m_compactInstances ? pVSCompact : pVS, pDefines))
         return false;
-    if (!AddShader(GL_FRAGMENT_SHADER, pFS))
+    if (!AddShader(GL_FRAGMENT_SHADER, pFS, pDefines))
         return false;
     if (!Finalize())
         return false;
@@ -181,6 +287,22 @@ bool LightingTechnique::Init() {
     m_matSpecularPowerLocation = GetUniformLocation("gSpecularPower");
     m_numPointLightsLocation = GetUniformLocation("gNumPointLights");
     m_numSpotLightsLocation = GetUniformLocation("gNumSpotLights");
+    m_posOffsetLocation = GetUniformLocation("gPosOffset");
+    m_posScaleLocation = GetUniformLocation("gPosScale");
+    m_octNormalsLocation = GetUniformLocation("gOctNormals");
+
+    if (m_compactInstances) {
+        m_VPLocation = GetUniformLocation("gVP");
+        if (m_VPLocation == INVALID_UNIFORM_LOCATION)
+            return false;
+    }
+
+    if (m_multiDraw) {
+        m_entryMaterialsLocation = GetUniformLocation("gEntryMaterials");
+        m_numEntriesLocation = GetUniformLocation("gNumEntries");
+        if (m_entryMaterialsLocation == INVALID_UNIFORM_LOCATION || m_numEntriesLocation == INVALID_UNIFORM_LOCATION)
+            return false;
+    }
 
     if (m_dirLightLocation.AmbientIntensity == INVALID_UNIFORM_LOCATION ||
         m_colorTextureLocation == INVALID_UNIFORM_LOCATION ||
@@ -191,7 +313,10 @@ bool LightingTechnique::Init() {
         m_matSpecularIntensityLocation == INVALID_UNIFORM_LOCATION ||
         m_matSpecularPowerLocation == INVALID_UNIFORM_LOCATION ||
         m_numPointLightsLocation == INVALID_UNIFORM_LOCATION ||
-        m_numSpotLightsLocation == INVALID_UNIFORM_LOCATION) {
+        m_numSpotLightsLocation == INVALID_UNIFORM_LOCATION ||
+        m_posOffsetLocation == INVALID_UNIFORM_LOCATION ||
+        m_posScaleLocation == INVALID_UNIFORM_LOCATION ||
+        m_octNormalsLocation == INVALID_UNIFORM_LOCATION) {
         return false;
     }
 
@@ -286,6 +411,22 @@ bool LightingTechnique::Init() {
 }
 
 
+void LightingTechnique::SetVP(const Matrix4f& VP) {
+    glUniformMatrix4fv(m_VPLocation, 1, GL_TRUE, (const GLfloat*)VP.m);
+}
+
+void LightingTechnique::SetVertexDecode(const Vector3f& PosOffset, const Vector3f& PosScale, bool OctNormals) {
+    glUniform3f(m_posOffsetLocation, PosOffset.x, PosOffset.y, PosOffset.z);
+    glUniform3f(m_posScaleLocation, PosScale.x, PosScale.y, PosScale.z);
+    glUniform1i(m_octNormalsLocation, OctNormals ? 1 : 0);
+}
+
+void LightingTechnique::SetEntryMaterials(unsigned int NumEntries, const int* pMaterials) {
+    assert(NumEntries > 0 && NumEntries <= MAX_DRAW_ENTRIES);
+    glUniform1iv(m_entryMaterialsLocation, NumEntries, pMaterials);
+    glUniform1i(m_numEntriesLocation, NumEntries);
+}
+
 void LightingTechnique::SetColorTextureUnit(unsigned int TextureUnit) {
     glUniform1i(m_colorTextureLocation, TextureUnit);
 }
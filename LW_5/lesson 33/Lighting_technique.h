@@ -2,6 +2,7 @@
 #define	LIGHTING_TECHNIQUE_H
 
 #include "Technique.h"
+#include "Engine_common.h"
 #include "Math_3d.h"
 
 struct BaseLight {
@@ -55,11 +56,20 @@ class LightingTechnique : public Technique {
 public:
     static const unsigned int MAX_POINT_LIGHTS = 2;
     static const unsigned int MAX_SPOT_LIGHTS = 2;
+    static const unsigned int MAX_DRAW_ENTRIES = MESH_MAX_MULTI_DRAW_ENTRIES;
 
-    LightingTechnique();
+    // CompactInstances selects the vertex shader that takes the InstanceTRS attributes and the
+    // VP matrix instead of the WVP and World matrices per instance. MultiDraw selects the shaders
+    // for Mesh::IsMultiDraw, which sample a texture array with the layer picked by gl_DrawID.
+    LightingTechnique(bool CompactInstances = false, bool MultiDraw = false);
 
     virtual bool Init();
 
+    void SetVP(const Matrix4f& VP);
+    // Decoding of quantized vertices, the defaults are for float positions and normals
+    void SetVertexDecode(const Vector3f& PosOffset, const Vector3f& PosScale, bool OctNormals);
+    // Texture array layer of every mesh entry, only with MultiDraw
+    void SetEntryMaterials(unsigned int NumEntries, const int* pMaterials);
     void SetColorTextureUnit(unsigned int TextureUnit);
     void SetDirectionalLight(const DirectionalLight& Light);
     void SetPointLights(unsigned int NumLights, const PointLight* pLights);
@@ -70,6 +80,14 @@ public:
     void SetColor(unsigned int Index, const Vector4f& Color);
 
 private:
+    bool m_compactInstances;
+    bool m_multiDraw;
+    GLuint m_entryMaterialsLocation;
+    GLuint m_numEntriesLocation;
+    GLuint m_VPLocation;
+    GLuint m_posOffsetLocation;
+    GLuint m_posScaleLocation;
+    GLuint m_octNormalsLocation;
     GLuint m_colorTextureLocation;
     GLuint m_eyeWorldPosLocation;
     GLuint m_matSpecularIntensityLocation;
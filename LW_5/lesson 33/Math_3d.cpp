@@ -118,6 +118,18 @@ Quaternion::Quaternion(float _x, float _y, float _z, float _w) {
     w = _w;
 }
 
+void Quaternion::InitRotation(float RotateX, float RotateY, float RotateZ) {
+    const float x = ToRadian(RotateX) / 2.0f;
+    const float y = ToRadian(RotateY) / 2.0f;
+    const float z = ToRadian(RotateZ) / 2.0f;
+    // InitRotateTransform builds rz * ry * rx where ry turns by -RotateY around the Y axis
+    const Quaternion qx(sinf(x), 0.0f, 0.0f, cosf(x));
+    const Quaternion qy(0.0f, -sinf(y), 0.0f, cosf(y));
+    const Quaternion qz(0.0f, 0.0f, sinf(z), cosf(z));
+
+    *this = qz * qy * qx;
+}
+
 void Quaternion::Normalize() {
     float Length = sqrtf(x * x + y * y + z * z + w * w);
 
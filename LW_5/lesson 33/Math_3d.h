@@ -5,6 +5,23 @@
 #include <cstdlib>
 #include <math.h>
 
+// SIMD kernels for Matrix4f are chosen at compile time. Define MATH_3D_NO_SIMD
+// to force the scalar code path.
+#if !defined(MATH_3D_NO_SIMD)
+#if defined(__AVX__)
+#define MATH_3D_AVX
+#define MATH_3D_SSE
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATH_3D_SSE
+#endif
+#endif
+
+#if defined(MATH_3D_AVX)
+#include <immintrin.h>
+#elif defined(MATH_3D_SSE)
+#include <xmmintrin.h>
+#endif
+
 #define ToRadian(x) ((x) * 3.14f / 180.0f)
 #define ToDegree(x) ((x) * 180.0f / 3.14f)
 
@@ -117,7 +134,7 @@ struct PersProjInfo {
     float zFar;
 };
 
-class Matrix4f {
+class alignas(16) Matrix4f {
 public:
     float m[4][4];
 
@@ -131,6 +148,24 @@ public:
     }
 
     Matrix4f Transpose() const {
+#ifdef MATH_3D_SSE
+        Matrix4f n;
+        __m128 r0 = _mm_load_ps(m[0]);
+        __m128 r1 = _mm_load_ps(m[1]);
+        __m128 r2 = _mm_load_ps(m[2]);
+        __m128 r3 = _mm_load_ps(m[3]);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_store_ps(n.m[0], r0);
+        _mm_store_ps(n.m[1], r1);
+        _mm_store_ps(n.m[2], r2);
+        _mm_store_ps(n.m[3], r3);
+        return n;
+#else
+        return TransposeScalar();
+#endif
+    }
+
+    Matrix4f TransposeScalar() const {
         Matrix4f n;
         for (unsigned int i = 0; i < 4; i++)
             for (unsigned int j = 0; j < 4; j++)
@@ -139,6 +174,45 @@ public:
     }
 
     inline Matrix4f operator*(const Matrix4f& Right) const {
+#if defined(MATH_3D_AVX)
+        // Two rows of the result per iteration: every 128-bit lane holds one row
+        Matrix4f Ret;
+        const __m256 r0 = _mm256_broadcast_ps((const __m128*)Right.m[0]);
+        const __m256 r1 = _mm256_broadcast_ps((const __m128*)Right.m[1]);
+        const __m256 r2 = _mm256_broadcast_ps((const __m128*)Right.m[2]);
+        const __m256 r3 = _mm256_broadcast_ps((const __m128*)Right.m[3]);
+
+        for (unsigned int i = 0; i < 4; i += 2) {
+            const __m256 l = _mm256_loadu_ps(m[i]);
+            __m256 Row = _mm256_mul_ps(_mm256_shuffle_ps(l, l, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+            Row = _mm256_add_ps(Row, _mm256_mul_ps(_mm256_shuffle_ps(l, l, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+            Row = _mm256_add_ps(Row, _mm256_mul_ps(_mm256_shuffle_ps(l, l, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+            Row = _mm256_add_ps(Row, _mm256_mul_ps(_mm256_shuffle_ps(l, l, _MM_SHUFFLE(3, 3, 3, 3)), r3));
+            _mm256_storeu_ps(Ret.m[i], Row);
+        }
+        return Ret;
+#elif defined(MATH_3D_SSE)
+        // Every row of the result is a linear combination of the rows of Right
+        Matrix4f Ret;
+        const __m128 r0 = _mm_load_ps(Right.m[0]);
+        const __m128 r1 = _mm_load_ps(Right.m[1]);
+        const __m128 r2 = _mm_load_ps(Right.m[2]);
+        const __m128 r3 = _mm_load_ps(Right.m[3]);
+
+        for (unsigned int i = 0; i < 4; i++) {
+            __m128 Row = _mm_mul_ps(_mm_set1_ps(m[i][0]), r0);
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][1]), r1));
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][2]), r2));
+            Row = _mm_add_ps(Row, _mm_mul_ps(_mm_set1_ps(m[i][3]), r3));
+            _mm_store_ps(Ret.m[i], Row);
+        }
+        return Ret;
+#else
+        return MulScalar(Right);
+#endif
+    }
+
+    Matrix4f MulScalar(const Matrix4f& Right) const {
         Matrix4f Ret;
 
         for (unsigned int i = 0; i < 4; i++) {
@@ -152,6 +226,35 @@ public:
         return Ret;
     }
 
+    inline Vector4f operator*(const Vector4f& v) const {
+#ifdef MATH_3D_SSE
+        // Multiply every row by v, then transpose so that a vertical add gives the dot products
+        const __m128 Vec = _mm_loadu_ps(&v.x);
+        __m128 d0 = _mm_mul_ps(_mm_load_ps(m[0]), Vec);
+        __m128 d1 = _mm_mul_ps(_mm_load_ps(m[1]), Vec);
+        __m128 d2 = _mm_mul_ps(_mm_load_ps(m[2]), Vec);
+        __m128 d3 = _mm_mul_ps(_mm_load_ps(m[3]), Vec);
+        _MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+        Vector4f Ret;
+        _mm_storeu_ps(&Ret.x, _mm_add_ps(_mm_add_ps(d0, d1), _mm_add_ps(d2, d3)));
+        return Ret;
+#else
+        return MulScalar(v);
+#endif
+    }
+
+    Vector4f MulScalar(const Vector4f& v) const {
+        Vector4f Ret;
+
+        Ret.x = m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z + m[0][3] * v.w;
+        Ret.y = m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z + m[1][3] * v.w;
+        Ret.z = m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z + m[2][3] * v.w;
+        Ret.w = m[3][0] * v.x + m[3][1] * v.y + m[3][2] * v.z + m[3][3] * v.w;
+
+        return Ret;
+    }
+
     void InitScaleTransform(float ScaleX, float ScaleY, float ScaleZ);
     void InitRotateTransform(float RotateX, float RotateY, float RotateZ);
     void InitTranslationTransform(float x, float y, float z);
@@ -162,8 +265,13 @@ public:
 struct Quaternion {
     float x, y, z, w;
 
+    Quaternion() {}
+
     Quaternion(float _x, float _y, float _z, float _w);
 
+    // Same rotation as Matrix4f::InitRotateTransform with the same angles (in degrees)
+    void InitRotation(float RotateX, float RotateY, float RotateZ);
+
     void Normalize();
 
     Quaternion Conjugate();
@@ -2,7 +2,11 @@
 #define	MESH_H
 
 #include <assert.h>
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <GL/glew.h>
@@ -11,8 +15,23 @@
 #include <assimp/postprocess.h>
 
 #include "Util.h"
+#include "Engine_common.h"
 #include "Math_3d.h"
+#include "Frustum.h"
 #include "Texture.h"
+#include "Texture_array.h"
+#include "Texture_loader.h"
+#include "Texture_streamer.h"
+#include "Ring_buffer.h"
+#include "Mesh_cache.h"
+#include "Process_memory.h"
+#include "Gltf_loader.h"
+#include "Obj_loader.h"
+#include "Mesh_meshlets.h"
+#include "Mesh_optimizer.h"
+#include "Mesh_quantizer.h"
+#include "Mesh_simplifier.h"
+#include "Thread_pool.h"
 
 using namespace std;
 
@@ -30,6 +49,59 @@ struct Vertex {
     }
 };
 
+// Compact per-instance transform: World = Translation(Pos) * Rotation(Rot) * Scale(Scale)
+struct InstanceTRS {
+    Vector3f Pos;
+    Quaternion Rot;
+    Vector3f Scale;
+};
+
+// Instances drawn and skipped by the frustum culling of the Render calls, and meshlets drawn
+// and skipped by Mesh::CullMeshlets
+struct CullStats {
+    CullStats() {
+        NumVisible = 0;
+        NumCulled = 0;
+        NumMeshletsVisible = 0;
+        NumMeshletsOutside = 0;
+        NumMeshletsBackFacing = 0;
+    }
+
+    unsigned int NumVisible;
+    unsigned int NumCulled;
+    unsigned int NumMeshletsVisible;
+    unsigned int NumMeshletsOutside;
+    unsigned int NumMeshletsBackFacing;
+};
+
+// Layout defined by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint Count;
+    GLuint InstanceCount;
+    GLuint FirstIndex;
+    GLint BaseVertex;
+    GLuint BaseInstance;
+};
+
+// Mesh::LoadMesh flags
+#define MESH_LOAD_OPTIMIZE 0x01 // Reorder triangles and vertices for the vertex cache, overdraw and vertex fetch
+#define MESH_LOAD_WELD     0x02 // Merge duplicated vertices, see Mesh::SetWeldEpsilons
+#define MESH_LOAD_QUANTIZE 0x04 // Upload compact vertex formats, see Mesh_quantizer.h and Mesh::GetPositionDecode
+#define MESH_LOAD_LODS     0x08 // Build a LOD chain by edge collapse, needs an indexed (or welded) mesh
+#define MESH_LOAD_MULTI_DRAW 0x10 // Draw all sub-meshes with one glMultiDrawElementsIndirect, see Mesh::IsMultiDraw
+#define MESH_LOAD_MESHLETS 0x20 // Split LOD 0 into meshlets culled per instance, see Mesh::CullMeshlets. Replaces MESH_LOAD_MULTI_DRAW.
+#define MESH_LOAD_COMPRESS_TEXTURES 0x40 // Block compressed textures with mipmaps, see Texture::SetCompression. Not with MESH_LOAD_MULTI_DRAW.
+#define MESH_CACHED_FLAGS  (MESH_LOAD_OPTIMIZE | MESH_LOAD_WELD | MESH_LOAD_LODS) // Flags that change the cached data
+
+// Mesh::GetLoadState
+#define MESH_STATE_EMPTY   0
+#define MESH_STATE_LOADING 1 // Queued in a MeshLoader. Must be neither rendered nor deleted.
+#define MESH_STATE_READY   2
+#define MESH_STATE_FAILED  3
+
+#define MESH_MAX_LODS       4      // Every LOD has half the triangles of the previous one
+#define MESH_LOD_PIXEL_SIZE 256.0f // Screen size in pixels below which LOD 1 is used, halved for every further LOD
+
 #define INVALID_MATERIAL 0xFFFFFFFF
 #define INDEX_BUFFER 0    
 #define POS_VB       1
@@ -37,54 +109,791 @@ struct Vertex {
 #define TEXCOORD_VB  3    
 #define WVP_MAT_VB   4
 #define WORLD_MAT_VB 5
+#define INSTANCE_TRS_VB 6
+#define INDIRECT_BUFFER 7
 
 #define POSITION_LOCATION   0
 #define TEX_COORD_LOCATION  1
 #define NORMAL_LOCATION     2
 #define WVP_LOCATION        3
 #define WORLD_LOCATION      7
+#define INSTANCE_POS_LOCATION   11
+#define INSTANCE_ROT_LOCATION   12
+#define INSTANCE_SCALE_LOCATION 13
+
+// CPU side result of parsing a mesh, consumed by the GL upload steps. The arrays point either
+// into a mapped file or into the vectors built by the importers.
+struct MeshData {
+    MeshData() {
+        Flags = 0;
+        pSource = "";
+        FromCache = false;
+        Start = 0;
+        NextStep = 0;
+        pPositions = NULL;
+        pNormals = NULL;
+        pTexCoords = NULL;
+        pIndices = NULL;
+        NumVertices = 0;
+        NumIndices = 0;
+    }
+
+    void ReleaseVertexData() {
+        std::vector<Vector3f>().swap(Positions);
+        std::vector<Vector3f>().swap(Normals);
+        std::vector<Vector2f>().swap(TexCoords);
+        std::vector<unsigned int>().swap(Indices);
+        CacheFile.Close();
+        SourceFile.Close();
+        pPositions = NULL;
+        pNormals = NULL;
+        pTexCoords = NULL;
+        pIndices = NULL;
+    }
+
+    // Points the arrays at the vectors
+    void UseVectors() {
+        pPositions = Positions.data();
+        pNormals = Normals.data();
+        pTexCoords = TexCoords.data();
+        pIndices = Indices.data();
+        NumVertices = (unsigned int)Positions.size();
+        NumIndices = (unsigned int)Indices.size();
+    }
+
+    std::string Filename;
+    unsigned int Flags;
+    const char* pSource;   // What the mesh was read from, for the log
+    bool FromCache;
+    long long Start;
+    unsigned int NextStep;
+    std::vector<std::string> TexturePaths;
+
+    MappedFile CacheFile;
+    MappedFile SourceFile; // GLB files are read in place
+    std::vector<Vector3f> Positions;
+    std::vector<Vector3f> Normals;
+    std::vector<Vector2f> TexCoords;
+    std::vector<unsigned int> Indices;
+
+    const Vector3f* pPositions;
+    const Vector3f* pNormals;
+    const Vector2f* pTexCoords;
+    const unsigned int* pIndices;
+    unsigned int NumVertices;
+    unsigned int NumIndices;
+};
 
 class Mesh {
+    friend class MeshLoader;
+
 public:
     Mesh() {
         m_VAO = 0;
         ZERO_MEM(m_Buffers);
+        m_mappedOffset = 0;
+        m_mappedNumInstances = 0;
+        m_mappedCompact = false;
+        m_quantized = false;
+        m_numLods = 1;
+        m_boundingRadius = 0.0f;
+        m_multiDraw = false;
+        m_loadState = MESH_STATE_EMPTY;
+        m_pImportPool = NULL;
+        m_pTextureLoader = NULL;
+        m_pTextureStreamer = NULL;
+        m_pCullFrustum = NULL;
+        m_meshletDraw = false;
+        m_meshletsCulled = false;
     }
 
     ~Mesh() {
         Clear();
     }
 
-    bool LoadMesh(const std::string& Filename) {
+    // Tolerances used by MESH_LOAD_WELD. Applies to the next LoadMesh call.
+    void SetWeldEpsilons(const WeldEpsilons& Epsilons) {
+        m_weldEpsilons = Epsilons;
+    }
+
+    // Pool used to import the sub-meshes of the Assimp scene in parallel, NULL imports them one
+    // by one. Applies to the next load. The load must not run on a thread of the same pool.
+    void SetImportThreadPool(ThreadPool* pPool) {
+        m_pImportPool = pPool;
+    }
+
+    // With a loader the textures are decoded and uploaded in the background and show its
+    // placeholder until then. Not used for multi draw meshes, whose texture array is built at load.
+    // Applies to the next load. The loader must outlive the mesh.
+    void SetTextureLoader(TextureLoader* pLoader) {
+        m_pTextureLoader = pLoader;
+    }
+
+    // With a streamer the block compressed textures start small and get the larger levels the
+    // draws need, see RequestTextureDensity. Needs the texture loader and
+    // MESH_LOAD_COMPRESS_TEXTURES. Applies to the next load. The streamer must outlive the mesh.
+    void SetTextureStreamer(TextureStreamer* pStreamer) {
+        m_pTextureStreamer = pStreamer;
+    }
+
+    // Quantized positions are stored relative to the mesh bounding box and must be decoded as
+    // Offset + Position * Scale. Returns false when the vertex attributes are plain floats.
+    bool GetPositionDecode(Vector3f& Offset, Vector3f& Scale) const {
+        Offset = m_posOffset;
+        Scale = m_posScale;
+        return m_quantized;
+    }
+
+    // True when the mesh draws through glMultiDrawElementsIndirect. The shader must then take the
+    // texture of every draw from the texture array layer of GetEntryMaterials()[gl_DrawID % NumEntries].
+    bool IsMultiDraw() const {
+        return m_multiDraw;
+    }
+
+    void GetEntryMaterials(std::vector<int>& Materials) const {
+        Materials.resize(m_Entries.size() / m_numLods);
+        for (unsigned int i = 0; i < Materials.size(); i++)
+            Materials[i] = (int)m_Entries[i].MaterialIndex;
+    }
+
+    unsigned int GetNumLods() const {
+        return m_numLods;
+    }
+
+    // See Texture::SetDefaultFilter. Not while the mesh is loading.
+    void SetTextureFilter(unsigned int Filter, float MaxAnisotropy) {
+        Texture::SetDefaultFilter(Filter, MaxAnisotropy);
+        for (unsigned int i = 0; i < m_Textures.size(); i++)
+            if (m_Textures[i])
+                m_Textures[i]->SetFilter(Filter, MaxAnisotropy);
+    }
+
+    // Video memory of the textures, counted once they are decoded
+    size_t GetTextureMemory() const {
+        size_t Size = 0;
+        for (unsigned int i = 0; i < m_Textures.size(); i++)
+            if (m_Textures[i])
+                Size += m_Textures[i]->GetMemorySize();
+        return Size;
+    }
+
+    // Tells the streamer how large the textures are seen this frame. PixelsPerUnit is the screen
+    // size of a model space unit at the closest point drawn.
+    void RequestTextureDensity(float PixelsPerUnit) {
+        if (!m_pTextureStreamer || PixelsPerUnit <= 0.0f)
+            return;
+
+        // Every LOD samples the textures like LOD 0
+        const unsigned int NumEntries = GetNumEntries();
+        for (unsigned int i = 0; i < NumEntries; i++) {
+            const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
+            if (MaterialIndex < m_Textures.size() && m_Textures[MaterialIndex] && m_Entries[i].UVDensity > 0.0f)
+                m_pTextureStreamer->RequestDensity(m_Textures[MaterialIndex], m_Entries[i].UVDensity / PixelsPerUnit);
+        }
+    }
+
+    // Radius of the sphere around the model space origin that contains the mesh
+    float GetBoundingRadius() const {
+        return m_boundingRadius;
+    }
+
+    // Model space bounds of the whole mesh and of every entry of LOD 0. The LOD entries lie
+    // within the bounds of their LOD 0 entry.
+    const BoundingVolume& GetBounds() const {
+        return m_bounds;
+    }
+
+    unsigned int GetNumEntries() const {
+        return (unsigned int)m_Entries.size() / m_numLods;
+    }
+
+    const BoundingVolume& GetEntryBounds(unsigned int Index) const {
+        return m_Entries[Index].Bounds;
+    }
+
+    // World space bounding sphere of an instance with the transform World = T(Pos) * R(Rot) * S(Scale)
+    void GetInstanceSphere(const Vector3f& Pos, const Quaternion& Rot, const Vector3f& Scale, Vector3f& Center, float& Radius) const {
+        Quaternion q = Rot;
+        const Vector3f c(m_bounds.Center.x * Scale.x, m_bounds.Center.y * Scale.y, m_bounds.Center.z * Scale.z);
+        const Quaternion w = q * c * q.Conjugate();
+        Center = Pos + Vector3f(w.x, w.y, w.z);
+        Radius = m_bounds.Radius * std::max(fabsf(Scale.x), std::max(fabsf(Scale.y), fabsf(Scale.z)));
+    }
+
+    // Same for a transposed World matrix as passed to Render
+    void GetInstanceSphere(const Matrix4f& WorldTrans, Vector3f& Center, float& Radius) const {
+        const Matrix4f& m = WorldTrans;
+        const Vector3f& c = m_bounds.Center;
+        Center.x = m.m[0][0] * c.x + m.m[1][0] * c.y + m.m[2][0] * c.z + m.m[3][0];
+        Center.y = m.m[0][1] * c.x + m.m[1][1] * c.y + m.m[2][1] * c.z + m.m[3][1];
+        Center.z = m.m[0][2] * c.x + m.m[1][2] * c.y + m.m[2][2] * c.z + m.m[3][2];
+
+        float MaxScale = 0.0f;
+        for (unsigned int i = 0; i < 3; i++)
+            MaxScale = std::max(MaxScale, m.m[i][0] * m.m[i][0] + m.m[i][1] * m.m[i][1] + m.m[i][2] * m.m[i][2]);
+        Radius = m_bounds.Radius * sqrtf(MaxScale);
+    }
+
+    bool IsInstanceVisible(const Frustum& f, const Vector3f& Pos, const Quaternion& Rot, const Vector3f& Scale) const {
+        Vector3f Center;
+        float Radius;
+        GetInstanceSphere(Pos, Rot, Scale, Center, Radius);
+        return f.IsSphereVisible(Center, Radius);
+    }
+
+    // With a frustum the Render calls upload and draw only the instances whose bounding sphere
+    // intersects it. NULL draws every instance. The frustum must stay valid while it is set.
+    void SetCullFrustum(const Frustum* pFrustum) {
+        m_pCullFrustum = pFrustum;
+    }
+
+    const CullStats& GetCullStats() const {
+        return m_cullStats;
+    }
+
+    void ResetCullStats() {
+        m_cullStats = CullStats();
+    }
+
+    // True when LOD 0 is drawn as meshlets after CullMeshlets
+    bool HasMeshlets() const {
+        return m_meshletDraw;
+    }
+
+    // Culls the LOD 0 meshlets of the first NumInstances instances, which are the LOD 0 bucket of
+    // the next RenderMappedInstances call, against the frustum and their normal cones. That call
+    // then draws the remaining meshlets with one multi draw per entry. GetInstance(i) returns the
+    // InstanceTRS of instance i and is called from the pool threads. The cone test needs a uniform
+    // scale and is skipped for other instances.
+    template <typename InstanceFunc>
+    void CullMeshlets(const Frustum& f, const Vector3f& CameraPos, unsigned int NumInstances, InstanceFunc GetInstance, ThreadPool* pPool = NULL) {
+        if (!m_meshletDraw)
+            return;
+
+        const unsigned int NumEntries = GetNumEntries();
+        for (unsigned int e = 0; e < NumEntries; e++)
+            m_meshletCommands[e].clear();
+        m_meshletsCulled = true;
+
+        std::mutex Mutex;
+        auto CullRange = [&](unsigned int Begin, unsigned int End) {
+            std::vector<std::vector<DrawElementsIndirectCommand> > Commands(NumEntries);
+            unsigned int NumOutside = 0;
+            unsigned int NumBackFacing = 0;
+
+            for (unsigned int i = Begin; i < End; i++) {
+                const InstanceTRS t = GetInstance(i);
+                const float MaxScale = std::max(fabsf(t.Scale.x), std::max(fabsf(t.Scale.y), fabsf(t.Scale.z)));
+                const float MinScale = std::min(fabsf(t.Scale.x), std::min(fabsf(t.Scale.y), fabsf(t.Scale.z)));
+                if (MinScale == 0.0f || !IsInstanceVisible(f, t.Pos, t.Rot, t.Scale)) {
+                    NumOutside += (unsigned int)m_meshlets.size();
+                    continue;
+                }
+
+                Quaternion Rot = t.Rot;
+                Quaternion InvRot = Rot.Conjugate();
+                // The cone test runs in model space
+                const bool UniformScale = MaxScale - MinScale <= MaxScale * 0.01f;
+                const Quaternion c = InvRot * (CameraPos - t.Pos) * Rot;
+                const Vector3f LocalCamera(c.x / t.Scale.x, c.y / t.Scale.y, c.z / t.Scale.z);
+
+                for (unsigned int e = 0; e < NumEntries; e++) {
+                    const MeshEntry& Entry = m_Entries[e];
+                    const unsigned int IndexSize = Entry.IndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+                    for (unsigned int k = Entry.FirstMeshlet; k < Entry.FirstMeshlet + Entry.NumMeshlets; k++) {
+                        const Meshlet& m = m_meshlets[k];
+                        if (UniformScale && IsMeshletBackFacing(m, LocalCamera)) {
+                            NumBackFacing++;
+                            continue;
+                        }
+
+                        const Quaternion w = Rot * Vector3f(m.Center.x * t.Scale.x, m.Center.y * t.Scale.y, m.Center.z * t.Scale.z) * InvRot;
+                        if (!f.IsSphereVisible(t.Pos + Vector3f(w.x, w.y, w.z), m.Radius * MaxScale)) {
+                            NumOutside++;
+                            continue;
+                        }
+
+                        DrawElementsIndirectCommand Cmd;
+                        Cmd.Count = m.NumIndices;
+                        Cmd.InstanceCount = 1;
+                        Cmd.FirstIndex = (GLuint)(Entry.IndexOffset / IndexSize + m.FirstIndex);
+                        Cmd.BaseVertex = (GLint)Entry.BaseVertex;
+                        Cmd.BaseInstance = i;
+                        Commands[e].push_back(Cmd);
+                    }
+                }
+            }
+
+            std::lock_guard<std::mutex> Lock(Mutex);
+            for (unsigned int e = 0; e < NumEntries; e++) {
+                m_meshletCommands[e].insert(m_meshletCommands[e].end(), Commands[e].begin(), Commands[e].end());
+                m_cullStats.NumMeshletsVisible += (unsigned int)Commands[e].size();
+            }
+            m_cullStats.NumMeshletsOutside += NumOutside;
+            m_cullStats.NumMeshletsBackFacing += NumBackFacing;
+        };
+
+        if (pPool)
+            pPool->ParallelFor(NumInstances, CullRange, 16);
+        else
+            CullRange(0, NumInstances);
+    }
+
+    // ScreenSize is the projected diameter of the bounding sphere in pixels
+    unsigned int SelectLod(float ScreenSize) const {
+        unsigned int Lod = 0;
+        float Threshold = MESH_LOD_PIXEL_SIZE;
+        while (Lod + 1 < m_numLods && ScreenSize < Threshold) {
+            Lod++;
+            Threshold *= 0.5f;
+        }
+        return Lod;
+    }
+
+    unsigned int GetLoadState() const {
+        return m_loadState;
+    }
+
+    bool IsReady() const {
+        return m_loadState == MESH_STATE_READY;
+    }
+
+    // Blocking load, see MeshLoader for the background version
+    bool LoadMesh(const std::string& Filename, unsigned int Flags = 0) {
         // Release the previously loaded mesh (if it exists)
         Clear();
-        // Create the VAO
-        glGenVertexArrays(1, &m_VAO);
-        glBindVertexArray(m_VAO);
-        // Create the buffers for the vertices attributes
-        glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
 
-        bool Ret = false;
-        Assimp::Importer Importer;
-        const aiScene* pScene = Importer.ReadFile(Filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+        MeshData Data;
+        bool Ret = ParseMesh(Filename, Flags, Data);
+        for (unsigned int i = 0; Ret && !StreamsTextures(Data.Flags) && i < m_Textures.size(); i++)
+            DecodeTexture(i);
 
-        if (pScene)
-            Ret = InitFromScene(pScene, Filename);
-        else
-            printf("Error parsing '%s': '%s'\n", Filename.c_str(), Importer.GetErrorString());
-        // Make sure the VAO is not changed from the outside
-        glBindVertexArray(0);
+        bool Done = false;
+        while (Ret && !Done)
+            Ret = UploadStep(Data, Done);
+
+        m_loadState = Ret ? MESH_STATE_READY : MESH_STATE_FAILED;
         return Ret;
     }
 
+    // The matrices are transposed
     void Render(unsigned int NumInstances, const Matrix4f* WVPMats, const Matrix4f* WorldMats) {
+        if (m_pCullFrustum) {
+            // Compact the visible instances before the upload
+            m_visibleWVPMats.clear();
+            m_visibleWorldMats.clear();
+            for (unsigned int i = 0; i < NumInstances; i++) {
+                Vector3f Center;
+                float Radius;
+                GetInstanceSphere(WorldMats[i], Center, Radius);
+                if (m_pCullFrustum->IsSphereVisible(Center, Radius)) {
+                    m_visibleWVPMats.push_back(WVPMats[i]);
+                    m_visibleWorldMats.push_back(WorldMats[i]);
+                }
+            }
+            AddCullStats(NumInstances, (unsigned int)m_visibleWVPMats.size());
+            NumInstances = (unsigned int)m_visibleWVPMats.size();
+            WVPMats = m_visibleWVPMats.data();
+            WorldMats = m_visibleWorldMats.data();
+        }
+
         glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[WVP_MAT_VB]);
         glBufferData(GL_ARRAY_BUFFER, sizeof(Matrix4f) * NumInstances, WVPMats, GL_DYNAMIC_DRAW);
         glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[WORLD_MAT_VB]);
         glBufferData(GL_ARRAY_BUFFER, sizeof(Matrix4f) * NumInstances, WorldMats, GL_DYNAMIC_DRAW);
         glBindVertexArray(m_VAO);
+        RenderLods(NULL, NumInstances, [&](unsigned int First) {
+            SetMatrixAttribs(m_Buffers[WVP_MAT_VB], sizeof(Matrix4f) * First, m_Buffers[WORLD_MAT_VB], sizeof(Matrix4f) * First);
+        });
+        // Make sure the VAO is not changed from the outside
+        glBindVertexArray(0);
+    }
+
+    // Instanced rendering with 40 bytes per instance. The shader builds World and WVP from
+    // the instance attributes and the VP matrix uniform.
+    void Render(unsigned int NumInstances, const InstanceTRS* pInstances) {
+        if (m_pCullFrustum) {
+            m_visibleInstances.clear();
+            for (unsigned int i = 0; i < NumInstances; i++)
+                if (IsInstanceVisible(*m_pCullFrustum, pInstances[i].Pos, pInstances[i].Rot, pInstances[i].Scale))
+                    m_visibleInstances.push_back(pInstances[i]);
+            AddCullStats(NumInstances, (unsigned int)m_visibleInstances.size());
+            NumInstances = (unsigned int)m_visibleInstances.size();
+            pInstances = m_visibleInstances.data();
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[INSTANCE_TRS_VB]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceTRS) * NumInstances, pInstances, GL_DYNAMIC_DRAW);
+        glBindVertexArray(m_VAO);
+        RenderLods(NULL, NumInstances, [&](unsigned int First) {
+            SetTRSAttribs(m_Buffers[INSTANCE_TRS_VB], sizeof(InstanceTRS) * First);
+        });
+        // Make sure the VAO is not changed from the outside
+        glBindVertexArray(0);
+    }
+
+    // Streaming versions of the two Render calls above. The Map functions return memory in the
+    // instance ring buffer for NumInstances instances, which can be written from any thread.
+    // RenderMappedInstances then draws them. MapInstanceMatrices returns room for the transposed
+    // WVP matrices followed by the transposed World matrices.
+    Matrix4f* MapInstanceMatrices(unsigned int NumInstances) {
+        m_mappedNumInstances = NumInstances;
+        m_mappedCompact = false;
+        return (Matrix4f*)m_instanceRing.Map(2 * sizeof(Matrix4f) * NumInstances, &m_mappedOffset);
+    }
+
+    InstanceTRS* MapInstanceTRS(unsigned int NumInstances) {
+        m_mappedNumInstances = NumInstances;
+        m_mappedCompact = true;
+        return (InstanceTRS*)m_instanceRing.Map(sizeof(InstanceTRS) * NumInstances, &m_mappedOffset);
+    }
 
+    // pLodCounts optionally gives the number of instances per LOD, in which case the mapped
+    // instances must be sorted by LOD. Every LOD is drawn with its own instance attribute offset.
+    void RenderMappedInstances(const unsigned int* pLodCounts = NULL) {
+        m_instanceRing.Unmap();
+        glBindVertexArray(m_VAO);
+
+        const GLuint Buffer = m_instanceRing.GetBuffer();
+        RenderLods(pLodCounts, m_mappedNumInstances, [&](unsigned int First) {
+            if (m_mappedCompact)
+                SetTRSAttribs(Buffer, m_mappedOffset + sizeof(InstanceTRS) * First);
+            else
+                SetMatrixAttribs(Buffer, m_mappedOffset + sizeof(Matrix4f) * First,
+                    Buffer, m_mappedOffset + sizeof(Matrix4f) * (m_mappedNumInstances + First));
+        });
+        m_instanceRing.Fence();
+        // Make sure the VAO is not changed from the outside
+        glBindVertexArray(0);
+    }
+
+    const RingBufferStats& GetInstanceStreamStats() const {
+        return m_instanceRing.GetStats();
+    }
+
+    void ResetInstanceStreamStats() {
+        m_instanceRing.ResetStats();
+    }
+
+private:
+    void AddCullStats(unsigned int NumInstances, unsigned int NumVisible) {
+        m_cullStats.NumVisible += NumVisible;
+        m_cullStats.NumCulled += NumInstances - NumVisible;
+    }
+
+    // CPU part of a load, touches no GL state: reads the mesh and computes its bounds
+    bool ParseMesh(const std::string& Filename, unsigned int Flags, MeshData& Data) {
+        if (!ReadMesh(Filename, Flags, Data))
+            return false;
+
+        CalcBounds(Data.pPositions, Data.NumVertices);
+
+        if (Data.Flags & MESH_LOAD_MESHLETS) {
+            if (Data.Flags & MESH_LOAD_MULTI_DRAW) {
+                printf("Meshlets are drawn per entry, ignoring the multi draw flag\n");
+                Data.Flags &= ~MESH_LOAD_MULTI_DRAW;
+            }
+            BuildEntryMeshlets(Data.pPositions, Data.NumVertices, Data.pIndices);
+        }
+
+        // The texture array of the multi draw path is filled by blits, which don't work with
+        // compressed textures
+        if ((Data.Flags & MESH_LOAD_COMPRESS_TEXTURES) && !(Data.Flags & MESH_LOAD_MULTI_DRAW)) {
+            if (Texture::IsCompressionSupported()) {
+                const bool Streamed = m_pTextureStreamer && StreamsTextures(Data.Flags);
+                for (unsigned int i = 0; i < m_Textures.size(); i++) {
+                    if (m_Textures[i]) {
+                        m_Textures[i]->SetCompression(TEXTURE_COMPRESS_COLOR);
+                        m_Textures[i]->SetStreamed(Streamed);
+                    }
+                }
+                if (Streamed)
+                    CalcUVDensities(Data.pPositions, Data.pTexCoords, Data.pIndices);
+            }
+            else
+                printf("Block compressed textures are not supported, loading them uncompressed\n");
+        }
+        return true;
+    }
+
+    // Clusters the entries of LOD 0, the meshlets of every entry are stored back to back
+    void BuildEntryMeshlets(const Vector3f* pPositions, unsigned int NumVertices, const unsigned int* pIndices) {
+        const long long Start = GetCurrentTimeMicros();
+        const unsigned int NumEntries = GetNumEntries();
+        m_meshlets.clear();
+        for (unsigned int i = 0; i < NumEntries; i++) {
+            m_Entries[i].FirstMeshlet = (unsigned int)m_meshlets.size();
+            if (m_Entries[i].NumIndices > 0)
+                BuildMeshlets(pIndices + m_Entries[i].BaseIndex, m_Entries[i].NumIndices, pPositions + m_Entries[i].BaseVertex,
+                    GetEntryNumVertices(i, NumVertices), m_meshlets);
+            m_Entries[i].NumMeshlets = (unsigned int)m_meshlets.size() - m_Entries[i].FirstMeshlet;
+        }
+
+        unsigned int NumCones = 0;
+        for (unsigned int i = 0; i < m_meshlets.size(); i++)
+            NumCones += m_meshlets[i].ConeCutoff < 1.0f;
+        printf("Built %u meshlets (%u with a normal cone) in %.2f ms\n", (unsigned int)m_meshlets.size(), NumCones,
+            (GetCurrentTimeMicros() - Start) / 1000.0);
+    }
+
+    // One glMultiDrawElementsIndirect per entry for the meshlets left by CullMeshlets
+    void RenderMeshlets() {
+        const unsigned int NumEntries = GetNumEntries();
+        size_t NumCommands = 0;
+        for (unsigned int e = 0; e < NumEntries; e++)
+            NumCommands += m_meshletCommands[e].size();
+        if (NumCommands == 0)
+            return;
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Buffers[INDIRECT_BUFFER]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * NumCommands, NULL, GL_STREAM_DRAW);
+
+        size_t Offset = 0;
+        for (unsigned int e = 0; e < NumEntries; e++) {
+            const std::vector<DrawElementsIndirectCommand>& Commands = m_meshletCommands[e];
+            if (Commands.empty())
+                continue;
+
+            const unsigned int MaterialIndex = m_Entries[e].MaterialIndex;
+            if (m_Textures[MaterialIndex])
+                m_Textures[MaterialIndex]->Bind(GL_TEXTURE0);
+
+            const size_t Size = sizeof(DrawElementsIndirectCommand) * Commands.size();
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, Offset, Size, &Commands[0]);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, m_Entries[e].IndexType, (const void*)Offset, (GLsizei)Commands.size(), 0);
+            Offset += Size;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // Reads the cache, the GLB or OBJ file or the Assimp scene, welds, optimizes, builds the
+    // LODs and creates the textures without their images
+    bool ReadMesh(const std::string& Filename, unsigned int Flags, MeshData& Data) {
+        Data.Filename = Filename;
+        Data.Flags = Flags;
+        Data.Start = GetCurrentTimeMicros();
+
+        if (HasExtension(Filename, "glb")) {
+            Data.pSource = "GLB";
+            return InitFromGlb(Filename, Data);
+        }
+        // Use the binary cache written by a previous run if it is still up to date
+        MeshCacheView Cache;
+        Data.FromCache = Data.CacheFile.Open(GetMeshCacheFilename(Filename)) && ReadMeshCache(Data.CacheFile, Filename, Flags & MESH_CACHED_FLAGS, m_weldEpsilons, Cache);
+
+        if (Data.FromCache) {
+            Data.pSource = "cache";
+            return InitFromCache(Cache, Data);
+        }
+
+        Data.CacheFile.Close();
+
+        // The native OBJ reader falls back to Assimp for files it does not understand
+        if (HasExtension(Filename, "obj")) {
+            Data.pSource = "OBJ";
+            if (InitFromObj(Filename, Data))
+                return true;
+            printf("Falling back to Assimp for '%s'\n", Filename.c_str());
+        }
+        Data.pSource = "Assimp";
+
+        Assimp::Importer Importer;
+        const aiScene* pScene = Importer.ReadFile(Filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+
+        if (!pScene) {
+            printf("Error parsing '%s': '%s'\n", Filename.c_str(), Importer.GetErrorString());
+            return false;
+        }
+        return InitFromScene(pScene, Filename, Data);
+    }
+
+    // Reads the image of one material. Touches no GL state and no other material, so the
+    // textures can be decoded in parallel. A texture whose image can't be read is uploaded as the
+    // placeholder.
+    void DecodeTexture(unsigned int Index) {
+        if (m_Textures[Index])
+            m_Textures[Index]->Decode();
+    }
+
+    // The TextureLoader decodes the images itself
+    bool StreamsTextures(unsigned int Flags) const {
+        return m_pTextureLoader && !(Flags & MESH_LOAD_MULTI_DRAW);
+    }
+
+    // GL part of a load, split in steps so that the render thread can spread it over several
+    // frames: one step per texture, then the vertex and index buffers, then the multi draw
+    // setup. Sets Done after the last step.
+    bool UploadStep(MeshData& Data, bool& Done) {
+        Done = false;
+        const unsigned int NumTextures = (unsigned int)m_Textures.size();
+        const unsigned int Step = Data.NextStep++;
+
+        if (Step < NumTextures) {
+            if (m_Textures[Step] && StreamsTextures(Data.Flags)) {
+                // The decode can turn the streaming off, the streamer checks again once it is done
+                if (m_Textures[Step]->IsStreamed())
+                    m_pTextureStreamer->Add(m_Textures[Step]);
+                m_pTextureLoader->LoadAsync(m_Textures[Step]);
+            }
+            else if (m_Textures[Step]) {
+                if (!m_Textures[Step]->Upload()) {
+                    printf("Error loading texture '%s'\n", Data.TexturePaths[Step].c_str());
+                    return false;
+                }
+                printf("Loaded texture '%s'\n", Data.TexturePaths[Step].c_str());
+            }
+            return true;
+        }
+
+        if (Step == NumTextures) {
+            // Create the VAO
+            glGenVertexArrays(1, &m_VAO);
+            glBindVertexArray(m_VAO);
+            // Create the buffers for the vertices attributes
+            glGenBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
+
+            const bool Ret = InitBuffers(Data.pPositions, Data.pNormals, Data.pTexCoords, Data.NumVertices, Data.pIndices, Data.NumIndices, Data.Flags);
+            // Make sure the VAO is not changed from the outside
+            glBindVertexArray(0);
+            // The CPU copy is not needed anymore
+            Data.ReleaseVertexData();
+
+            if (!Ret)
+                return false;
+
+            if (Data.Flags & MESH_LOAD_MESHLETS) {
+                m_meshletDraw = GLEW_ARB_multi_draw_indirect && !m_meshlets.empty();
+                m_meshletCommands.resize(GetNumEntries());
+                if (!GLEW_ARB_multi_draw_indirect)
+                    printf("Multi draw indirect is not supported, drawing the meshlets as whole entries\n");
+            }
+            if (Data.Flags & MESH_LOAD_MULTI_DRAW)
+                return true;
+        }
+        else
+            InitMultiDraw();
+
+        printf("Loaded mesh '%s' from %s in %.2f ms, peak process memory %.1f MB\n", Data.Filename.c_str(), Data.pSource,
+            (GetCurrentTimeMicros() - Data.Start) / 1000.0, GetPeakMemoryUsage() / (1024.0 * 1024.0));
+        Done = true;
+        return true;
+    }
+
+    // Points the per-instance attributes of the VAO at the instance data and enables only the ones
+    // of the format in use
+    void SetMatrixAttribs(GLuint WVPBuffer, GLintptr WVPOffset, GLuint WorldBuffer, GLintptr WorldOffset) {
+        glBindBuffer(GL_ARRAY_BUFFER, WVPBuffer);
+        for (unsigned int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(WVP_LOCATION + i);
+            glVertexAttribPointer(WVP_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), (const GLvoid*)(WVPOffset + sizeof(GLfloat) * i * 4));
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, WorldBuffer);
+        for (unsigned int i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(WORLD_LOCATION + i);
+            glVertexAttribPointer(WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), (const GLvoid*)(WorldOffset + sizeof(GLfloat) * i * 4));
+        }
+
+        glDisableVertexAttribArray(INSTANCE_POS_LOCATION);
+        glDisableVertexAttribArray(INSTANCE_ROT_LOCATION);
+        glDisableVertexAttribArray(INSTANCE_SCALE_LOCATION);
+    }
+
+    void SetTRSAttribs(GLuint Buffer, GLintptr Offset) {
+        for (unsigned int i = 0; i < 4; i++) {
+            glDisableVertexAttribArray(WVP_LOCATION + i);
+            glDisableVertexAttribArray(WORLD_LOCATION + i);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, Buffer);
+        glEnableVertexAttribArray(INSTANCE_POS_LOCATION);
+        glVertexAttribPointer(INSTANCE_POS_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTRS), (const GLvoid*)(Offset + offsetof(InstanceTRS, Pos)));
+        glEnableVertexAttribArray(INSTANCE_ROT_LOCATION);
+        glVertexAttribPointer(INSTANCE_ROT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTRS), (const GLvoid*)(Offset + offsetof(InstanceTRS, Rot)));
+        glEnableVertexAttribArray(INSTANCE_SCALE_LOCATION);
+        glVertexAttribPointer(INSTANCE_SCALE_LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceTRS), (const GLvoid*)(Offset + offsetof(InstanceTRS, Scale)));
+    }
+
+    // Draws the instances LOD by LOD (all with LOD 0 when pLodCounts is NULL). SetInstanceAttribs
+    // points the instance attributes at the instance with the given index.
+    template <typename SetAttribsFunc>
+    void RenderLods(const unsigned int* pLodCounts, unsigned int NumInstances, SetAttribsFunc SetInstanceAttribs) {
+        if (m_multiDraw) {
+            // One draw for all entries and LODs, the LOD buckets are selected by the base instance
+            const unsigned int NumEntries = (unsigned int)m_Entries.size() / m_numLods;
+            unsigned int First = 0;
+            for (unsigned int Lod = 0; Lod < m_numLods; Lod++) {
+                const unsigned int Count = pLodCounts ? pLodCounts[Lod] : (Lod == 0 ? NumInstances : 0);
+                for (unsigned int i = Lod * NumEntries; i < (Lod + 1) * NumEntries; i++) {
+                    m_drawCommands[i].InstanceCount = Count;
+                    m_drawCommands[i].BaseInstance = First;
+                }
+                First += Count;
+            }
+
+            SetInstanceAttribs(0);
+            m_materialArray.Bind(GL_TEXTURE0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Buffers[INDIRECT_BUFFER]);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(DrawElementsIndirectCommand) * m_drawCommands.size(), &m_drawCommands[0]);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, m_Entries[0].IndexType, NULL, (GLsizei)m_drawCommands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return;
+        }
+
+        unsigned int First = 0;
+        for (unsigned int Lod = 0; Lod < m_numLods; Lod++) {
+            const unsigned int Count = pLodCounts ? pLodCounts[Lod] : (Lod == 0 ? NumInstances : 0);
+            if (Count == 0)
+                continue;
+
+            SetInstanceAttribs(First);
+            if (Lod == 0 && m_meshletsCulled)
+                RenderMeshlets();
+            else
+                RenderEntries(Count, Lod);
+            First += Count;
+        }
+        m_meshletsCulled = false;
+    }
+
+    // Builds the draw commands of all entries and LODs and the texture array of the materials.
+    // Falls back to a draw per entry when the driver or the mesh does not allow it.
+    void InitMultiDraw() {
+        m_multiDraw = false;
+        if (!GLEW_ARB_multi_draw_indirect || !GLEW_ARB_shader_draw_parameters) {
+            printf("Multi draw indirect is not supported, drawing every entry separately\n");
+            return;
+        }
+
+        const unsigned int NumEntries = (unsigned int)m_Entries.size() / m_numLods;
+        bool SameIndexType = true;
+        for (unsigned int i = 1; i < m_Entries.size(); i++)
+            SameIndexType = SameIndexType && m_Entries[i].IndexType == m_Entries[0].IndexType;
+        if (NumEntries == 0 || NumEntries > MESH_MAX_MULTI_DRAW_ENTRIES || !SameIndexType) {
+            printf("Mesh can't be drawn with multi draw indirect, drawing every entry separately\n");
+            return;
+        }
+
+        const unsigned int IndexSize = m_Entries[0].IndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        m_drawCommands.resize(m_Entries.size());
         for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            m_drawCommands[i].Count = m_Entries[i].NumIndices;
+            m_drawCommands[i].InstanceCount = 0;
+            m_drawCommands[i].FirstIndex = (GLuint)(m_Entries[i].IndexOffset / IndexSize);
+            m_drawCommands[i].BaseVertex = (GLint)m_Entries[i].BaseVertex;
+            m_drawCommands[i].BaseInstance = 0;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_Buffers[INDIRECT_BUFFER]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * m_drawCommands.size(), &m_drawCommands[0], GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        m_multiDraw = m_materialArray.Init(m_Textures);
+    }
+
+    void RenderEntries(unsigned int NumInstances, unsigned int Lod = 0) {
+        const unsigned int NumEntries = (unsigned int)m_Entries.size() / m_numLods;
+        for (unsigned int i = Lod * NumEntries; i < (Lod + 1) * NumEntries; i++) {
             const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
             assert(MaterialIndex < m_Textures.size());
             if (m_Textures[MaterialIndex])
@@ -92,24 +901,22 @@ public:
 
             glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
                 m_Entries[i].NumIndices,
-                GL_UNSIGNED_INT,
-                (void*)(sizeof(unsigned int) * m_Entries[i].BaseIndex),
+                m_Entries[i].IndexType,
+                (void*)m_Entries[i].IndexOffset,
                 NumInstances,
                 m_Entries[i].BaseVertex);
         }
-        // Make sure the VAO is not changed from the outside    
-        glBindVertexArray(0);
     }
 
-private:
-    bool InitFromScene(const aiScene* pScene, const std::string& Filename) {
+    bool InitFromScene(const aiScene* pScene, const std::string& Filename, MeshData& Data) {
+        m_numLods = 1;
         m_Entries.resize(pScene->mNumMeshes);
         m_Textures.resize(pScene->mNumMaterials);
 
-        std::vector<Vector3f> Positions;
-        std::vector<Vector3f> Normals;
-        std::vector<Vector2f> TexCoords;
-        std::vector<unsigned int> Indices;
+        std::vector<Vector3f>& Positions = Data.Positions;
+        std::vector<Vector3f>& Normals = Data.Normals;
+        std::vector<Vector2f>& TexCoords = Data.TexCoords;
+        std::vector<unsigned int>& Indices = Data.Indices;
 
         unsigned int NumVertices = 0;
         unsigned int NumIndices = 0;
@@ -123,127 +930,590 @@ private:
             NumVertices += pScene->mMeshes[i]->mNumVertices;
             NumIndices += m_Entries[i].NumIndices;
         }
-        // Reserve space in the vectors for the vertex attributes and indices
-        Positions.reserve(NumVertices);
-        Normals.reserve(NumVertices);
-        TexCoords.reserve(NumVertices);
-        Indices.reserve(NumIndices);
-        // Initialize the meshes in the scene one by one
+        // Size the vectors for the vertex attributes and indices, every mesh of the scene is then
+        // written at its own offset
+        Positions.resize(NumVertices);
+        Normals.resize(NumVertices);
+        TexCoords.resize(NumVertices);
+        Indices.resize(NumIndices);
+
+        const long long ImportStart = GetCurrentTimeMicros();
+        auto ImportMeshes = [&](unsigned int Begin, unsigned int End) {
+            for (unsigned int i = Begin; i < End; i++) {
+                const unsigned int BaseVertex = m_Entries[i].BaseVertex;
+                InitMesh(pScene->mMeshes[i], Positions.data() + BaseVertex, Normals.data() + BaseVertex, TexCoords.data() + BaseVertex,
+                    Indices.data() + m_Entries[i].BaseIndex);
+            }
+        };
+
+        if (m_pImportPool)
+            m_pImportPool->ParallelFor((unsigned int)m_Entries.size(), ImportMeshes, 1);
+        else
+            ImportMeshes(0, (unsigned int)m_Entries.size());
+        printf("Imported %u meshes in %.2f ms on %u threads\n", (unsigned int)m_Entries.size(),
+            (GetCurrentTimeMicros() - ImportStart) / 1000.0, m_pImportPool ? m_pImportPool->GetNumThreads() : 1);
+
+        GetTexturePaths(pScene, Filename, Data.TexturePaths);
+        return FinishImport(Filename, Data);
+    }
+
+    // Native OBJ path, the file is parsed and welded on the import pool
+    bool InitFromObj(const std::string& Filename, MeshData& Data) {
+        ObjFile File;
+        {
+            MappedFile Source;
+            if (!Source.Open(Filename) || !ReadObj(Source.GetData(), Source.GetSize(), GetDirectory(Filename), m_pImportPool, File)) {
+                printf("Error parsing '%s'\n", Filename.c_str());
+                return false;
+            }
+        }
+
+        m_numLods = 1;
+        m_Entries.resize(File.Meshes.size());
+        m_Textures.resize(File.TexturePaths.size());
         for (unsigned int i = 0; i < m_Entries.size(); i++) {
-            const aiMesh* paiMesh = pScene->mMeshes[i];
-            InitMesh(paiMesh, Positions, Normals, TexCoords, Indices);
+            m_Entries[i].MaterialIndex = File.Meshes[i].MaterialIndex;
+            m_Entries[i].NumIndices = File.Meshes[i].NumIndices;
+            m_Entries[i].BaseVertex = File.Meshes[i].BaseVertex;
+            m_Entries[i].BaseIndex = File.Meshes[i].BaseIndex;
         }
 
-        if (!InitMaterials(pScene, Filename))
+        Data.Positions.swap(File.Positions);
+        Data.Normals.swap(File.Normals);
+        Data.TexCoords.swap(File.TexCoords);
+        Data.Indices.swap(File.Indices);
+        Data.TexturePaths.swap(File.TexturePaths);
+        return FinishImport(Filename, Data);
+    }
+
+    // Common end of the imports into the vectors: the load flag passes, the textures and the cache
+    bool FinishImport(const std::string& Filename, MeshData& Data) {
+        const unsigned int Flags = Data.Flags;
+        std::vector<Vector3f>& Positions = Data.Positions;
+        std::vector<Vector3f>& Normals = Data.Normals;
+        std::vector<Vector2f>& TexCoords = Data.TexCoords;
+        std::vector<unsigned int>& Indices = Data.Indices;
+        const std::vector<std::string>& TexturePaths = Data.TexturePaths;
+
+        ProcessEntries(Data);
+        CreateTextures(TexturePaths);
+
+        std::vector<MeshCacheEntry> CacheEntries(m_Entries.size());
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            CacheEntries[i].NumIndices = m_Entries[i].NumIndices;
+            CacheEntries[i].BaseVertex = m_Entries[i].BaseVertex;
+            CacheEntries[i].BaseIndex = m_Entries[i].BaseIndex;
+            CacheEntries[i].MaterialIndex = m_Entries[i].MaterialIndex;
+        }
+        WriteMeshCache(Filename, Flags & MESH_CACHED_FLAGS, m_weldEpsilons, CacheEntries, m_numLods, TexturePaths, Positions, Normals, TexCoords, Indices);
+
+        Data.UseVectors();
+        return true;
+    }
+
+    // The optional CPU passes of the load flags over the vectors of the mesh data
+    void ProcessEntries(MeshData& Data) {
+        if (Data.Flags & MESH_LOAD_WELD)
+            WeldEntries(Data.Positions, Data.Normals, Data.TexCoords, Data.Indices);
+
+        if (Data.Flags & MESH_LOAD_OPTIMIZE)
+            OptimizeEntries(Data.Positions, Data.Normals, Data.TexCoords, Data.Indices);
+
+        if (Data.Flags & MESH_LOAD_LODS)
+            GenerateLods(Data.Positions, Data.Indices, (Data.Flags & MESH_LOAD_OPTIMIZE) != 0);
+    }
+
+    // Case insensitive check of the file extension, pExt without the dot
+    static bool HasExtension(const std::string& Filename, const char* pExt) {
+        const std::string::size_type Dot = Filename.find_last_of('.');
+        if (Dot == std::string::npos)
             return false;
-        // Generate and populate the buffers with vertex attributes and the indices
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Positions[0]) * Positions.size(), &Positions[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(POSITION_LOCATION);
-        glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(TexCoords[0]) * TexCoords.size(), &TexCoords[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(TEX_COORD_LOCATION);
-        glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        std::string Ext = Filename.substr(Dot + 1);
+        for (unsigned int i = 0; i < Ext.size(); i++)
+            Ext[i] = (char)tolower((unsigned char)Ext[i]);
+        return Ext == pExt;
+    }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(Normals[0]) * Normals.size(), &Normals[0], GL_STATIC_DRAW);
-        glEnableVertexAttribArray(NORMAL_LOCATION);
-        glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+    // Native GLB path without Assimp and without the mesh cache. Without processing flags the
+    // buffers are filled straight from the mapped file when its arrays have the right layout.
+    bool InitFromGlb(const std::string& Filename, MeshData& Data) {
+        GltfFile File;
+        if (!Data.SourceFile.Open(Filename) || !ReadGlb(Data.SourceFile.GetData(), Data.SourceFile.GetSize(), GetDirectory(Filename), File)) {
+            printf("Error parsing '%s'\n", Filename.c_str());
+            return false;
+        }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices[0]) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
+        m_numLods = 1;
+        m_Entries.resize(File.Primitives.size());
+        m_Textures.resize(File.MaterialImages.size());
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[WVP_MAT_VB]);
+        unsigned int NumVertices = 0;
+        unsigned int NumIndices = 0;
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            m_Entries[i].MaterialIndex = File.Primitives[i].MaterialIndex;
+            m_Entries[i].NumIndices = GetGltfNumIndices(File.Primitives[i]);
+            m_Entries[i].BaseVertex = NumVertices;
+            m_Entries[i].BaseIndex = NumIndices;
 
-        for (unsigned int i = 0; i < 4; i++) {
-            glEnableVertexAttribArray(WVP_LOCATION + i);
-            glVertexAttribPointer(WVP_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), (const GLvoid*)(sizeof(GLfloat) * i * 4));
-            glVertexAttribDivisor(WVP_LOCATION + i, 1);
+            NumVertices += File.Primitives[i].Positions.Count;
+            NumIndices += m_Entries[i].NumIndices;
         }
 
-        glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[WORLD_MAT_VB]);
+        if ((Data.Flags & MESH_CACHED_FLAGS) == 0 &&
+            GetGltfArraysInPlace(File, Data.pPositions, Data.pNormals, Data.pTexCoords, Data.pIndices)) {
+            Data.NumVertices = NumVertices;
+            Data.NumIndices = NumIndices;
+            Data.pSource = "GLB in place";
+        }
+        else {
+            Data.Positions.resize(NumVertices);
+            Data.Normals.resize(NumVertices);
+            Data.TexCoords.resize(NumVertices);
+            Data.Indices.resize(NumIndices);
+            for (unsigned int i = 0; i < m_Entries.size(); i++) {
+                const unsigned int BaseVertex = m_Entries[i].BaseVertex;
+                CopyGltfPrimitive(File.Primitives[i], Data.Positions.data() + BaseVertex, Data.Normals.data() + BaseVertex,
+                    Data.TexCoords.data() + BaseVertex, Data.Indices.data() + m_Entries[i].BaseIndex);
+            }
+
+            ProcessEntries(Data);
+            Data.UseVectors();
+        }
+
+        // The textures keep a copy of the embedded images, the mapped file is closed before they
+        // are decoded in the background
+        Data.TexturePaths.resize(File.MaterialImages.size());
+        for (unsigned int i = 0; i < File.MaterialImages.size(); i++)
+            Data.TexturePaths[i] = File.MaterialImages[i].pData ? Filename + File.MaterialImages[i].Path : File.MaterialImages[i].Path;
+        CreateTextures(Data.TexturePaths);
+        for (unsigned int i = 0; i < File.MaterialImages.size(); i++)
+            if (m_Textures[i] && File.MaterialImages[i].pData)
+                m_Textures[i]->SetSourceData(File.MaterialImages[i].pData, File.MaterialImages[i].Size);
+
+        return true;
+    }
+
+    // Box and sphere of the vertex range of every LOD 0 entry, copied to its LOD entries
+    static void CalcBoundingVolume(const Vector3f* pPositions, unsigned int NumVertices, BoundingVolume& Bounds) {
+        Bounds = BoundingVolume();
+        if (NumVertices == 0)
+            return;
+
+        Bounds.Min = Bounds.Max = pPositions[0];
+        for (unsigned int i = 1; i < NumVertices; i++) {
+            const Vector3f& p = pPositions[i];
+            Bounds.Min = Vector3f(std::min(Bounds.Min.x, p.x), std::min(Bounds.Min.y, p.y), std::min(Bounds.Min.z, p.z));
+            Bounds.Max = Vector3f(std::max(Bounds.Max.x, p.x), std::max(Bounds.Max.y, p.y), std::max(Bounds.Max.z, p.z));
+        }
+
+        Bounds.Center = (Bounds.Min + Bounds.Max) * 0.5f;
+        float MaxDistSq = 0.0f;
+        for (unsigned int i = 0; i < NumVertices; i++) {
+            const Vector3f d = pPositions[i] - Bounds.Center;
+            MaxDistSq = std::max(MaxDistSq, d.x * d.x + d.y * d.y + d.z * d.z);
+        }
+        Bounds.Radius = sqrtf(MaxDistSq);
+    }
+
+    void CalcBounds(const Vector3f* pPositions, unsigned int NumVertices) {
+        const unsigned int NumEntries = (unsigned int)m_Entries.size() / m_numLods;
+        for (unsigned int i = 0; i < NumEntries; i++) {
+            CalcBoundingVolume(pPositions + m_Entries[i].BaseVertex, GetEntryNumVertices(i, NumVertices), m_Entries[i].Bounds);
+            for (unsigned int Lod = 1; Lod < m_numLods; Lod++)
+                m_Entries[Lod * NumEntries + i].Bounds = m_Entries[i].Bounds;
+        }
+        CalcBoundingVolume(pPositions, NumVertices, m_bounds);
+
+        m_boundingRadius = 0.0f;
+        for (unsigned int i = 0; i < NumVertices; i++) {
+            const Vector3f& p = pPositions[i];
+            m_boundingRadius = std::max(m_boundingRadius, sqrtf(p.x * p.x + p.y * p.y + p.z * p.z));
+        }
+    }
 
+    // UV units per model space unit of every LOD 0 entry from the total area of its triangles in
+    // both spaces, copied to its LOD entries
+    void CalcUVDensities(const Vector3f* pPositions, const Vector2f* pTexCoords, const unsigned int* pIndices) {
+        const unsigned int NumEntries = GetNumEntries();
+        for (unsigned int i = 0; i < NumEntries; i++) {
+            const Vector3f* pPos = pPositions + m_Entries[i].BaseVertex;
+            const Vector2f* pTex = pTexCoords + m_Entries[i].BaseVertex;
+            const unsigned int* pEntryIndices = pIndices + m_Entries[i].BaseIndex;
+            double Area = 0.0, UVArea = 0.0;
+            for (unsigned int j = 0; j + 2 < m_Entries[i].NumIndices; j += 3) {
+                const unsigned int i0 = pEntryIndices[j], i1 = pEntryIndices[j + 1], i2 = pEntryIndices[j + 2];
+                const Vector3f n = (pPos[i1] - pPos[i0]).Cross(pPos[i2] - pPos[i0]);
+                Area += sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+                UVArea += fabsf((pTex[i1].x - pTex[i0].x) * (pTex[i2].y - pTex[i0].y) - (pTex[i2].x - pTex[i0].x) * (pTex[i1].y - pTex[i0].y));
+            }
+
+            const float Density = Area > 0.0 ? (float)sqrt(UVArea / Area) : 0.0f;
+            for (unsigned int Lod = 0; Lod < m_numLods; Lod++)
+                m_Entries[Lod * NumEntries + i].UVDensity = Density;
+        }
+    }
+
+    // The entries of a LOD are stored back to back, so an entry ends where the next one begins.
+    // All LODs of an entry share its vertices.
+    unsigned int GetEntryNumVertices(unsigned int Index, unsigned int NumVertices) const {
+        const unsigned int NumEntries = (unsigned int)m_Entries.size() / m_numLods;
+        Index %= NumEntries;
+        const unsigned int End = Index + 1 < NumEntries ? m_Entries[Index + 1].BaseVertex : NumVertices;
+        return End - m_Entries[Index].BaseVertex;
+    }
+
+    // Appends the LOD entries after the ones of LOD 0, every LOD simplified from the previous one
+    void GenerateLods(const std::vector<Vector3f>& Positions, std::vector<unsigned int>& Indices, bool Optimize) {
+        const unsigned int NumEntries = (unsigned int)m_Entries.size();
+        std::vector<unsigned int> LodIndices;
+
+        // Counted before the LOD entries are appended, which GetEntryNumVertices would take for
+        // the ones following the last entry
+        std::vector<unsigned int> EntryNumVertices(NumEntries);
+        for (unsigned int i = 0; i < NumEntries; i++)
+            EntryNumVertices[i] = GetEntryNumVertices(i, (unsigned int)Positions.size());
+
+        for (unsigned int Lod = 1; Lod < MESH_MAX_LODS; Lod++) {
+            unsigned int NumTris = 0;
+            for (unsigned int i = 0; i < NumEntries; i++) {
+                MeshEntry Entry = m_Entries[(Lod - 1) * NumEntries + i];
+                const unsigned int NumVertices = EntryNumVertices[i];
+                const unsigned int TargetNumIndices = Entry.NumIndices / 6 * 3;
+
+                if (Entry.NumIndices > 0) {
+                    SimplifyMesh(&Indices[Entry.BaseIndex], Entry.NumIndices, &Positions[Entry.BaseVertex], NumVertices, TargetNumIndices, LodIndices);
+                    if (Optimize && !LodIndices.empty())
+                        OptimizeVertexCache(&LodIndices[0], (unsigned int)LodIndices.size(), NumVertices);
+                }
+                else
+                    LodIndices.clear();
+
+                Entry.BaseIndex = (unsigned int)Indices.size();
+                Entry.NumIndices = (unsigned int)LodIndices.size();
+                Indices.insert(Indices.end(), LodIndices.begin(), LodIndices.end());
+                m_Entries.push_back(Entry);
+                NumTris += Entry.NumIndices / 3;
+            }
+            m_numLods++;
+            printf("LOD %u: %u triangles\n", Lod, NumTris);
+        }
+    }
+
+    void WeldEntries(std::vector<Vector3f>& Positions,
+        std::vector<Vector3f>& Normals,
+        std::vector<Vector2f>& TexCoords,
+        std::vector<unsigned int>& Indices) {
+        std::vector<unsigned int> EntryNumVertices(m_Entries.size());
+        for (unsigned int i = 0; i < m_Entries.size(); i++)
+            EntryNumVertices[i] = GetEntryNumVertices(i, (unsigned int)Positions.size());
+
+        unsigned int NumVertices = 0;
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            const unsigned int BaseVertex = m_Entries[i].BaseVertex;
+            const unsigned int NumBefore = EntryNumVertices[i];
+            unsigned int NumAfter = 0;
+
+            if (NumBefore > 0)
+                NumAfter = WeldVertices(&Indices[m_Entries[i].BaseIndex], m_Entries[i].NumIndices,
+                    &Positions[BaseVertex], &Normals[BaseVertex], &TexCoords[BaseVertex], NumBefore, m_weldEpsilons);
+            // Close the gap left by the previous entries
+            std::copy(Positions.begin() + BaseVertex, Positions.begin() + BaseVertex + NumAfter, Positions.begin() + NumVertices);
+            std::copy(Normals.begin() + BaseVertex, Normals.begin() + BaseVertex + NumAfter, Normals.begin() + NumVertices);
+            std::copy(TexCoords.begin() + BaseVertex, TexCoords.begin() + BaseVertex + NumAfter, TexCoords.begin() + NumVertices);
+            m_Entries[i].BaseVertex = NumVertices;
+            NumVertices += NumAfter;
+
+            printf("Weld entry %u: %u -> %u vertices (%.1f%% fewer)\n", i, NumBefore, NumAfter,
+                NumBefore > 0 ? 100.0f * (NumBefore - NumAfter) / NumBefore : 0.0f);
+        }
+
+        Positions.resize(NumVertices);
+        Normals.resize(NumVertices);
+        TexCoords.resize(NumVertices);
+    }
+
+    void OptimizeEntries(std::vector<Vector3f>& Positions,
+        std::vector<Vector3f>& Normals,
+        std::vector<Vector2f>& TexCoords,
+        std::vector<unsigned int>& Indices) {
+        unsigned int MissesBefore = 0;
+        unsigned int MissesAfter = 0;
+
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            const unsigned int NumVertices = GetEntryNumVertices(i, (unsigned int)Positions.size());
+            const unsigned int NumIndices = m_Entries[i].NumIndices;
+            const unsigned int BaseVertex = m_Entries[i].BaseVertex;
+            unsigned int* pIndices = &Indices[m_Entries[i].BaseIndex];
+
+            if (NumVertices == 0 || NumIndices == 0)
+                continue;
+
+            MissesBefore += SimulateVertexCache(pIndices, NumIndices, NumVertices);
+
+            OptimizeVertexCache(pIndices, NumIndices, NumVertices);
+            OptimizeOverdraw(pIndices, NumIndices, &Positions[BaseVertex], NumVertices);
+            OptimizeVertexFetch(pIndices, NumIndices, &Positions[BaseVertex], &Normals[BaseVertex], &TexCoords[BaseVertex], NumVertices);
+
+            MissesAfter += SimulateVertexCache(pIndices, NumIndices, NumVertices);
+        }
+
+        const float NumTris = (float)(Indices.size() / 3);
+        const float NumVertices = (float)Positions.size();
+        if (NumTris > 0.0f)
+            printf("Vertex cache: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", MissesBefore / NumTris, MissesAfter / NumTris,
+                MissesBefore / NumVertices, MissesAfter / NumVertices);
+    }
+
+    bool InitFromCache(const MeshCacheView& Cache, MeshData& Data) {
+        m_numLods = Cache.NumLods;
+        m_Entries.resize(Cache.NumEntries * Cache.NumLods);
+        m_Textures.resize(Cache.TexturePaths.size());
+
+        for (unsigned int i = 0; i < m_Entries.size(); i++) {
+            m_Entries[i].NumIndices = Cache.pEntries[i].NumIndices;
+            m_Entries[i].BaseVertex = Cache.pEntries[i].BaseVertex;
+            m_Entries[i].BaseIndex = Cache.pEntries[i].BaseIndex;
+            m_Entries[i].MaterialIndex = Cache.pEntries[i].MaterialIndex;
+
+            if (m_Entries[i].MaterialIndex >= m_Textures.size())
+                return false;
+        }
+
+        Data.TexturePaths = Cache.TexturePaths;
+        CreateTextures(Data.TexturePaths);
+        // The buffers are filled straight from the mapped cache file
+        Data.pPositions = Cache.pPositions;
+        Data.pNormals = Cache.pNormals;
+        Data.pTexCoords = Cache.pTexCoords;
+        Data.NumVertices = Cache.NumVertices;
+        Data.pIndices = Cache.pIndices;
+        Data.NumIndices = Cache.NumIndices;
+        return true;
+    }
+
+    // Allocates the storage of the buffer and maps all of it for writing. The buffer is invalidated,
+    // so the driver neither keeps nor copies old contents and the data goes straight to memory the
+    // GPU reads from.
+    void* MapNewBuffer(GLenum Target, GLuint Buffer, size_t Size) {
+        glBindBuffer(Target, Buffer);
+        glBufferData(Target, Size, NULL, GL_STATIC_DRAW);
+        return glMapBufferRange(Target, 0, Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+
+    // False when the mapping failed or the contents were lost while mapped
+    bool UnmapBuffer(GLenum Target, void* pMapped) {
+        return pMapped && glUnmapBuffer(Target) == GL_TRUE;
+    }
+
+    bool UploadBuffer(GLenum Target, GLuint Buffer, const void* pData, size_t Size) {
+        void* pMapped = MapNewBuffer(Target, Buffer, Size);
+        if (pMapped)
+            memcpy(pMapped, pData, Size);
+        return UnmapBuffer(Target, pMapped);
+    }
+
+    bool InitBuffers(const Vector3f* pPositions, const Vector3f* pNormals, const Vector2f* pTexCoords, unsigned int NumVertices,
+        const unsigned int* pIndices, unsigned int NumIndices, unsigned int Flags) {
+        const size_t FloatVertexSize = 2 * sizeof(Vector3f) + sizeof(Vector2f);
+        size_t VertexDataSize = FloatVertexSize * NumVertices;
+        size_t IndexDataSize = sizeof(unsigned int) * NumIndices;
+
+        if (NumVertices == 0 || NumIndices == 0) {
+            printf("Mesh has no triangles\n");
+            return false;
+        }
+
+        m_quantized = (Flags & MESH_LOAD_QUANTIZE) != 0;
+        // Generate the buffers at their final size and write the vertex attributes and the indices
+        // straight into the mapped buffers, converting them on the way when quantized
+        bool Ret = true;
+        if (m_quantized) {
+            VertexDataSize = (sizeof(QuantizedPosition) + sizeof(QuantizedNormal) + sizeof(QuantizedTexCoord)) * NumVertices;
+
+            QuantizedPosition* pPosOut = (QuantizedPosition*)MapNewBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB], sizeof(QuantizedPosition) * NumVertices);
+            if (pPosOut)
+                QuantizePositions(pPositions, NumVertices, pPosOut, m_posOffset, m_posScale);
+            Ret = UnmapBuffer(GL_ARRAY_BUFFER, pPosOut) && Ret;
+            glEnableVertexAttribArray(POSITION_LOCATION);
+            glVertexAttribPointer(POSITION_LOCATION, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedPosition), 0);
+
+            QuantizedTexCoord* pTexOut = (QuantizedTexCoord*)MapNewBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB], sizeof(QuantizedTexCoord) * NumVertices);
+            if (pTexOut)
+                QuantizeTexCoords(pTexCoords, NumVertices, pTexOut);
+            Ret = UnmapBuffer(GL_ARRAY_BUFFER, pTexOut) && Ret;
+            glEnableVertexAttribArray(TEX_COORD_LOCATION);
+            glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_HALF_FLOAT, GL_FALSE, 0, 0);
+
+            QuantizedNormal* pNormalOut = (QuantizedNormal*)MapNewBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB], sizeof(QuantizedNormal) * NumVertices);
+            if (pNormalOut)
+                QuantizeNormals(pNormals, NumVertices, pNormalOut);
+            Ret = UnmapBuffer(GL_ARRAY_BUFFER, pNormalOut) && Ret;
+            glEnableVertexAttribArray(NORMAL_LOCATION);
+            glVertexAttribPointer(NORMAL_LOCATION, 2, GL_SHORT, GL_TRUE, 0, 0);
+
+            // Entries with less than 65536 vertices use 16 bit indices. The 32 bit entries are
+            // kept 4 byte aligned. The layout is computed first to size the buffer.
+            IndexDataSize = 0;
+            for (unsigned int i = 0; i < m_Entries.size(); i++) {
+                const bool Short = GetEntryNumVertices(i, NumVertices) <= 0x10000;
+
+                if (!Short)
+                    IndexDataSize = (IndexDataSize + 3) & ~(size_t)3;
+                m_Entries[i].IndexType = Short ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+                m_Entries[i].IndexOffset = IndexDataSize;
+                IndexDataSize += (Short ? sizeof(unsigned short) : sizeof(unsigned int)) * m_Entries[i].NumIndices;
+            }
+
+            unsigned char* pIndexOut = (unsigned char*)MapNewBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER], IndexDataSize);
+            for (unsigned int i = 0; pIndexOut && i < m_Entries.size(); i++) {
+                const unsigned int* pEntryIndices = pIndices + m_Entries[i].BaseIndex;
+
+                if (m_Entries[i].IndexType == GL_UNSIGNED_SHORT) {
+                    unsigned short* pOut = (unsigned short*)(pIndexOut + m_Entries[i].IndexOffset);
+                    for (unsigned int j = 0; j < m_Entries[i].NumIndices; j++)
+                        pOut[j] = (unsigned short)pEntryIndices[j];
+                }
+                else
+                    memcpy(pIndexOut + m_Entries[i].IndexOffset, pEntryIndices, sizeof(unsigned int) * m_Entries[i].NumIndices);
+            }
+            Ret = UnmapBuffer(GL_ELEMENT_ARRAY_BUFFER, pIndexOut) && Ret;
+        }
+        else {
+            m_posOffset = Vector3f(0.0f, 0.0f, 0.0f);
+            m_posScale = Vector3f(1.0f, 1.0f, 1.0f);
+
+            Ret = UploadBuffer(GL_ARRAY_BUFFER, m_Buffers[POS_VB], pPositions, sizeof(Vector3f) * NumVertices) && Ret;
+            glEnableVertexAttribArray(POSITION_LOCATION);
+            glVertexAttribPointer(POSITION_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+            Ret = UploadBuffer(GL_ARRAY_BUFFER, m_Buffers[TEXCOORD_VB], pTexCoords, sizeof(Vector2f) * NumVertices) && Ret;
+            glEnableVertexAttribArray(TEX_COORD_LOCATION);
+            glVertexAttribPointer(TEX_COORD_LOCATION, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
+            Ret = UploadBuffer(GL_ARRAY_BUFFER, m_Buffers[NORMAL_VB], pNormals, sizeof(Vector3f) * NumVertices) && Ret;
+            glEnableVertexAttribArray(NORMAL_LOCATION);
+            glVertexAttribPointer(NORMAL_LOCATION, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+            for (unsigned int i = 0; i < m_Entries.size(); i++) {
+                m_Entries[i].IndexType = GL_UNSIGNED_INT;
+                m_Entries[i].IndexOffset = sizeof(unsigned int) * m_Entries[i].BaseIndex;
+            }
+
+            Ret = UploadBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Buffers[INDEX_BUFFER], pIndices, IndexDataSize) && Ret;
+        }
+
+        if (!Ret) {
+            printf("Error writing the mesh buffers\n");
+            return false;
+        }
+
+        printf("Mesh GPU memory: %.1f KB vertices, %.1f KB indices (%.1f KB as 32 bit floats and indices)\n",
+            VertexDataSize / 1024.0f, IndexDataSize / 1024.0f,
+            (FloatVertexSize * NumVertices + sizeof(unsigned int) * NumIndices) / 1024.0f);
+
+        // The instance buffers are attached at render time, see SetMatrixAttribs and SetTRSAttribs
         for (unsigned int i = 0; i < 4; i++) {
-            glEnableVertexAttribArray(WORLD_LOCATION + i);
-            glVertexAttribPointer(WORLD_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), (const GLvoid*)(sizeof(GLfloat) * i * 4));
+            glVertexAttribDivisor(WVP_LOCATION + i, 1);
             glVertexAttribDivisor(WORLD_LOCATION + i, 1);
         }
+        glVertexAttribDivisor(INSTANCE_POS_LOCATION, 1);
+        glVertexAttribDivisor(INSTANCE_ROT_LOCATION, 1);
+        glVertexAttribDivisor(INSTANCE_SCALE_LOCATION, 1);
         return GLCheckError();
     }
+    // Writes the vertices and indices of one mesh of the scene to the given arrays. Only reads
+    // the scene, so several meshes can be converted at the same time.
     void InitMesh(const aiMesh* paiMesh,
-        std::vector<Vector3f>& Positions,
-        std::vector<Vector3f>& Normals,
-        std::vector<Vector2f>& TexCoords,
-        std::vector<unsigned int>& Indices) {
+        Vector3f* pPositions,
+        Vector3f* pNormals,
+        Vector2f* pTexCoords,
+        unsigned int* pIndices) {
         const aiVector3D Zero3D(0.0f, 0.0f, 0.0f);
-        // Populate the vertex attribute vectors
+        // Populate the vertex attribute arrays
         for (unsigned int i = 0; i < paiMesh->mNumVertices; i++) {
             const aiVector3D* pPos = &(paiMesh->mVertices[i]);
             const aiVector3D* pNormal = &(paiMesh->mNormals[i]);
             const aiVector3D* pTexCoord = paiMesh->HasTextureCoords(0) ? &(paiMesh->mTextureCoords[0][i]) : &Zero3D;
 
-            Positions.push_back(Vector3f(pPos->x, pPos->y, pPos->z));
-            Normals.push_back(Vector3f(pNormal->x, pNormal->y, pNormal->z));
-            TexCoords.push_back(Vector2f(pTexCoord->x, pTexCoord->y));
+            pPositions[i] = Vector3f(pPos->x, pPos->y, pPos->z);
+            pNormals[i] = Vector3f(pNormal->x, pNormal->y, pNormal->z);
+            pTexCoords[i] = Vector2f(pTexCoord->x, pTexCoord->y);
         }
-        // Populate the index buffer
+        // Populate the index array
         for (unsigned int i = 0; i < paiMesh->mNumFaces; i++) {
             const aiFace& Face = paiMesh->mFaces[i];
             assert(Face.mNumIndices == 3);
-            Indices.push_back(Face.mIndices[0]);
-            Indices.push_back(Face.mIndices[1]);
-            Indices.push_back(Face.mIndices[2]);
+            pIndices[i * 3] = Face.mIndices[0];
+            pIndices[i * 3 + 1] = Face.mIndices[1];
+            pIndices[i * 3 + 2] = Face.mIndices[2];
         }
     }
 
-    bool InitMaterials(const aiScene* pScene, const std::string& Filename) {
-        // Extract the directory part from the file name
+    // Extracts the directory part from the file name
+    static std::string GetDirectory(const std::string& Filename) {
         string::size_type SlashIndex = Filename.find_last_of("/");
-        string Dir;
 
         if (SlashIndex == string::npos)
-            Dir = ".";
+            return ".";
         else if (SlashIndex == 0)
-            Dir = "/";
+            return "/";
         else
-            Dir = Filename.substr(0, SlashIndex);
+            return Filename.substr(0, SlashIndex);
+    }
 
-        bool Ret = true;
-        // Initialize the materials
+    // Full path of the diffuse texture of every material, empty when it has none
+    void GetTexturePaths(const aiScene* pScene, const std::string& Filename, std::vector<std::string>& Paths) {
+        const string Dir = GetDirectory(Filename);
+
+        Paths.resize(pScene->mNumMaterials);
         for (unsigned int i = 0; i < pScene->mNumMaterials; i++) {
             const aiMaterial* pMaterial = pScene->mMaterials[i];
 
-            m_Textures[i] = NULL;
             if (pMaterial->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
                 aiString Path;
                 if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &Path, NULL, NULL, NULL, NULL, NULL) == AI_SUCCESS) {
                     string p(Path.data);
                     if (p.substr(0, 2) == ".\\")
                         p = p.substr(2, p.size() - 2);
-                    string FullPath = Dir + "/" + p;
-
-                    m_Textures[i] = new Texture(GL_TEXTURE_2D, FullPath.c_str());
-                    if (!m_Textures[i]->Load()) {
-                        printf("Error loading texture '%s'\n", FullPath.c_str());
-                        delete m_Textures[i];
-                        m_Textures[i] = NULL;
-                        Ret = false;
-                    }
-                    else
-                        printf("Loaded texture '%s'\n", FullPath.c_str());
+                    Paths[i] = Dir + "/" + p;
                 }
             }
         }
-        return Ret;
     }
+
+    // The images are read by DecodeTexture and uploaded by UploadStep
+    void CreateTextures(const std::vector<std::string>& Paths) {
+        // Initialize the materials
+        for (unsigned int i = 0; i < Paths.size(); i++)
+            m_Textures[i] = Paths[i].empty() ? NULL : new Texture(GL_TEXTURE_2D, Paths[i].c_str());
+    }
+
     void Clear() {
-        for (unsigned int i = 0; i < m_Textures.size(); i++)
+        for (unsigned int i = 0; i < m_Textures.size(); i++) {
+            if (m_pTextureStreamer && m_Textures[i])
+                m_pTextureStreamer->Remove(m_Textures[i]);
+            if (m_pTextureLoader && m_Textures[i])
+                m_pTextureLoader->Cancel(m_Textures[i]);
             SAFE_DELETE(m_Textures[i]);
+        }
+        m_Textures.clear();
+        m_Entries.clear();
+        m_bounds = BoundingVolume();
+        m_loadState = MESH_STATE_EMPTY;
+
+        m_materialArray.Clear();
+        m_drawCommands.clear();
+        m_multiDraw = false;
+        m_meshlets.clear();
+        m_meshletCommands.clear();
+        m_meshletDraw = false;
+        m_meshletsCulled = false;
 
-        if (m_Buffers[0] != 0)
+        if (m_Buffers[0] != 0) {
             glDeleteBuffers(ARRAY_SIZE_IN_ELEMENTS(m_Buffers), m_Buffers);
+            ZERO_MEM(m_Buffers);
+        }
 
         if (m_VAO != 0) {
             glDeleteVertexArrays(1, &m_VAO);
@@ -252,7 +1522,34 @@ private:
     }
 
     GLuint m_VAO;
-    GLuint m_Buffers[6];
+    GLuint m_Buffers[8];
+    RingBuffer m_instanceRing;
+    GLintptr m_mappedOffset;
+    unsigned int m_mappedNumInstances;
+    bool m_mappedCompact;
+    WeldEpsilons m_weldEpsilons;
+    bool m_quantized;
+    Vector3f m_posOffset;
+    Vector3f m_posScale;
+    unsigned int m_numLods;
+    float m_boundingRadius;
+    bool m_multiDraw;
+    std::vector<DrawElementsIndirectCommand> m_drawCommands;
+    TextureArray m_materialArray;
+    unsigned int m_loadState;
+    ThreadPool* m_pImportPool;
+    TextureLoader* m_pTextureLoader;
+    TextureStreamer* m_pTextureStreamer;
+    BoundingVolume m_bounds;
+    const Frustum* m_pCullFrustum;
+    CullStats m_cullStats;
+    std::vector<Matrix4f> m_visibleWVPMats;   // Render thread scratch for the culled instances
+    std::vector<Matrix4f> m_visibleWorldMats;
+    std::vector<InstanceTRS> m_visibleInstances;
+    std::vector<Meshlet> m_meshlets;
+    std::vector<std::vector<DrawElementsIndirectCommand> > m_meshletCommands; // Per LOD 0 entry, built by CullMeshlets
+    bool m_meshletDraw;
+    bool m_meshletsCulled; // CullMeshlets ran since the last draw
 
     struct MeshEntry {
         MeshEntry()  {
@@ -260,15 +1557,26 @@ private:
             BaseVertex = 0;
             BaseIndex = 0;
             MaterialIndex = INVALID_MATERIAL;
+            IndexType = GL_UNSIGNED_INT;
+            IndexOffset = 0;
+            FirstMeshlet = 0;
+            NumMeshlets = 0;
+            UVDensity = 0.0f;
         }
 
         unsigned int NumIndices;
         unsigned int BaseVertex;
         unsigned int BaseIndex;
         unsigned int MaterialIndex;
+        GLenum IndexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        size_t IndexOffset; // Byte offset of the first index in the index buffer
+        BoundingVolume Bounds;
+        unsigned int FirstMeshlet; // LOD 0 only
+        unsigned int NumMeshlets;
+        float UVDensity; // UV units per model space unit, 0 without a texture mapping
     };
 
-    std::vector<MeshEntry> m_Entries;
+    std::vector<MeshEntry> m_Entries; // The entries of LOD 0 followed by the ones of every further LOD
     std::vector<Texture*> m_Textures;
 };
 
@@ -0,0 +1,211 @@
+#ifndef MESH_CACHE_H
+#define	MESH_CACHE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Math_3d.h"
+#include "Mapped_file.h"
+#include "Mesh_optimizer.h"
+
+// Binary copy of the final vertex and index buffers of a Mesh, stored next to the source file
+// as <source>.meshcache. Layout: MeshCacheHeader, the MeshCacheEntry table, one length-prefixed
+// texture path per material (empty when the material has no texture), padding to 4 bytes, then
+// positions, normals, texcoords and indices.
+
+#define MESH_CACHE_MAGIC   0x4348534D // "MSHC"
+#define MESH_CACHE_VERSION 4
+
+struct MeshCacheEntry {
+    unsigned int NumIndices;
+    unsigned int BaseVertex;
+    unsigned int BaseIndex;
+    unsigned int MaterialIndex;
+};
+
+struct MeshCacheHeader {
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned long long SourceSize;
+    long long SourceTime;
+    unsigned int LoadFlags; // The cached buffers depend on the Mesh::LoadMesh flags
+    WeldEpsilons Weld;      // and on the welding tolerances
+    unsigned int NumEntries; // Of all LODs, LOD after LOD
+    unsigned int NumLods;
+    unsigned int NumMaterials;
+    unsigned int NumVertices;
+    unsigned int NumIndices;
+};
+
+// Contents of a cache file. The arrays point into the mapped file.
+struct MeshCacheView {
+    unsigned int NumEntries; // Per LOD
+    unsigned int NumLods;
+    unsigned int NumVertices;
+    unsigned int NumIndices;
+    const MeshCacheEntry* pEntries;
+    const Vector3f* pPositions;
+    const Vector3f* pNormals;
+    const Vector2f* pTexCoords;
+    const unsigned int* pIndices;
+    std::vector<std::string> TexturePaths;
+};
+
+inline std::string GetMeshCacheFilename(const std::string& Filename) {
+    return Filename + ".meshcache";
+}
+
+static bool GetSourceFileInfo(const std::string& Filename, unsigned long long& Size, long long& Time) {
+    struct stat Info;
+    if (stat(Filename.c_str(), &Info) != 0)
+        return false;
+
+    Size = (unsigned long long)Info.st_size;
+    Time = (long long)Info.st_mtime;
+    return true;
+}
+
+// Fails when the cache is missing, corrupt, from another version, built with other load options or
+// older than the source file
+static bool ReadMeshCache(const MappedFile& File, const std::string& SourceFilename, unsigned int LoadFlags, const WeldEpsilons& Weld,
+    MeshCacheView& View) {
+    const unsigned char* p = File.GetData();
+    const size_t Size = File.GetSize();
+
+    if (!p || Size < sizeof(MeshCacheHeader))
+        return false;
+
+    MeshCacheHeader Header;
+    memcpy(&Header, p, sizeof(Header));
+
+    unsigned long long SourceSize = 0;
+    long long SourceTime = 0;
+    if (Header.Magic != MESH_CACHE_MAGIC || Header.Version != MESH_CACHE_VERSION || Header.LoadFlags != LoadFlags || !(Header.Weld == Weld) ||
+        !GetSourceFileInfo(SourceFilename, SourceSize, SourceTime) ||
+        Header.SourceSize != SourceSize || Header.SourceTime != SourceTime ||
+        Header.NumLods == 0 || Header.NumEntries % Header.NumLods != 0)
+        return false;
+
+    size_t Offset = sizeof(Header);
+    const size_t EntriesSize = sizeof(MeshCacheEntry) * Header.NumEntries;
+    if (Offset + EntriesSize > Size)
+        return false;
+    View.pEntries = (const MeshCacheEntry*)(p + Offset);
+    Offset += EntriesSize;
+
+    View.TexturePaths.resize(Header.NumMaterials);
+    for (unsigned int i = 0; i < Header.NumMaterials; i++) {
+        unsigned int Length = 0;
+        if (Offset + sizeof(Length) > Size)
+            return false;
+        memcpy(&Length, p + Offset, sizeof(Length));
+        Offset += sizeof(Length);
+
+        if (Offset + Length > Size)
+            return false;
+        View.TexturePaths[i].assign((const char*)(p + Offset), Length);
+        Offset += Length;
+    }
+    Offset = (Offset + 3) & ~(size_t)3;
+
+    const size_t VertexDataSize = (2 * sizeof(Vector3f) + sizeof(Vector2f)) * Header.NumVertices;
+    if (Offset + VertexDataSize + sizeof(unsigned int) * Header.NumIndices != Size)
+        return false;
+
+    View.pPositions = (const Vector3f*)(p + Offset);
+    Offset += sizeof(Vector3f) * Header.NumVertices;
+    View.pNormals = (const Vector3f*)(p + Offset);
+    Offset += sizeof(Vector3f) * Header.NumVertices;
+    View.pTexCoords = (const Vector2f*)(p + Offset);
+    Offset += sizeof(Vector2f) * Header.NumVertices;
+    View.pIndices = (const unsigned int*)(p + Offset);
+
+    // The buffers are used as they are, so broken ranges or indices would make the CPU passes
+    // and the GPU read outside them. An entry owns the vertices up to the next LOD 0 entry and
+    // shares them with its LOD entries.
+    const unsigned int NumEntries = Header.NumEntries / Header.NumLods;
+    for (unsigned int i = 0; i < Header.NumEntries; i++) {
+        const MeshCacheEntry& Entry = View.pEntries[i];
+        const unsigned int Index = i % NumEntries;
+        const unsigned int BaseVertex = View.pEntries[Index].BaseVertex;
+        const unsigned int EndVertex = Index + 1 < NumEntries ? View.pEntries[Index + 1].BaseVertex : Header.NumVertices;
+        if (Entry.BaseVertex != BaseVertex || BaseVertex > EndVertex || EndVertex > Header.NumVertices ||
+            (unsigned long long)Entry.BaseIndex + Entry.NumIndices > Header.NumIndices)
+            return false;
+
+        const unsigned int* pEntryIndices = View.pIndices + Entry.BaseIndex;
+        for (unsigned int j = 0; j < Entry.NumIndices; j++)
+            if (pEntryIndices[j] >= EndVertex - BaseVertex)
+                return false;
+    }
+
+    View.NumEntries = NumEntries;
+    View.NumLods = Header.NumLods;
+    View.NumVertices = Header.NumVertices;
+    View.NumIndices = Header.NumIndices;
+    return true;
+}
+
+static bool WriteMeshCache(const std::string& SourceFilename, unsigned int LoadFlags, const WeldEpsilons& Weld,
+    const std::vector<MeshCacheEntry>& Entries, unsigned int NumLods,
+    const std::vector<std::string>& TexturePaths,
+    const std::vector<Vector3f>& Positions,
+    const std::vector<Vector3f>& Normals,
+    const std::vector<Vector2f>& TexCoords,
+    const std::vector<unsigned int>& Indices) {
+    MeshCacheHeader Header;
+    Header.Magic = MESH_CACHE_MAGIC;
+    Header.Version = MESH_CACHE_VERSION;
+    Header.LoadFlags = LoadFlags;
+    Header.Weld = Weld;
+    if (!GetSourceFileInfo(SourceFilename, Header.SourceSize, Header.SourceTime))
+        return false;
+    Header.NumEntries = (unsigned int)Entries.size();
+    Header.NumLods = NumLods;
+    Header.NumMaterials = (unsigned int)TexturePaths.size();
+    Header.NumVertices = (unsigned int)Positions.size();
+    Header.NumIndices = (unsigned int)Indices.size();
+
+    const std::string CacheFilename = GetMeshCacheFilename(SourceFilename);
+    std::ofstream f(CacheFilename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!f) {
+        printf("Can't write mesh cache '%s'\n", CacheFilename.c_str());
+        return false;
+    }
+
+    f.write((const char*)&Header, sizeof(Header));
+    if (!Entries.empty())
+        f.write((const char*)&Entries[0], sizeof(Entries[0]) * Entries.size());
+
+    size_t Offset = sizeof(Header) + sizeof(MeshCacheEntry) * Entries.size();
+    for (unsigned int i = 0; i < TexturePaths.size(); i++) {
+        const unsigned int Length = (unsigned int)TexturePaths[i].size();
+        f.write((const char*)&Length, sizeof(Length));
+        f.write(TexturePaths[i].data(), Length);
+        Offset += sizeof(Length) + Length;
+    }
+
+    const char Padding[4] = { 0 };
+    f.write(Padding, ((Offset + 3) & ~(size_t)3) - Offset);
+
+    if (!Positions.empty()) {
+        f.write((const char*)&Positions[0], sizeof(Positions[0]) * Positions.size());
+        f.write((const char*)&Normals[0], sizeof(Normals[0]) * Normals.size());
+        f.write((const char*)&TexCoords[0], sizeof(TexCoords[0]) * TexCoords.size());
+    }
+    if (!Indices.empty())
+        f.write((const char*)&Indices[0], sizeof(Indices[0]) * Indices.size());
+
+    f.close();
+    if (!f) {
+        remove(CacheFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,155 @@
+#ifndef MESH_LOADER_H
+#define	MESH_LOADER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "Util.h"
+#include "Mesh.h"
+#include "Thread_pool.h"
+
+#define MESH_LOADER_NUM_WORKERS 2
+
+// Loads meshes in the background. Parsing, welding, optimization, LOD generation and texture
+// decoding run on the loader threads. The GL work is queued for the render thread, which runs it
+// from ProcessUploads under a time budget per frame. A mesh can be rendered as soon as its state
+// turns to MESH_STATE_READY.
+//
+// The loader has its own threads because a load task would block the ParallelFor calls of a
+// shared pool for its whole duration.
+class MeshLoader {
+public:
+    MeshLoader(unsigned int NumWorkers = MESH_LOADER_NUM_WORKERS) : m_pool(NumWorkers) {
+        m_pUploading = NULL;
+        m_numParsing = 0;
+        m_numPending = 0;
+    }
+
+    ~MeshLoader() {
+        // The tasks reference the jobs, so wait until all of them are parsed
+        {
+            std::unique_lock<std::mutex> Lock(m_mutex);
+            m_parsedCond.wait(Lock, [this]() { return m_numParsing == 0; });
+        }
+
+        if (m_pUploading)
+            m_parsed.push_front(m_pUploading);
+        for (unsigned int i = 0; i < m_parsed.size(); i++) {
+            m_parsed[i]->pMesh->Clear();
+            m_parsed[i]->pMesh->m_loadState = MESH_STATE_FAILED;
+            delete m_parsed[i];
+        }
+    }
+
+    // Returns right away. pMesh stays in MESH_STATE_LOADING until ProcessUploads has run its last
+    // upload step and must not be deleted before.
+    void LoadMeshAsync(Mesh* pMesh, const std::string& Filename, unsigned int Flags = 0) {
+        pMesh->Clear();
+        pMesh->m_loadState = MESH_STATE_LOADING;
+
+        Job* pJob = new Job;
+        pJob->pMesh = pMesh;
+        pJob->NumTasks = 0;
+        pJob->Failed = false;
+        {
+            std::lock_guard<std::mutex> Lock(m_mutex);
+            m_numParsing++;
+            m_numPending++;
+        }
+
+        m_pool.Submit([this, pJob, Filename, Flags]() {
+            Parse(pJob, Filename, Flags);
+        });
+    }
+
+    // Called on the render thread once per frame. Runs upload steps of the parsed meshes until
+    // BudgetMicros have passed, at least one step when there is work.
+    void ProcessUploads(long long BudgetMicros) {
+        const long long Start = GetCurrentTimeMicros();
+
+        do {
+            if (!m_pUploading) {
+                std::lock_guard<std::mutex> Lock(m_mutex);
+                if (m_parsed.empty())
+                    return;
+                m_pUploading = m_parsed.front();
+                m_parsed.pop_front();
+            }
+
+            Mesh* pMesh = m_pUploading->pMesh;
+            bool Done = false;
+            if (m_pUploading->Failed || !pMesh->UploadStep(m_pUploading->Data, Done)) {
+                printf("Error loading mesh '%s'\n", m_pUploading->Data.Filename.c_str());
+                pMesh->Clear();
+                pMesh->m_loadState = MESH_STATE_FAILED;
+                Done = true;
+            }
+            else if (Done)
+                pMesh->m_loadState = MESH_STATE_READY;
+
+            if (Done) {
+                delete m_pUploading;
+                m_pUploading = NULL;
+
+                std::lock_guard<std::mutex> Lock(m_mutex);
+                m_numPending--;
+            }
+        } while (GetCurrentTimeMicros() - Start < BudgetMicros);
+    }
+
+    // Number of meshes which are not ready or failed yet
+    unsigned int GetNumPending() {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        return m_numPending;
+    }
+
+private:
+    struct Job {
+        Mesh* pMesh;
+        MeshData Data;
+        std::atomic<unsigned int> NumTasks; // Texture decodes still running
+        std::atomic<bool> Failed;
+    };
+
+    // Loader thread: parses the mesh, then decodes its textures in parallel
+    void Parse(Job* pJob, const std::string& Filename, unsigned int Flags) {
+        Mesh* pMesh = pJob->pMesh;
+        if (!pMesh->ParseMesh(Filename, Flags, pJob->Data))
+            pJob->Failed = true;
+
+        const unsigned int NumTextures = pMesh->StreamsTextures(pJob->Data.Flags) ? 0 : (unsigned int)pMesh->m_Textures.size();
+        if (pJob->Failed || NumTextures == 0) {
+            Parsed(pJob);
+            return;
+        }
+
+        pJob->NumTasks = NumTextures;
+        for (unsigned int i = 0; i < NumTextures; i++) {
+            m_pool.Submit([this, pJob, pMesh, i]() {
+                pMesh->DecodeTexture(i);
+                if (--pJob->NumTasks == 0)
+                    Parsed(pJob);
+            });
+        }
+    }
+
+    void Parsed(Job* pJob) {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        m_parsed.push_back(pJob);
+        m_numParsing--;
+        m_parsedCond.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_parsedCond;
+    std::deque<Job*> m_parsed; // Waiting for the render thread
+    Job* m_pUploading;         // Render thread only
+    unsigned int m_numParsing;
+    unsigned int m_numPending;
+    ThreadPool m_pool;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#ifndef MESH_MESHLETS_H
+#define	MESH_MESHLETS_H
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "Math_3d.h"
+
+// Load time clustering of a sub-mesh into meshlets for per cluster culling. Like the other mesh
+// passes it works on triangle list indices relative to the first vertex of the sub-mesh.
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+#define MESHLET_MIN_CONE_DOT  0.1f // Clusters with normals spread wider than this get no cone
+
+// A run of consecutive triangles of the index buffer with its bounding sphere and normal cone.
+// The cone test follows meshoptimizer: the cluster faces away from a camera at Pos when
+// dot(Center - Pos, ConeAxis) >= ConeCutoff * |Center - Pos| + Radius. ConeCutoff 1 never culls.
+struct Meshlet {
+    unsigned int FirstIndex;
+    unsigned int NumIndices;
+    Vector3f Center;
+    float Radius;
+    Vector3f ConeAxis;
+    float ConeCutoff;
+};
+
+static void CalcMeshletBounds(const unsigned int* pIndices, unsigned int NumIndices, const Vector3f* pPositions, Meshlet& m) {
+    Vector3f Min = pPositions[pIndices[0]];
+    Vector3f Max = Min;
+    for (unsigned int i = 1; i < NumIndices; i++) {
+        const Vector3f& p = pPositions[pIndices[i]];
+        Min = Vector3f(std::min(Min.x, p.x), std::min(Min.y, p.y), std::min(Min.z, p.z));
+        Max = Vector3f(std::max(Max.x, p.x), std::max(Max.y, p.y), std::max(Max.z, p.z));
+    }
+
+    m.Center = (Min + Max) * 0.5f;
+    float MaxDistSq = 0.0f;
+    for (unsigned int i = 0; i < NumIndices; i++) {
+        const Vector3f d = pPositions[pIndices[i]] - m.Center;
+        MaxDistSq = std::max(MaxDistSq, d.x * d.x + d.y * d.y + d.z * d.z);
+    }
+    m.Radius = sqrtf(MaxDistSq);
+
+    // The cone axis is the average of the unit triangle normals, the cutoff comes from the
+    // normal furthest away from it
+    std::vector<Vector3f> Normals;
+    Normals.reserve(NumIndices / 3);
+    Vector3f Axis(0.0f, 0.0f, 0.0f);
+    for (unsigned int i = 0; i + 2 < NumIndices; i += 3) {
+        const Vector3f& p0 = pPositions[pIndices[i]];
+        Vector3f n = (pPositions[pIndices[i + 1]] - p0).Cross(pPositions[pIndices[i + 2]] - p0);
+        const float Length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+        if (Length == 0.0f)
+            continue;
+        n *= 1.0f / Length;
+        Normals.push_back(n);
+        Axis += n;
+    }
+
+    m.ConeAxis = Vector3f(0.0f, 0.0f, 0.0f);
+    m.ConeCutoff = 1.0f;
+    const float AxisLength = sqrtf(Axis.x * Axis.x + Axis.y * Axis.y + Axis.z * Axis.z);
+    if (Normals.empty() || AxisLength == 0.0f)
+        return;
+    Axis *= 1.0f / AxisLength;
+
+    float MinDot = 1.0f;
+    for (unsigned int i = 0; i < Normals.size(); i++)
+        MinDot = std::min(MinDot, Normals[i].x * Axis.x + Normals[i].y * Axis.y + Normals[i].z * Axis.z);
+    if (MinDot <= MESHLET_MIN_CONE_DOT)
+        return;
+
+    m.ConeAxis = Axis;
+    m.ConeCutoff = sqrtf(1.0f - MinDot * MinDot);
+}
+
+// Cuts the triangles into meshlets in index buffer order, so that every meshlet is a contiguous
+// index range and the index buffer stays as it is. The order left by OptimizeVertexCache keeps
+// the triangles of a meshlet close together. FirstIndex is relative to pIndices.
+static void BuildMeshlets(const unsigned int* pIndices, unsigned int NumIndices, const Vector3f* pPositions, unsigned int NumVertices,
+    std::vector<Meshlet>& Meshlets) {
+    // Stamp of the meshlet that last used every vertex
+    std::vector<unsigned int> Stamps(NumVertices, 0xFFFFFFFF);
+    unsigned int Stamp = 0;
+    unsigned int First = 0;
+    unsigned int NumMeshletVertices = 0;
+
+    for (unsigned int i = 0; i + 2 < NumIndices; i += 3) {
+        unsigned int NumNew = 0;
+        for (unsigned int k = 0; k < 3; k++) {
+            const unsigned int v = pIndices[i + k];
+            NumNew += Stamps[v] != Stamp && (k == 0 || v != pIndices[i]) && (k < 2 || v != pIndices[i + 1]);
+        }
+
+        if (NumMeshletVertices + NumNew > MESHLET_MAX_VERTICES || (i - First) / 3 >= MESHLET_MAX_TRIANGLES) {
+            Meshlet m;
+            m.FirstIndex = First;
+            m.NumIndices = i - First;
+            CalcMeshletBounds(pIndices + First, m.NumIndices, pPositions, m);
+            Meshlets.push_back(m);
+
+            Stamp++;
+            First = i;
+            NumMeshletVertices = 0;
+        }
+
+        for (unsigned int k = 0; k < 3; k++) {
+            const unsigned int v = pIndices[i + k];
+            if (Stamps[v] != Stamp) {
+                Stamps[v] = Stamp;
+                NumMeshletVertices++;
+            }
+        }
+    }
+
+    const unsigned int End = NumIndices / 3 * 3;
+    if (End > First) {
+        Meshlet m;
+        m.FirstIndex = First;
+        m.NumIndices = End - First;
+        CalcMeshletBounds(pIndices + First, m.NumIndices, pPositions, m);
+        Meshlets.push_back(m);
+    }
+}
+
+// Camera position in the model space of the meshlet
+static inline bool IsMeshletBackFacing(const Meshlet& m, const Vector3f& CameraPos) {
+    const Vector3f d = m.Center - CameraPos;
+    const float Distance = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+    return d.x * m.ConeAxis.x + d.y * m.ConeAxis.y + d.z * m.ConeAxis.z >= m.ConeCutoff * Distance + m.Radius;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#ifndef MESH_OPTIMIZER_H
+#define	MESH_OPTIMIZER_H
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include "Math_3d.h"
+
+// Load time index and vertex buffer optimizations. All functions work on one sub-mesh with
+// triangle list indices relative to its first vertex.
+
+#define VERTEX_CACHE_SIZE 32 // LRU size used by the Forsyth scoring
+#define FIFO_CACHE_SIZE   16 // Post-transform cache size used for the statistics and the clustering
+
+// Simulates a FIFO post-transform cache. Returns the number of cache misses.
+static unsigned int SimulateVertexCache(const unsigned int* pIndices, unsigned int NumIndices, unsigned int NumVertices,
+    unsigned int CacheSize = FIFO_CACHE_SIZE) {
+    // A vertex is in the cache when it was transformed less than CacheSize misses ago
+    std::vector<unsigned int> TimeStamps(NumVertices, 0);
+    unsigned int Time = CacheSize + 1;
+    unsigned int NumMisses = 0;
+
+    for (unsigned int i = 0; i < NumIndices; i++) {
+        const unsigned int v = pIndices[i];
+        if (Time - TimeStamps[v] > CacheSize) {
+            TimeStamps[v] = Time++;
+            NumMisses++;
+        }
+    }
+    return NumMisses;
+}
+
+static float ForsythVertexScore(int CachePos, unsigned int NumRemainingTris) {
+    if (NumRemainingTris == 0)
+        return -1.0f;
+
+    float Score = 0.0f;
+    if (CachePos >= 0) {
+        // The last triangle's vertices get a fixed score so that its neighbours are not preferred too much
+        if (CachePos < 3)
+            Score = 0.75f;
+        else
+            Score = powf(1.0f - (float)(CachePos - 3) / (float)(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    // Prefer vertices with few triangles left so that they can leave the working set
+    return Score + 2.0f / sqrtf((float)NumRemainingTris);
+}
+
+// Reorders the triangles for post-transform cache locality (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+static void OptimizeVertexCache(unsigned int* pIndices, unsigned int NumIndices, unsigned int NumVertices) {
+    const unsigned int NumTris = NumIndices / 3;
+    if (NumTris == 0)
+        return;
+
+    // Triangle adjacency of every vertex
+    std::vector<unsigned int> TriCount(NumVertices, 0);
+    for (unsigned int i = 0; i < NumIndices; i++)
+        TriCount[pIndices[i]]++;
+
+    std::vector<unsigned int> TriOffset(NumVertices + 1, 0);
+    for (unsigned int v = 0; v < NumVertices; v++)
+        TriOffset[v + 1] = TriOffset[v] + TriCount[v];
+
+    std::vector<unsigned int> AdjTris(NumIndices);
+    std::vector<unsigned int> Fill(TriOffset.begin(), TriOffset.end() - 1);
+    for (unsigned int i = 0; i < NumIndices; i++)
+        AdjTris[Fill[pIndices[i]]++] = i / 3;
+
+    std::vector<int> CachePos(NumVertices, -1);
+    std::vector<float> VertexScore(NumVertices);
+    for (unsigned int v = 0; v < NumVertices; v++)
+        VertexScore[v] = ForsythVertexScore(-1, TriCount[v]);
+
+    std::vector<float> TriScore(NumTris);
+    for (unsigned int t = 0; t < NumTris; t++)
+        TriScore[t] = VertexScore[pIndices[t * 3]] + VertexScore[pIndices[t * 3 + 1]] + VertexScore[pIndices[t * 3 + 2]];
+
+    std::vector<bool> Emitted(NumTris, false);
+    std::vector<unsigned int> Result;
+    Result.reserve(NumIndices);
+
+    std::vector<unsigned int> Cache, NewCache;
+    Cache.reserve(VERTEX_CACHE_SIZE + 3);
+    NewCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    unsigned int NextCandidate = 0; // Linear scan position used when the cache gives no candidate
+    int BestTri = -1;
+
+    for (unsigned int n = 0; n < NumTris; n++) {
+        if (BestTri < 0) {
+            float BestScore = -1.0f;
+            while (NextCandidate < NumTris && Emitted[NextCandidate])
+                NextCandidate++;
+            // Take the best of a bounded window to keep this linear
+            for (unsigned int t = NextCandidate; t < NumTris && t < NextCandidate + 64; t++) {
+                if (!Emitted[t] && TriScore[t] > BestScore) {
+                    BestScore = TriScore[t];
+                    BestTri = (int)t;
+                }
+            }
+        }
+
+        const unsigned int* pTri = &pIndices[BestTri * 3];
+        Emitted[BestTri] = true;
+        Result.push_back(pTri[0]);
+        Result.push_back(pTri[1]);
+        Result.push_back(pTri[2]);
+
+        // Remove the triangle from the adjacency of its vertices
+        for (unsigned int k = 0; k < 3; k++) {
+            const unsigned int v = pTri[k];
+            unsigned int* pBegin = &AdjTris[TriOffset[v]];
+            unsigned int* pEnd = pBegin + TriCount[v];
+            unsigned int* pFound = std::find(pBegin, pEnd, (unsigned int)BestTri);
+            *pFound = *(pEnd - 1);
+            TriCount[v]--;
+        }
+
+        // Move the triangle to the front of the LRU cache
+        NewCache.clear();
+        NewCache.push_back(pTri[0]);
+        NewCache.push_back(pTri[1]);
+        NewCache.push_back(pTri[2]);
+        for (unsigned int i = 0; i < Cache.size(); i++) {
+            const unsigned int v = Cache[i];
+            if (v != pTri[0] && v != pTri[1] && v != pTri[2])
+                NewCache.push_back(v);
+        }
+
+        // Vertices which fall out of the cache lose their cache bonus
+        for (unsigned int i = VERTEX_CACHE_SIZE; i < NewCache.size(); i++) {
+            const unsigned int v = NewCache[i];
+            CachePos[v] = -1;
+            VertexScore[v] = ForsythVertexScore(-1, TriCount[v]);
+            for (unsigned int j = 0; j < TriCount[v]; j++) {
+                const unsigned int t = AdjTris[TriOffset[v] + j];
+                TriScore[t] = VertexScore[pIndices[t * 3]] + VertexScore[pIndices[t * 3 + 1]] + VertexScore[pIndices[t * 3 + 2]];
+            }
+        }
+        if (NewCache.size() > VERTEX_CACHE_SIZE)
+            NewCache.resize(VERTEX_CACHE_SIZE);
+        Cache.swap(NewCache);
+
+        // Rescore the cached vertices and pick the next triangle among their neighbours
+        for (unsigned int i = 0; i < Cache.size(); i++) {
+            const unsigned int v = Cache[i];
+            CachePos[v] = (int)i;
+            VertexScore[v] = ForsythVertexScore((int)i, TriCount[v]);
+        }
+
+        BestTri = -1;
+        float BestScore = -1.0f;
+        for (unsigned int i = 0; i < Cache.size(); i++) {
+            const unsigned int v = Cache[i];
+            for (unsigned int j = 0; j < TriCount[v]; j++) {
+                const unsigned int t = AdjTris[TriOffset[v] + j];
+                TriScore[t] = VertexScore[pIndices[t * 3]] + VertexScore[pIndices[t * 3 + 1]] + VertexScore[pIndices[t * 3 + 2]];
+                if (TriScore[t] > BestScore) {
+                    BestScore = TriScore[t];
+                    BestTri = (int)t;
+                }
+            }
+        }
+    }
+
+    std::copy(Result.begin(), Result.end(), pIndices);
+}
+
+// Reorders clusters of triangles so that the ones facing away from the mesh center are drawn first,
+// which lets the depth test reject more of the rest. The clusters are split where the FIFO cache
+// starts cold anyway so the vertex cache efficiency of OptimizeVertexCache is kept.
+static void OptimizeOverdraw(unsigned int* pIndices, unsigned int NumIndices, const Vector3f* pPositions, unsigned int NumVertices) {
+    const unsigned int NumTris = NumIndices / 3;
+    if (NumTris == 0)
+        return;
+
+    // A cluster starts at every triangle whose three vertices all miss the cache
+    std::vector<unsigned int> ClusterStart;
+    std::vector<unsigned int> TimeStamps(NumVertices, 0);
+    unsigned int Time = FIFO_CACHE_SIZE + 1;
+
+    for (unsigned int t = 0; t < NumTris; t++) {
+        unsigned int NumMisses = 0;
+        for (unsigned int k = 0; k < 3; k++) {
+            const unsigned int v = pIndices[t * 3 + k];
+            if (Time - TimeStamps[v] > FIFO_CACHE_SIZE) {
+                TimeStamps[v] = Time++;
+                NumMisses++;
+            }
+        }
+        if (t == 0 || NumMisses == 3)
+            ClusterStart.push_back(t);
+    }
+    ClusterStart.push_back(NumTris);
+
+    const unsigned int NumClusters = (unsigned int)ClusterStart.size() - 1;
+    if (NumClusters < 2)
+        return;
+
+    Vector3f MeshCenter(0.0f, 0.0f, 0.0f);
+    for (unsigned int v = 0; v < NumVertices; v++)
+        MeshCenter += pPositions[v];
+    MeshCenter *= 1.0f / (float)NumVertices;
+
+    std::vector<std::pair<float, unsigned int> > Order(NumClusters);
+    for (unsigned int c = 0; c < NumClusters; c++) {
+        Vector3f Center(0.0f, 0.0f, 0.0f);
+        Vector3f Normal(0.0f, 0.0f, 0.0f);
+        float Area = 0.0f;
+
+        for (unsigned int t = ClusterStart[c]; t < ClusterStart[c + 1]; t++) {
+            const Vector3f& p0 = pPositions[pIndices[t * 3]];
+            const Vector3f& p1 = pPositions[pIndices[t * 3 + 1]];
+            const Vector3f& p2 = pPositions[pIndices[t * 3 + 2]];
+            // The cross product is the area weighted normal
+            const Vector3f n = (p1 - p0).Cross(p2 - p0);
+            const float TriArea = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+            Center += (p0 + p1 + p2) * (TriArea / 3.0f);
+            Normal += n;
+            Area += TriArea;
+        }
+
+        float Score = 0.0f;
+        if (Area > 0.0f) {
+            Center *= 1.0f / Area;
+            const Vector3f d = Center - MeshCenter;
+            Score = d.x * Normal.x + d.y * Normal.y + d.z * Normal.z;
+        }
+        Order[c] = std::make_pair(-Score, c);
+    }
+    std::stable_sort(Order.begin(), Order.end());
+
+    std::vector<unsigned int> Result;
+    Result.reserve(NumIndices);
+    for (unsigned int i = 0; i < NumClusters; i++) {
+        const unsigned int c = Order[i].second;
+        Result.insert(Result.end(), pIndices + ClusterStart[c] * 3, pIndices + ClusterStart[c + 1] * 3);
+    }
+    std::copy(Result.begin(), Result.end(), pIndices);
+}
+
+// Per attribute tolerances of WeldVertices. Zero welds bitwise equal values only.
+struct WeldEpsilons {
+    float Position;
+    float Normal;
+    float TexCoord;
+
+    WeldEpsilons(float PositionEps = 1e-5f, float NormalEps = 1e-3f, float TexCoordEps = 1e-5f) {
+        Position = PositionEps;
+        Normal = NormalEps;
+        TexCoord = TexCoordEps;
+    }
+
+    bool operator==(const WeldEpsilons& r) const {
+        return Position == r.Position && Normal == r.Normal && TexCoord == r.TexCoord;
+    }
+};
+
+static inline bool WeldMatch(const Vector3f& a, const Vector3f& b, float Eps) {
+    return fabsf(a.x - b.x) <= Eps && fabsf(a.y - b.y) <= Eps && fabsf(a.z - b.z) <= Eps;
+}
+
+static inline unsigned long long WeldCellKey(long long x, long long y, long long z) {
+    return ((unsigned long long)x * 73856093ULL) ^ ((unsigned long long)y * 19349663ULL << 21) ^ ((unsigned long long)z * 83492791ULL << 42);
+}
+
+// Merges the vertices whose attributes all lie within the given tolerances, compacts the
+// vertex arrays in place and rewrites the indices. Returns the new number of vertices.
+static unsigned int WeldVertices(unsigned int* pIndices, unsigned int NumIndices,
+    Vector3f* pPositions, Vector3f* pNormals, Vector2f* pTexCoords, unsigned int NumVertices, const WeldEpsilons& Eps) {
+    const unsigned int End = 0xFFFFFFFF;
+    // Positions are hashed into a grid with the cell size of the position tolerance, so a
+    // matching vertex is always in the same or in one of the 26 neighbouring cells
+    const float CellSize = Eps.Position > 0.0f ? Eps.Position : 1.0f;
+    const int Range = Eps.Position > 0.0f ? 1 : 0;
+
+    std::unordered_map<unsigned long long, unsigned int> CellHeads;
+    CellHeads.reserve(NumVertices);
+    std::vector<unsigned int> NextInCell(NumVertices, End);
+    std::vector<unsigned int> Remap(NumVertices);
+    unsigned int NumUnique = 0;
+
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        const Vector3f& Pos = pPositions[v];
+        const long long cx = (long long)floorf(Pos.x / CellSize);
+        const long long cy = (long long)floorf(Pos.y / CellSize);
+        const long long cz = (long long)floorf(Pos.z / CellSize);
+
+        unsigned int Match = End;
+        for (int dz = -Range; dz <= Range && Match == End; dz++) {
+            for (int dy = -Range; dy <= Range && Match == End; dy++) {
+                for (int dx = -Range; dx <= Range && Match == End; dx++) {
+                    std::unordered_map<unsigned long long, unsigned int>::const_iterator it = CellHeads.find(WeldCellKey(cx + dx, cy + dy, cz + dz));
+                    if (it == CellHeads.end())
+                        continue;
+                    // Unique vertices were already compacted to the front of the arrays
+                    for (unsigned int u = it->second; u != End; u = NextInCell[u]) {
+                        if (WeldMatch(pPositions[u], Pos, Eps.Position) &&
+                            WeldMatch(pNormals[u], pNormals[v], Eps.Normal) &&
+                            fabsf(pTexCoords[u].x - pTexCoords[v].x) <= Eps.TexCoord &&
+                            fabsf(pTexCoords[u].y - pTexCoords[v].y) <= Eps.TexCoord) {
+                            Match = u;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (Match == End) {
+            Match = NumUnique++;
+            pPositions[Match] = pPositions[v];
+            pNormals[Match] = pNormals[v];
+            pTexCoords[Match] = pTexCoords[v];
+
+            unsigned int& Head = CellHeads.insert(std::make_pair(WeldCellKey(cx, cy, cz), End)).first->second;
+            NextInCell[Match] = Head;
+            Head = Match;
+        }
+        Remap[v] = Match;
+    }
+
+    for (unsigned int i = 0; i < NumIndices; i++)
+        pIndices[i] = Remap[pIndices[i]];
+
+    return NumUnique;
+}
+
+// Renumbers the vertices in the order the indices first use them, so that vertex fetch walks
+// memory linearly. Unreferenced vertices go to the end.
+static void OptimizeVertexFetch(unsigned int* pIndices, unsigned int NumIndices,
+    Vector3f* pPositions, Vector3f* pNormals, Vector2f* pTexCoords, unsigned int NumVertices) {
+    const unsigned int Unused = 0xFFFFFFFF;
+    std::vector<unsigned int> Remap(NumVertices, Unused);
+    unsigned int NextVertex = 0;
+
+    for (unsigned int i = 0; i < NumIndices; i++) {
+        unsigned int& NewIndex = Remap[pIndices[i]];
+        if (NewIndex == Unused)
+            NewIndex = NextVertex++;
+        pIndices[i] = NewIndex;
+    }
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        if (Remap[v] == Unused)
+            Remap[v] = NextVertex++;
+    }
+
+    std::vector<Vector3f> Positions(pPositions, pPositions + NumVertices);
+    std::vector<Vector3f> Normals(pNormals, pNormals + NumVertices);
+    std::vector<Vector2f> TexCoords(pTexCoords, pTexCoords + NumVertices);
+    for (unsigned int v = 0; v < NumVertices; v++) {
+        pPositions[Remap[v]] = Positions[v];
+        pNormals[Remap[v]] = Normals[v];
+        pTexCoords[Remap[v]] = TexCoords[v];
+    }
+}
+
+#endif
\ No newline at end of file
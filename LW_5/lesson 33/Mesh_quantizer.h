@@ -0,0 +1,123 @@
+#ifndef MESH_QUANTIZER_H
+#define	MESH_QUANTIZER_H
+
+#include <math.h>
+#include <string.h>
+
+#include "Math_3d.h"
+
+// Compact vertex attribute encodings used by MESH_LOAD_QUANTIZE:
+// positions  - 16 bit unsigned normalized inside the mesh bounding box (padded to 4 components)
+// normals    - octahedral encoding in 2 x 16 bit signed normalized
+// tex coords - 2 x half float
+
+struct QuantizedPosition {
+    unsigned short x, y, z, w;
+};
+
+struct QuantizedNormal {
+    short x, y;
+};
+
+struct QuantizedTexCoord {
+    unsigned short u, v;
+};
+
+// Round to nearest even is not needed for vertex data, ties round away from zero
+static unsigned short FloatToHalf(float f) {
+    unsigned int Bits;
+    memcpy(&Bits, &f, sizeof(Bits));
+
+    const unsigned int Sign = (Bits >> 16) & 0x8000;
+    const int Exponent = (int)((Bits >> 23) & 0xFF) - 127 + 15;
+    unsigned int Mantissa = Bits & 0x007FFFFF;
+
+    // NaN stays NaN, infinity and overflow saturate to infinity
+    if (((Bits >> 23) & 0xFF) == 0xFF)
+        return (unsigned short)(Sign | 0x7C00 | (Mantissa ? 0x200 : 0));
+    if (Exponent >= 31)
+        return (unsigned short)(Sign | 0x7C00);
+    // Denormals and underflow to zero
+    if (Exponent <= 0) {
+        if (Exponent < -10)
+            return (unsigned short)Sign;
+        Mantissa |= 0x00800000;
+        const unsigned int Shift = (unsigned int)(14 - Exponent);
+        return (unsigned short)(Sign | ((Mantissa + (1u << (Shift - 1))) >> Shift));
+    }
+    // A carry out of the mantissa correctly bumps the exponent
+    return (unsigned short)((Sign | ((unsigned int)Exponent << 10) | (Mantissa >> 13)) + ((Mantissa >> 12) & 1));
+}
+
+static unsigned short QuantizeUnorm16(float v) {
+    v = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+    return (unsigned short)(v * 65535.0f + 0.5f);
+}
+
+static short QuantizeSnorm16(float v) {
+    v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+    return (short)(v >= 0.0f ? v * 32767.0f + 0.5f : v * 32767.0f - 0.5f);
+}
+
+// Maps the unit sphere onto the [-1, 1] square: the upper hemisphere to the inner diamond and
+// the lower hemisphere folded over the corners. Must match OctDecode in the vertex shaders.
+static QuantizedNormal OctEncode(const Vector3f& n) {
+    const float L1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    float x = L1 > 0.0f ? n.x / L1 : 0.0f;
+    float y = L1 > 0.0f ? n.y / L1 : 0.0f;
+
+    if (n.z < 0.0f) {
+        const float ox = x;
+        x = (1.0f - fabsf(y)) * (ox >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - fabsf(ox)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    QuantizedNormal q;
+    q.x = QuantizeSnorm16(x);
+    q.y = QuantizeSnorm16(y);
+    return q;
+}
+
+// Positions are decoded in the shader as Offset + Position * Scale
+static void QuantizePositions(const Vector3f* pPositions, unsigned int NumVertices, QuantizedPosition* pOut,
+    Vector3f& Offset, Vector3f& Scale) {
+    Vector3f Min(0.0f, 0.0f, 0.0f);
+    Vector3f Max(0.0f, 0.0f, 0.0f);
+    if (NumVertices > 0)
+        Min = Max = pPositions[0];
+    for (unsigned int i = 1; i < NumVertices; i++) {
+        Min.x = fminf(Min.x, pPositions[i].x);
+        Min.y = fminf(Min.y, pPositions[i].y);
+        Min.z = fminf(Min.z, pPositions[i].z);
+        Max.x = fmaxf(Max.x, pPositions[i].x);
+        Max.y = fmaxf(Max.y, pPositions[i].y);
+        Max.z = fmaxf(Max.z, pPositions[i].z);
+    }
+
+    Offset = Min;
+    Scale = Max - Min;
+    const Vector3f InvScale(Scale.x > 0.0f ? 1.0f / Scale.x : 0.0f,
+        Scale.y > 0.0f ? 1.0f / Scale.y : 0.0f,
+        Scale.z > 0.0f ? 1.0f / Scale.z : 0.0f);
+
+    for (unsigned int i = 0; i < NumVertices; i++) {
+        pOut[i].x = QuantizeUnorm16((pPositions[i].x - Min.x) * InvScale.x);
+        pOut[i].y = QuantizeUnorm16((pPositions[i].y - Min.y) * InvScale.y);
+        pOut[i].z = QuantizeUnorm16((pPositions[i].z - Min.z) * InvScale.z);
+        pOut[i].w = 0;
+    }
+}
+
+static void QuantizeNormals(const Vector3f* pNormals, unsigned int NumVertices, QuantizedNormal* pOut) {
+    for (unsigned int i = 0; i < NumVertices; i++)
+        pOut[i] = OctEncode(pNormals[i]);
+}
+
+static void QuantizeTexCoords(const Vector2f* pTexCoords, unsigned int NumVertices, QuantizedTexCoord* pOut) {
+    for (unsigned int i = 0; i < NumVertices; i++) {
+        pOut[i].u = FloatToHalf(pTexCoords[i].x);
+        pOut[i].v = FloatToHalf(pTexCoords[i].y);
+    }
+}
+
+#endif
\ No newline at end of file
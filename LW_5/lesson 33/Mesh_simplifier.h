@@ -0,0 +1,232 @@
+#ifndef MESH_SIMPLIFIER_H
+#define	MESH_SIMPLIFIER_H
+
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "Math_3d.h"
+
+// Quadric error metric edge collapse. The simplified triangles reuse the vertices of the source
+// mesh, so a LOD is just another index range over the same vertex buffer. Vertices on open
+// edges are never moved, which keeps the silhouette of holes and the UV seams split by welding.
+
+#define SIMPLIFY_MAX_PASSES 64
+
+// Symmetric 4x4 matrix: a2 ab ac ad b2 bc bd c2 cd d2
+struct Quadric {
+    double m[10];
+
+    Quadric() {
+        for (unsigned int i = 0; i < 10; i++)
+            m[i] = 0.0;
+    }
+
+    // Squared distance to the plane ax + by + cz + d = 0, weighted
+    Quadric(double a, double b, double c, double d, double Weight) {
+        m[0] = a * a * Weight; m[1] = a * b * Weight; m[2] = a * c * Weight; m[3] = a * d * Weight;
+        m[4] = b * b * Weight; m[5] = b * c * Weight; m[6] = b * d * Weight;
+        m[7] = c * c * Weight; m[8] = c * d * Weight;
+        m[9] = d * d * Weight;
+    }
+
+    Quadric& operator+=(const Quadric& r) {
+        for (unsigned int i = 0; i < 10; i++)
+            m[i] += r.m[i];
+        return *this;
+    }
+
+    double Error(const Vector3f& p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+            m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+            m[7] * z * z + 2.0 * m[8] * z +
+            m[9];
+    }
+};
+
+static inline unsigned long long SimplifyEdgeKey(unsigned int a, unsigned int b) {
+    return a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+}
+
+// Would moving vertex From of the triangle onto the position To flip its normal or turn it by
+// more than about 80 degrees
+static inline bool SimplifyFlips(const Vector3f& From, const Vector3f& To, const Vector3f& b, const Vector3f& c) {
+    const Vector3f n0 = (b - From).Cross(c - From);
+    const Vector3f n1 = (b - To).Cross(c - To);
+    const float Dot = n0.x * n1.x + n0.y * n1.y + n0.z * n1.z;
+    const float Lengths = sqrtf((n0.x * n0.x + n0.y * n0.y + n0.z * n0.z) * (n1.x * n1.x + n1.y * n1.y + n1.z * n1.z));
+    return Dot <= 0.2f * Lengths;
+}
+
+// Reduces the triangle list to about TargetNumIndices indices. Returns the number of indices
+// written to Result, which can stay above the target when every remaining collapse is blocked.
+static unsigned int SimplifyMesh(const unsigned int* pIndices, unsigned int NumIndices,
+    const Vector3f* pPositions, unsigned int NumVertices, unsigned int TargetNumIndices, std::vector<unsigned int>& Result) {
+    Result.assign(pIndices, pIndices + NumIndices);
+
+    // Area weighted plane quadrics of the triangles around every vertex
+    std::vector<Quadric> Quadrics(NumVertices);
+    for (unsigned int i = 0; i < NumIndices; i += 3) {
+        const Vector3f& p0 = pPositions[pIndices[i]];
+        Vector3f n = (pPositions[pIndices[i + 1]] - p0).Cross(pPositions[pIndices[i + 2]] - p0);
+        const float Length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+        if (Length == 0.0f)
+            continue;
+        n *= 1.0f / Length;
+
+        const Quadric q(n.x, n.y, n.z, -(n.x * p0.x + n.y * p0.y + n.z * p0.z), Length * 0.5f);
+        for (unsigned int k = 0; k < 3; k++)
+            Quadrics[pIndices[i + k]] += q;
+    }
+
+    // Edges used by a single triangle are open
+    std::unordered_map<unsigned long long, unsigned int> EdgeUse;
+    EdgeUse.reserve(NumIndices);
+    for (unsigned int i = 0; i < NumIndices; i += 3) {
+        for (unsigned int k = 0; k < 3; k++)
+            EdgeUse[SimplifyEdgeKey(pIndices[i + k], pIndices[i + (k + 1) % 3])]++;
+    }
+    std::vector<bool> Locked(NumVertices, false);
+    for (std::unordered_map<unsigned long long, unsigned int>::const_iterator it = EdgeUse.begin(); it != EdgeUse.end(); ++it) {
+        if (it->second == 1) {
+            Locked[(unsigned int)(it->first >> 32)] = true;
+            Locked[(unsigned int)(it->first & 0xFFFFFFFF)] = true;
+        }
+    }
+
+    struct Collapse {
+        double Cost;
+        unsigned int From;
+        unsigned int To;
+
+        bool operator<(const Collapse& r) const { return Cost < r.Cost; }
+    };
+
+    std::vector<Collapse> Collapses;
+    std::vector<unsigned int> Remap(NumVertices);
+    std::vector<bool> Touched(NumVertices);
+    std::vector<unsigned int> TriStart(NumVertices + 1);
+    std::vector<unsigned int> VertexTris;
+    std::vector<unsigned int> RingScratch;
+
+    for (unsigned int Pass = 0; Pass < SIMPLIFY_MAX_PASSES && Result.size() > TargetNumIndices; Pass++) {
+        const unsigned int NumTris = (unsigned int)Result.size() / 3;
+
+        // Vertex to triangle adjacency of the current triangles
+        std::fill(TriStart.begin(), TriStart.end(), 0);
+        for (unsigned int i = 0; i < Result.size(); i++)
+            TriStart[Result[i] + 1]++;
+        for (unsigned int v = 0; v < NumVertices; v++)
+            TriStart[v + 1] += TriStart[v];
+        VertexTris.resize(Result.size());
+        std::vector<unsigned int> Fill(TriStart.begin(), TriStart.end() - 1);
+        for (unsigned int i = 0; i < Result.size(); i++)
+            VertexTris[Fill[Result[i]]++] = i / 3;
+
+        // Cheapest direction of every edge
+        Collapses.clear();
+        for (unsigned int i = 0; i < Result.size(); i += 3) {
+            for (unsigned int k = 0; k < 3; k++) {
+                const unsigned int a = Result[i + k];
+                const unsigned int b = Result[i + (k + 1) % 3];
+                // Every interior edge is seen twice, keep one. Open edges are locked anyway.
+                if (a > b)
+                    continue;
+
+                Quadric q = Quadrics[a];
+                q += Quadrics[b];
+                const double CostAB = Locked[a] ? -1.0 : q.Error(pPositions[b]);
+                const double CostBA = Locked[b] ? -1.0 : q.Error(pPositions[a]);
+                if (CostAB < 0.0 && CostBA < 0.0)
+                    continue;
+
+                Collapse c;
+                if (CostBA < 0.0 || (CostAB >= 0.0 && CostAB <= CostBA)) {
+                    c.Cost = CostAB; c.From = a; c.To = b;
+                }
+                else {
+                    c.Cost = CostBA; c.From = b; c.To = a;
+                }
+                Collapses.push_back(c);
+            }
+        }
+        std::sort(Collapses.begin(), Collapses.end());
+
+        for (unsigned int v = 0; v < NumVertices; v++)
+            Remap[v] = v;
+        std::fill(Touched.begin(), Touched.end(), false);
+
+        // A collapse removes about two triangles. The one-ring of every collapsed vertex is
+        // frozen for the rest of the pass so that the flip test stays valid.
+        const unsigned int MaxCollapses = (NumTris - TargetNumIndices / 3) / 2 + 1;
+        unsigned int NumCollapsed = 0;
+
+        for (unsigned int i = 0; i < Collapses.size() && NumCollapsed < MaxCollapses; i++) {
+            const Collapse& c = Collapses[i];
+            if (Touched[c.From] || Touched[c.To])
+                continue;
+
+            // Link condition: an interior edge shares exactly two neighbours, more would pinch the
+            // surface into a non manifold fold
+            std::vector<unsigned int>& Ring = RingScratch;
+            Ring.clear();
+            for (unsigned int t = TriStart[c.From]; t < TriStart[c.From + 1]; t++)
+                Ring.insert(Ring.end(), &Result[VertexTris[t] * 3], &Result[VertexTris[t] * 3] + 3);
+            std::sort(Ring.begin(), Ring.end());
+            Ring.erase(std::unique(Ring.begin(), Ring.end()), Ring.end());
+            unsigned int NumShared = 0;
+            for (unsigned int t = TriStart[c.To]; t < TriStart[c.To + 1]; t++) {
+                for (unsigned int k = 0; k < 3; k++) {
+                    const unsigned int v = Result[VertexTris[t] * 3 + k];
+                    if (v != c.From && v != c.To && std::binary_search(Ring.begin(), Ring.end(), v))
+                        NumShared++;
+                }
+            }
+            // Every shared neighbour of an interior edge is seen in two triangles around To
+            bool Valid = NumShared <= 4;
+            for (unsigned int t = TriStart[c.From]; t < TriStart[c.From + 1] && Valid; t++) {
+                const unsigned int* pTri = &Result[VertexTris[t] * 3];
+                if (pTri[0] == c.To || pTri[1] == c.To || pTri[2] == c.To)
+                    continue;
+                const unsigned int k = pTri[0] == c.From ? 0 : (pTri[1] == c.From ? 1 : 2);
+                const unsigned int b = pTri[(k + 1) % 3];
+                const unsigned int d = pTri[(k + 2) % 3];
+                if (Touched[b] || Touched[d] || SimplifyFlips(pPositions[c.From], pPositions[c.To], pPositions[b], pPositions[d]))
+                    Valid = false;
+            }
+            if (!Valid)
+                continue;
+
+            for (unsigned int t = TriStart[c.From]; t < TriStart[c.From + 1]; t++) {
+                const unsigned int* pTri = &Result[VertexTris[t] * 3];
+                Touched[pTri[0]] = Touched[pTri[1]] = Touched[pTri[2]] = true;
+            }
+            Remap[c.From] = c.To;
+            Quadrics[c.To] += Quadrics[c.From];
+            NumCollapsed++;
+        }
+
+        if (NumCollapsed == 0)
+            break;
+
+        // Apply the collapses and drop the triangles that became degenerate
+        unsigned int Write = 0;
+        for (unsigned int i = 0; i < Result.size(); i += 3) {
+            const unsigned int a = Remap[Result[i]];
+            const unsigned int b = Remap[Result[i + 1]];
+            const unsigned int d = Remap[Result[i + 2]];
+            if (a == b || b == d || a == d)
+                continue;
+            Result[Write++] = a;
+            Result[Write++] = b;
+            Result[Write++] = d;
+        }
+        Result.resize(Write);
+    }
+
+    return (unsigned int)Result.size();
+}
+
+#endif
\ No newline at end of file
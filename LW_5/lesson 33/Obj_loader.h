@@ -0,0 +1,579 @@
+#ifndef OBJ_LOADER_H
+#define	OBJ_LOADER_H
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Util.h"
+#include "Math_3d.h"
+#include "Mapped_file.h"
+#include "Thread_pool.h"
+
+// Wavefront OBJ reader for the mapped file. The file is cut into chunks at line boundaries which
+// are parsed in parallel, then the faces are grouped into one mesh per material and the
+// position/texcoord/normal triples are merged into unique vertices, one task per mesh.
+// The result matches the Assimp import with aiProcess_Triangulate | aiProcess_GenSmoothNormals |
+// aiProcess_FlipUVs: polygons become triangle fans, v is flipped and missing normals are
+// smoothed. Lines other than v, vt, vn, f, usemtl and mtllib are ignored.
+
+#define OBJ_MIN_CHUNK_SIZE (256 * 1024)
+#define OBJ_NO_INDEX       -1
+
+struct ObjCorner {
+    int v, t, n; // 0 based, OBJ_NO_INDEX when missing
+};
+
+// A range of triangles of a chunk using one material
+struct ObjRun {
+    unsigned int Chunk;
+    unsigned int FirstCorner;
+    unsigned int NumCorners;
+};
+
+struct ObjChunk {
+    const char* pBegin;
+    const char* pEnd;
+    std::vector<Vector3f> Positions;
+    std::vector<Vector2f> TexCoords;
+    std::vector<Vector3f> Normals;
+    std::vector<ObjCorner> Corners; // Three per triangle
+    std::vector<std::pair<unsigned int, unsigned int> > RelativeCorners; // Corner and mask of its relative indices
+    std::vector<std::pair<unsigned int, std::string> > Materials; // First corner and usemtl name
+    std::string MtlLib;
+    bool Error;
+};
+
+struct ObjMesh {
+    unsigned int MaterialIndex;
+    unsigned int BaseVertex;
+    unsigned int NumVertices;
+    unsigned int BaseIndex;
+    unsigned int NumIndices;
+};
+
+struct ObjFile {
+    std::vector<ObjMesh> Meshes;
+    std::vector<std::string> TexturePaths; // One per material, empty without a diffuse map
+    std::vector<Vector3f> Positions;
+    std::vector<Vector3f> Normals;
+    std::vector<Vector2f> TexCoords;
+    std::vector<unsigned int> Indices;     // Relative to the BaseVertex of the mesh
+};
+
+static inline const char* SkipObjSpace(const char* p, const char* pEnd) {
+    while (p < pEnd && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static void TrimObjName(const char*& pName, const char*& pNameEnd) {
+    pName = SkipObjSpace(pName, pNameEnd);
+    while (pNameEnd > pName && (pNameEnd[-1] == ' ' || pNameEnd[-1] == '\t' || pNameEnd[-1] == '\r'))
+        pNameEnd--;
+}
+
+// Decimal float with optional sign, fraction and exponent. Returns NULL when there is no number.
+static const char* ParseObjFloat(const char* p, const char* pEnd, float& Value) {
+    static const double Powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+    p = SkipObjSpace(p, pEnd);
+    bool Negative = false;
+    if (p < pEnd && (*p == '-' || *p == '+'))
+        Negative = *p++ == '-';
+
+    double Mantissa = 0.0;
+    int Exponent = 0;
+    unsigned int NumDigits = 0;
+    for (; p < pEnd && *p >= '0' && *p <= '9'; p++, NumDigits++)
+        Mantissa = Mantissa * 10.0 + (*p - '0');
+    if (p < pEnd && *p == '.') {
+        for (p++; p < pEnd && *p >= '0' && *p <= '9'; p++, NumDigits++, Exponent--)
+            Mantissa = Mantissa * 10.0 + (*p - '0');
+    }
+    if (NumDigits == 0)
+        return NULL;
+
+    if (p < pEnd && (*p == 'e' || *p == 'E')) {
+        const char* pExp = p + 1;
+        bool NegativeExp = false;
+        if (pExp < pEnd && (*pExp == '-' || *pExp == '+'))
+            NegativeExp = *pExp++ == '-';
+        if (pExp < pEnd && *pExp >= '0' && *pExp <= '9') {
+            int e = 0;
+            for (; pExp < pEnd && *pExp >= '0' && *pExp <= '9'; pExp++)
+                e = e < 10000 ? e * 10 + (*pExp - '0') : e;
+            Exponent += NegativeExp ? -e : e;
+            p = pExp;
+        }
+    }
+
+    if (Exponent < 0)
+        Mantissa = -Exponent <= 22 ? Mantissa / Powers[-Exponent] : Mantissa * pow(10.0, Exponent);
+    else if (Exponent > 0)
+        Mantissa = Exponent <= 22 ? Mantissa * Powers[Exponent] : Mantissa * pow(10.0, Exponent);
+
+    Value = (float)(Negative ? -Mantissa : Mantissa);
+    return p;
+}
+
+static inline const char* ParseObjInt(const char* p, const char* pEnd, int& Value) {
+    bool Negative = false;
+    if (p < pEnd && (*p == '-' || *p == '+'))
+        Negative = *p++ == '-';
+    if (p >= pEnd || *p < '0' || *p > '9')
+        return NULL;
+
+    long long v = 0;
+    for (; p < pEnd && *p >= '0' && *p <= '9'; p++)
+        v = v < 0x7FFFFFFF ? v * 10 + (*p - '0') : v;
+    Value = (int)(Negative ? -v : v);
+    return p;
+}
+
+// OBJ indices are 1 based, negative ones count back from the last element defined so far. The
+// chunk does not know how many elements the chunks before it define, so a negative index is made
+// relative to the chunk and its component is flagged in Mask.
+static inline int ResolveObjIndex(int Index, unsigned int NumLocal, unsigned int Component, unsigned int& Mask) {
+    if (Index >= 0)
+        return Index - 1;
+    Mask |= Component;
+    return (int)NumLocal + Index;
+}
+
+static void ParseObjLine(const char* p, const char* pEnd, ObjChunk& Chunk) {
+    p = SkipObjSpace(p, pEnd);
+    if (pEnd - p < 2)
+        return;
+
+    const bool Separated = p[1] == ' ' || p[1] == '\t';
+    if (p[0] == 'v' && Separated) {
+        Vector3f v(0.0f, 0.0f, 0.0f);
+        if (!(p = ParseObjFloat(p + 2, pEnd, v.x)) || !(p = ParseObjFloat(p, pEnd, v.y)) || !(p = ParseObjFloat(p, pEnd, v.z)))
+            Chunk.Error = true;
+        Chunk.Positions.push_back(v);
+    }
+    else if (p[0] == 'v' && p[1] == 't') {
+        Vector2f t(0.0f, 0.0f);
+        if (!(p = ParseObjFloat(p + 2, pEnd, t.x)))
+            Chunk.Error = true;
+        else if (!ParseObjFloat(p, pEnd, t.y))
+            t.y = 0.0f;
+        // Same as aiProcess_FlipUVs
+        t.y = 1.0f - t.y;
+        Chunk.TexCoords.push_back(t);
+    }
+    else if (p[0] == 'v' && p[1] == 'n') {
+        Vector3f n(0.0f, 0.0f, 0.0f);
+        if (!(p = ParseObjFloat(p + 2, pEnd, n.x)) || !(p = ParseObjFloat(p, pEnd, n.y)) || !(p = ParseObjFloat(p, pEnd, n.z)))
+            Chunk.Error = true;
+        Chunk.Normals.push_back(n);
+    }
+    else if (p[0] == 'f' && Separated) {
+        ObjCorner Fan[2];
+        unsigned int FanMasks[2] = { 0, 0 };
+        unsigned int NumCorners = 0;
+        p += 2;
+
+        for (;;) {
+            p = SkipObjSpace(p, pEnd);
+            if (p >= pEnd)
+                break;
+
+            ObjCorner c = { OBJ_NO_INDEX, OBJ_NO_INDEX, OBJ_NO_INDEX };
+            unsigned int Mask = 0;
+            int Index;
+            if (!(p = ParseObjInt(p, pEnd, Index))) {
+                Chunk.Error = true;
+                return;
+            }
+            c.v = ResolveObjIndex(Index, (unsigned int)Chunk.Positions.size(), 1, Mask);
+            if (p < pEnd && *p == '/') {
+                p++;
+                if (p < pEnd && *p != '/') {
+                    if (!(p = ParseObjInt(p, pEnd, Index))) {
+                        Chunk.Error = true;
+                        return;
+                    }
+                    c.t = ResolveObjIndex(Index, (unsigned int)Chunk.TexCoords.size(), 2, Mask);
+                }
+                if (p < pEnd && *p == '/') {
+                    if (!(p = ParseObjInt(p + 1, pEnd, Index))) {
+                        Chunk.Error = true;
+                        return;
+                    }
+                    c.n = ResolveObjIndex(Index, (unsigned int)Chunk.Normals.size(), 4, Mask);
+                }
+            }
+
+            // Triangle fan around the first corner
+            if (NumCorners >= 2) {
+                const ObjCorner Triangle[3] = { Fan[0], Fan[1], c };
+                const unsigned int Masks[3] = { FanMasks[0], FanMasks[1], Mask };
+                for (unsigned int i = 0; i < 3; i++) {
+                    if (Masks[i])
+                        Chunk.RelativeCorners.push_back(std::make_pair((unsigned int)Chunk.Corners.size(), Masks[i]));
+                    Chunk.Corners.push_back(Triangle[i]);
+                }
+            }
+            const unsigned int Slot = NumCorners == 0 ? 0 : 1;
+            Fan[Slot] = c;
+            FanMasks[Slot] = Mask;
+            NumCorners++;
+        }
+    }
+    else if (pEnd - p > 7 && strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+        const char* pName = p + 7;
+        const char* pNameEnd = pEnd;
+        TrimObjName(pName, pNameEnd);
+        Chunk.Materials.push_back(std::make_pair((unsigned int)Chunk.Corners.size(), std::string(pName, pNameEnd)));
+    }
+    else if (pEnd - p > 7 && strncmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t') && Chunk.MtlLib.empty()) {
+        const char* pName = p + 7;
+        const char* pNameEnd = pEnd;
+        TrimObjName(pName, pNameEnd);
+        Chunk.MtlLib.assign(pName, pNameEnd);
+    }
+}
+
+
+static void ParseObjChunk(ObjChunk& Chunk) {
+    const char* p = Chunk.pBegin;
+    while (p < Chunk.pEnd) {
+        const char* pLineEnd = (const char*)memchr(p, '\n', Chunk.pEnd - p);
+        if (!pLineEnd)
+            pLineEnd = Chunk.pEnd;
+        ParseObjLine(p, pLineEnd, Chunk);
+        p = pLineEnd + 1;
+    }
+}
+
+// Runs Func over [0, Count) on the pool, or on the calling thread without one
+static void RunObjTasks(ThreadPool* pPool, unsigned int Count, const ThreadPool::RangeFunc& Func) {
+    if (pPool)
+        pPool->ParallelFor(Count, Func, 1);
+    else
+        Func(0, Count);
+}
+
+// Material names and diffuse maps of the mtllib in the order of the file
+static void ReadObjMaterials(const std::string& Filename, const std::string& Dir, std::vector<std::string>& Names, std::vector<std::string>& Paths) {
+    MappedFile File;
+    if (!File.Open(Filename)) {
+        printf("Warning: can't open material library '%s'\n", Filename.c_str());
+        return;
+    }
+
+    const char* p = (const char*)File.GetData();
+    const char* pEnd = p + File.GetSize();
+    while (p < pEnd) {
+        const char* pLineEnd = (const char*)memchr(p, '\n', pEnd - p);
+        if (!pLineEnd)
+            pLineEnd = pEnd;
+
+        const char* pLine = SkipObjSpace(p, pLineEnd);
+        if (pLineEnd - pLine > 7 && strncmp(pLine, "newmtl", 6) == 0) {
+            const char* pName = pLine + 6;
+            const char* pNameEnd = pLineEnd;
+            TrimObjName(pName, pNameEnd);
+            Names.push_back(std::string(pName, pNameEnd));
+            Paths.push_back(std::string());
+        }
+        else if (pLineEnd - pLine > 7 && strncmp(pLine, "map_Kd", 6) == 0 && !Paths.empty()) {
+            const char* pName = pLine + 6;
+            const char* pNameEnd = pLineEnd;
+            TrimObjName(pName, pNameEnd);
+            // Options like "-bm 1" come before the file name
+            if (pName < pNameEnd && *pName == '-') {
+                const char* pLast = pNameEnd;
+                while (pLast > pName && pLast[-1] != ' ' && pLast[-1] != '\t')
+                    pLast--;
+                pName = pLast;
+            }
+            std::string Path(pName, pNameEnd);
+            if (Path.substr(0, 2) == ".\\")
+                Path = Path.substr(2);
+            if (!Path.empty())
+                Paths.back() = Dir + "/" + Path;
+        }
+        p = pLineEnd + 1;
+    }
+}
+
+static inline unsigned int HashObjCorner(const ObjCorner& c) {
+    unsigned int h = (unsigned int)c.v * 0x9E3779B1u;
+    h ^= ((unsigned int)c.t + 0x7F4A7C15u + (h << 6) + (h >> 2)) * 0x85EBCA77u;
+    h ^= ((unsigned int)c.n + 0x165667B1u + (h << 6) + (h >> 2)) * 0xC2B2AE3Du;
+    return h ^ (h >> 15);
+}
+
+// Merges the corners of the runs of one material into unique vertices. Vertex holds the corner
+// of every unique vertex, Indices one vertex per corner.
+static bool WeldObjCorners(const std::vector<ObjChunk>& Chunks, const std::vector<ObjRun>& Runs,
+    unsigned int NumPositions, unsigned int NumTexCoords, unsigned int NumNormals,
+    std::vector<ObjCorner>& Vertices, std::vector<unsigned int>& Indices) {
+    unsigned int NumCorners = 0;
+    for (unsigned int i = 0; i < Runs.size(); i++)
+        NumCorners += Runs[i].NumCorners;
+
+    unsigned int TableSize = 64;
+    while (TableSize < NumCorners + NumCorners / 2)
+        TableSize *= 2;
+    std::vector<unsigned int> Table(TableSize, 0xFFFFFFFF);
+
+    Vertices.clear();
+    Indices.resize(NumCorners);
+    unsigned int* pIndex = Indices.data();
+
+    for (unsigned int r = 0; r < Runs.size(); r++) {
+        const ObjCorner* pCorners = Chunks[Runs[r].Chunk].Corners.data() + Runs[r].FirstCorner;
+        for (unsigned int i = 0; i < Runs[r].NumCorners; i++) {
+            const ObjCorner& c = pCorners[i];
+            if (c.v < 0 || c.v >= (int)NumPositions || c.t < OBJ_NO_INDEX || c.t >= (int)NumTexCoords ||
+                c.n < OBJ_NO_INDEX || c.n >= (int)NumNormals)
+                return false;
+
+            unsigned int Slot = HashObjCorner(c) & (TableSize - 1);
+            for (;;) {
+                const unsigned int Vertex = Table[Slot];
+                if (Vertex == 0xFFFFFFFF) {
+                    Table[Slot] = (unsigned int)Vertices.size();
+                    *pIndex++ = (unsigned int)Vertices.size();
+                    Vertices.push_back(c);
+                    break;
+                }
+                const ObjCorner& v = Vertices[Vertex];
+                if (v.v == c.v && v.t == c.t && v.n == c.n) {
+                    *pIndex++ = Vertex;
+                    break;
+                }
+                Slot = (Slot + 1) & (TableSize - 1);
+            }
+        }
+    }
+    return true;
+}
+
+// Area weighted normals for the vertices without one, shared by all vertices at the same position
+static void CalcObjNormals(const std::vector<ObjCorner>& Vertices, const unsigned int* pIndices, unsigned int NumIndices,
+    const Vector3f* pPositions, Vector3f* pNormals) {
+    unsigned int TableSize = 64;
+    while (TableSize < Vertices.size() + Vertices.size() / 2)
+        TableSize *= 2;
+    std::vector<unsigned int> Table(TableSize, 0xFFFFFFFF);
+
+    // The first vertex at every position collects the normals of the position
+    std::vector<unsigned int> Group(Vertices.size());
+    for (unsigned int i = 0; i < Vertices.size(); i++) {
+        unsigned int Slot = ((unsigned int)Vertices[i].v * 0x9E3779B1u) & (TableSize - 1);
+        while (Table[Slot] != 0xFFFFFFFF && Vertices[Table[Slot]].v != Vertices[i].v)
+            Slot = (Slot + 1) & (TableSize - 1);
+        if (Table[Slot] == 0xFFFFFFFF)
+            Table[Slot] = i;
+        Group[i] = Table[Slot];
+    }
+
+    std::vector<Vector3f> Sums(Vertices.size(), Vector3f(0.0f, 0.0f, 0.0f));
+    for (unsigned int i = 0; i + 2 < NumIndices; i += 3) {
+        const Vector3f& p0 = pPositions[pIndices[i]];
+        const Vector3f e1 = pPositions[pIndices[i + 1]] - p0;
+        const Vector3f e2 = pPositions[pIndices[i + 2]] - p0;
+        const Vector3f n = e1.Cross(e2);
+        for (unsigned int k = 0; k < 3; k++)
+            Sums[Group[pIndices[i + k]]] += n;
+    }
+
+    for (unsigned int i = 0; i < Vertices.size(); i++) {
+        if (Vertices[i].n != OBJ_NO_INDEX)
+            continue;
+        Vector3f n = Sums[Group[i]];
+        if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f)
+            n.Normalize();
+        else
+            n = Vector3f(0.0f, 0.0f, 1.0f);
+        pNormals[i] = n;
+    }
+}
+
+// Reads the OBJ file of the mapped data. Dir is the directory of the file for the mtllib and the
+// texture paths. Without a pool everything runs on the calling thread.
+static bool ReadObj(const unsigned char* pFile, size_t Size, const std::string& Dir, ThreadPool* pPool, ObjFile& File) {
+    const char* pData = (const char*)pFile;
+    const char* pDataEnd = pData + Size;
+
+    // Several chunks per thread balance the load, every chunk starts at the beginning of a line
+    size_t NumChunks = pPool ? pPool->GetNumThreads() * 4 : 1;
+    if (Size / OBJ_MIN_CHUNK_SIZE < NumChunks)
+        NumChunks = Size / OBJ_MIN_CHUNK_SIZE > 0 ? Size / OBJ_MIN_CHUNK_SIZE : 1;
+
+    std::vector<ObjChunk> Chunks(NumChunks);
+    const char* p = pData;
+    for (size_t i = 0; i < NumChunks; i++) {
+        const char* pEnd = i + 1 == NumChunks ? pDataEnd : pData + Size / NumChunks * (i + 1);
+        if (pEnd < p)
+            pEnd = p;
+        if (pEnd < pDataEnd) {
+            const char* pBreak = (const char*)memchr(pEnd, '\n', pDataEnd - pEnd);
+            pEnd = pBreak ? pBreak + 1 : pDataEnd;
+        }
+        Chunks[i].pBegin = p;
+        Chunks[i].pEnd = pEnd;
+        Chunks[i].Error = false;
+        p = pEnd;
+    }
+
+    const long long Start = GetCurrentTimeMicros();
+    RunObjTasks(pPool, (unsigned int)NumChunks, [&](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++)
+            ParseObjChunk(Chunks[i]);
+    });
+    const long long ParseTime = GetCurrentTimeMicros() - Start;
+
+    // Global offsets of the elements of every chunk
+    std::vector<unsigned int> PositionBases(NumChunks), TexCoordBases(NumChunks), NormalBases(NumChunks);
+    unsigned int NumPositions = 0;
+    unsigned int NumTexCoords = 0;
+    unsigned int NumNormals = 0;
+    std::string MtlLib;
+    for (size_t i = 0; i < NumChunks; i++) {
+        if (Chunks[i].Error)
+            return false;
+        PositionBases[i] = NumPositions;
+        TexCoordBases[i] = NumTexCoords;
+        NormalBases[i] = NumNormals;
+        NumPositions += (unsigned int)Chunks[i].Positions.size();
+        NumTexCoords += (unsigned int)Chunks[i].TexCoords.size();
+        NumNormals += (unsigned int)Chunks[i].Normals.size();
+        if (MtlLib.empty())
+            MtlLib = Chunks[i].MtlLib;
+    }
+
+    std::vector<Vector3f> Positions(NumPositions);
+    std::vector<Vector2f> TexCoords(NumTexCoords);
+    std::vector<Vector3f> Normals(NumNormals);
+    RunObjTasks(pPool, (unsigned int)NumChunks, [&](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++) {
+            ObjChunk& Chunk = Chunks[i];
+            std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), Positions.begin() + PositionBases[i]);
+            std::copy(Chunk.TexCoords.begin(), Chunk.TexCoords.end(), TexCoords.begin() + TexCoordBases[i]);
+            std::copy(Chunk.Normals.begin(), Chunk.Normals.end(), Normals.begin() + NormalBases[i]);
+            std::vector<Vector3f>().swap(Chunk.Positions);
+            std::vector<Vector2f>().swap(Chunk.TexCoords);
+            std::vector<Vector3f>().swap(Chunk.Normals);
+
+            for (unsigned int r = 0; r < Chunk.RelativeCorners.size(); r++) {
+                ObjCorner& c = Chunk.Corners[Chunk.RelativeCorners[r].first];
+                const unsigned int Mask = Chunk.RelativeCorners[r].second;
+                if (Mask & 1)
+                    c.v += PositionBases[i];
+                if (Mask & 2)
+                    c.t += TexCoordBases[i];
+                if (Mask & 4)
+                    c.n += NormalBases[i];
+            }
+        }
+    });
+
+    // The materials of the library, then the default material for faces without a known one
+    std::vector<std::string> MaterialNames;
+    File.TexturePaths.clear();
+    if (!MtlLib.empty())
+        ReadObjMaterials(Dir + "/" + MtlLib, Dir, MaterialNames, File.TexturePaths);
+    const unsigned int DefaultMaterial = (unsigned int)MaterialNames.size();
+    File.TexturePaths.push_back(std::string());
+
+    // Split the corners into runs of one material
+    std::vector<std::vector<ObjRun> > MaterialRuns(DefaultMaterial + 1);
+    unsigned int Material = DefaultMaterial;
+    for (unsigned int i = 0; i < NumChunks; i++) {
+        const ObjChunk& Chunk = Chunks[i];
+        unsigned int First = 0;
+        for (unsigned int m = 0; m <= Chunk.Materials.size(); m++) {
+            const unsigned int Last = m < Chunk.Materials.size() ? Chunk.Materials[m].first : (unsigned int)Chunk.Corners.size();
+            if (Last > First) {
+                const ObjRun Run = { i, First, Last - First };
+                MaterialRuns[Material].push_back(Run);
+            }
+            if (m < Chunk.Materials.size()) {
+                Material = DefaultMaterial;
+                for (unsigned int k = 0; k < MaterialNames.size(); k++)
+                    if (MaterialNames[k] == Chunk.Materials[m].second)
+                        Material = k;
+            }
+            First = Last;
+        }
+    }
+
+    File.Meshes.clear();
+    for (unsigned int i = 0; i < MaterialRuns.size(); i++) {
+        if (!MaterialRuns[i].empty()) {
+            ObjMesh Mesh = { i, 0, 0, 0, 0 };
+            File.Meshes.push_back(Mesh);
+        }
+    }
+
+    // Every mesh is welded by its own task
+    const unsigned int NumMeshes = (unsigned int)File.Meshes.size();
+    std::vector<std::vector<ObjCorner> > MeshVertices(NumMeshes);
+    std::vector<std::vector<unsigned int> > MeshIndices(NumMeshes);
+    std::vector<char> Welded(NumMeshes, 0);
+    RunObjTasks(pPool, NumMeshes, [&](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++)
+            Welded[i] = WeldObjCorners(Chunks, MaterialRuns[File.Meshes[i].MaterialIndex], NumPositions, NumTexCoords, NumNormals,
+                MeshVertices[i], MeshIndices[i]);
+    });
+
+    unsigned int NumVertices = 0;
+    unsigned int NumIndices = 0;
+    for (unsigned int i = 0; i < NumMeshes; i++) {
+        if (!Welded[i]) {
+            printf("Error: OBJ face index out of range\n");
+            return false;
+        }
+        File.Meshes[i].BaseVertex = NumVertices;
+        File.Meshes[i].NumVertices = (unsigned int)MeshVertices[i].size();
+        File.Meshes[i].BaseIndex = NumIndices;
+        File.Meshes[i].NumIndices = (unsigned int)MeshIndices[i].size();
+        NumVertices += File.Meshes[i].NumVertices;
+        NumIndices += File.Meshes[i].NumIndices;
+    }
+    std::vector<ObjChunk>().swap(Chunks);
+
+    File.Positions.resize(NumVertices);
+    File.Normals.resize(NumVertices);
+    File.TexCoords.resize(NumVertices);
+    File.Indices.resize(NumIndices);
+    RunObjTasks(pPool, NumMeshes, [&](unsigned int Begin, unsigned int End) {
+        for (unsigned int i = Begin; i < End; i++) {
+            const std::vector<ObjCorner>& Vertices = MeshVertices[i];
+            Vector3f* pPositions = File.Positions.data() + File.Meshes[i].BaseVertex;
+            Vector3f* pNormals = File.Normals.data() + File.Meshes[i].BaseVertex;
+            Vector2f* pTexCoords = File.TexCoords.data() + File.Meshes[i].BaseVertex;
+            bool MissingNormals = false;
+
+            for (unsigned int v = 0; v < Vertices.size(); v++) {
+                const ObjCorner& c = Vertices[v];
+                pPositions[v] = Positions[c.v];
+                pTexCoords[v] = c.t != OBJ_NO_INDEX ? TexCoords[c.t] : Vector2f(0.0f, 0.0f);
+                if (c.n != OBJ_NO_INDEX)
+                    pNormals[v] = Normals[c.n];
+                else
+                    MissingNormals = true;
+            }
+            std::copy(MeshIndices[i].begin(), MeshIndices[i].end(), File.Indices.begin() + File.Meshes[i].BaseIndex);
+
+            if (MissingNormals)
+                CalcObjNormals(Vertices, MeshIndices[i].data(), (unsigned int)MeshIndices[i].size(), pPositions, pNormals);
+        }
+    });
+
+    printf("Parsed %u OBJ chunks in %.2f ms, %u meshes with %u vertices in %.2f ms total on %u threads\n", (unsigned int)NumChunks,
+        ParseTime / 1000.0, NumMeshes, NumVertices, (GetCurrentTimeMicros() - Start) / 1000.0, pPool ? pPool->GetNumThreads() : 1);
+    return true;
+}
+
+#endif
\ No newline at end of file
@@ -1,84 +1,223 @@
 #ifndef PIPELINE_H
 #define	PIPELINE_H
 
+#include <assert.h>
+
 #include "math_3d.h"
 
+struct PipelineStats {
+    unsigned int NumRecomputed;
+    unsigned int NumSkipped;
+};
+
 class Pipeline {
 public:
     Pipeline() {
         m_scale = Vector3f(1.0f, 1.0f, 1.0f);
         m_worldPos = Vector3f(0.0f, 0.0f, 0.0f);
         m_rotateInfo = Vector3f(0.0f, 0.0f, 0.0f);
+        m_persProjInfo.FOV = 0.0f;
+        m_persProjInfo.Width = 0.0f;
+        m_persProjInfo.Height = 0.0f;
+        m_persProjInfo.zNear = 0.0f;
+        m_persProjInfo.zFar = 0.0f;
+        m_camera.Pos = Vector3f(0.0f, 0.0f, 0.0f);
+        m_camera.Target = Vector3f(0.0f, 0.0f, 1.0f);
+        m_camera.Up = Vector3f(0.0f, 1.0f, 0.0f);
+        m_dirty = DIRTY_ALL;
+        ResetStats();
     }
 
     void Scale(float ScaleX, float ScaleY, float ScaleZ) {
-        m_scale.x = ScaleX;
-        m_scale.y = ScaleY;
-        m_scale.z = ScaleZ;
+        Scale(Vector3f(ScaleX, ScaleY, ScaleZ));
+    }
+
+    void Scale(const Vector3f& Scale) {
+        if (!Equal(m_scale, Scale)) {
+            m_scale = Scale;
+            m_dirty |= DIRTY_WORLD | DIRTY_WVP;
+        }
     }
 
     void WorldPos(float x, float y, float z) {
-        m_worldPos.x = x;
-        m_worldPos.y = y;
-        m_worldPos.z = z;
+        WorldPos(Vector3f(x, y, z));
     }
 
     void WorldPos(const Vector3f& Pos) {
-        m_worldPos = Pos;
+        if (!Equal(m_worldPos, Pos)) {
+            m_worldPos = Pos;
+            m_dirty |= DIRTY_WORLD | DIRTY_WVP;
+        }
     }
 
     void Rotate(float RotateX, float RotateY, float RotateZ) {
-        m_rotateInfo.x = RotateX;
-        m_rotateInfo.y = RotateY;
-        m_rotateInfo.z = RotateZ;
+        const Vector3f RotateInfo(RotateX, RotateY, RotateZ);
+
+        if (!Equal(m_rotateInfo, RotateInfo)) {
+            m_rotateInfo = RotateInfo;
+            m_dirty |= DIRTY_ROTATE | DIRTY_WORLD | DIRTY_WVP;
+        }
     }
 
     void SetPerspectiveProj(const PersProjInfo& p) {
-        m_persProjInfo = p;
+        if (p.FOV != m_persProjInfo.FOV || p.Width != m_persProjInfo.Width || p.Height != m_persProjInfo.Height ||
+            p.zNear != m_persProjInfo.zNear || p.zFar != m_persProjInfo.zFar) {
+            m_persProjInfo = p;
+            m_dirty |= DIRTY_PROJ | DIRTY_VP | DIRTY_WVP;
+        }
     }
 
     void SetCamera(const Vector3f& Pos, const Vector3f& Target, const Vector3f& Up) {
-        m_camera.Pos = Pos;
-        m_camera.Target = Target;
-        m_camera.Up = Up;
+        if (!Equal(m_camera.Pos, Pos) || !Equal(m_camera.Target, Target) || !Equal(m_camera.Up, Up)) {
+            m_camera.Pos = Pos;
+            m_camera.Target = Target;
+            m_camera.Up = Up;
+            m_dirty |= DIRTY_CAMERA | DIRTY_VP | DIRTY_WVP;
+        }
     }
 
     const Matrix4f& GetVPTrans() {
-        Matrix4f CameraTranslationTrans, CameraRotateTrans, PersProjTrans;
-
-        CameraTranslationTrans.InitTranslationTransform(-m_camera.Pos.x, -m_camera.Pos.y, -m_camera.Pos.z);
-        CameraRotateTrans.InitCameraTransform(m_camera.Target, m_camera.Up);
-        PersProjTrans.InitPersProjTransform(m_persProjInfo);
-
-        m_VPTtransformation = PersProjTrans * CameraRotateTrans * CameraTranslationTrans;
+        if (!(m_dirty & DIRTY_VP)) {
+            m_stats.NumSkipped++;
+            return m_VPTtransformation;
+        }
+
+        if (m_dirty & DIRTY_CAMERA) {
+            Matrix4f CameraTranslationTrans, CameraRotateTrans;
+
+            CameraTranslationTrans.InitTranslationTransform(-m_camera.Pos.x, -m_camera.Pos.y, -m_camera.Pos.z);
+            CameraRotateTrans.InitCameraTransform(m_camera.Target, m_camera.Up);
+            m_cameraTransformation = CameraRotateTrans * CameraTranslationTrans;
+            m_stats.NumRecomputed++;
+        }
+        else
+            m_stats.NumSkipped++;
+
+        if (m_dirty & DIRTY_PROJ) {
+            m_persProjTransformation.InitPersProjTransform(m_persProjInfo);
+            m_stats.NumRecomputed++;
+        }
+        else
+            m_stats.NumSkipped++;
+
+        m_VPTtransformation = m_persProjTransformation * m_cameraTransformation;
+        m_stats.NumRecomputed++;
+        m_dirty &= ~(DIRTY_CAMERA | DIRTY_PROJ | DIRTY_VP);
         return m_VPTtransformation;
     }
 
     const Matrix4f& GetWVPTrans() {
-        GetWorldTrans();
+        if (!(m_dirty & DIRTY_WVP)) {
+            m_stats.NumSkipped++;
+            return m_WVPtransformation;
+        }
 
-        Matrix4f CameraTranslationTrans, CameraRotateTrans, PersProjTrans;
-
-        CameraTranslationTrans.InitTranslationTransform(-m_camera.Pos.x, -m_camera.Pos.y, -m_camera.Pos.z);
-        CameraRotateTrans.InitCameraTransform(m_camera.Target, m_camera.Up);
-        PersProjTrans.InitPersProjTransform(m_persProjInfo);
+        GetWorldTrans();
+        GetVPTrans();
 
-        m_WVPtransformation = PersProjTrans * CameraRotateTrans * CameraTranslationTrans * m_WorldTransformation;
+        m_WVPtransformation = m_VPTtransformation * m_WorldTransformation;
+        m_stats.NumRecomputed++;
+        m_dirty &= ~DIRTY_WVP;
         return m_WVPtransformation;
     }
 
     const Matrix4f& GetWorldTrans() {
-        Matrix4f ScaleTrans, RotateTrans, TranslationTrans;
+        if (!(m_dirty & DIRTY_WORLD)) {
+            m_stats.NumSkipped++;
+            return m_WorldTransformation;
+        }
+
+        Matrix4f ScaleTrans, TranslationTrans;
 
         ScaleTrans.InitScaleTransform(m_scale.x, m_scale.y, m_scale.z);
-        RotateTrans.InitRotateTransform(m_rotateInfo.x, m_rotateInfo.y, m_rotateInfo.z);
         TranslationTrans.InitTranslationTransform(m_worldPos.x, m_worldPos.y, m_worldPos.z);
 
-        m_WorldTransformation = TranslationTrans * RotateTrans * ScaleTrans;
+        m_WorldTransformation = TranslationTrans * GetRotateTrans() * ScaleTrans;
+        m_stats.NumRecomputed++;
+        m_dirty &= ~DIRTY_WORLD;
         return m_WorldTransformation;
     }
 
+    // Computes the World and WVP matrices of NumInstances objects which share the camera and the
+    // projection. The VP matrix is built once for the whole batch. Rotations and Scales may be NULL,
+    // in which case the values set with Rotate() and Scale() are used for every instance. The results
+    // are written transposed, which is the layout Mesh::Render expects for the instance attributes.
+    void GetInstanceTrans(unsigned int NumInstances, const Vector3f* pPositions, const Vector3f* pRotations,
+        const Vector3f* pScales, Matrix4f* pWVPMats, Matrix4f* pWorldMats) {
+        PrepareInstanceTrans();
+        CalcInstanceTrans(0, NumInstances, pPositions, pRotations, pScales, pWVPMats, pWorldMats);
+    }
+
+    // Brings the matrices shared by a batch up to date. After this call CalcInstanceTrans can run
+    // concurrently on several threads as long as the Pipeline is not modified.
+    void PrepareInstanceTrans() {
+        GetVPTrans();
+        GetRotateTrans();
+    }
+
+    // Same as GetInstanceTrans for the instances in [Begin, End). The arrays are indexed with the
+    // instance index. PrepareInstanceTrans must be called first.
+    void CalcInstanceTrans(unsigned int Begin, unsigned int End, const Vector3f* pPositions, const Vector3f* pRotations,
+        const Vector3f* pScales, Matrix4f* pWVPMats, Matrix4f* pWorldMats) const {
+        assert(!(m_dirty & (DIRTY_VP | DIRTY_ROTATE)));
+
+        Matrix4f RotateTrans = m_rotateTransformation;
+
+        for (unsigned int i = Begin; i < End; i++) {
+            if (pRotations)
+                RotateTrans.InitRotateTransform(pRotations[i].x, pRotations[i].y, pRotations[i].z);
+
+            const Vector3f& Scale = pScales ? pScales[i] : m_scale;
+            const Vector3f& Pos = pPositions[i];
+            // Translation * Rotation * Scale without the two extra matrix products
+            Matrix4f WorldTrans;
+            WorldTrans.m[0][0] = RotateTrans.m[0][0] * Scale.x; WorldTrans.m[0][1] = RotateTrans.m[0][1] * Scale.y; WorldTrans.m[0][2] = RotateTrans.m[0][2] * Scale.z; WorldTrans.m[0][3] = Pos.x;
+            WorldTrans.m[1][0] = RotateTrans.m[1][0] * Scale.x; WorldTrans.m[1][1] = RotateTrans.m[1][1] * Scale.y; WorldTrans.m[1][2] = RotateTrans.m[1][2] * Scale.z; WorldTrans.m[1][3] = Pos.y;
+            WorldTrans.m[2][0] = RotateTrans.m[2][0] * Scale.x; WorldTrans.m[2][1] = RotateTrans.m[2][1] * Scale.y; WorldTrans.m[2][2] = RotateTrans.m[2][2] * Scale.z; WorldTrans.m[2][3] = Pos.z;
+            WorldTrans.m[3][0] = 0.0f;                          WorldTrans.m[3][1] = 0.0f;                          WorldTrans.m[3][2] = 0.0f;                          WorldTrans.m[3][3] = 1.0f;
+
+            pWorldMats[i] = WorldTrans.Transpose();
+            pWVPMats[i] = (m_VPTtransformation * WorldTrans).Transpose();
+        }
+    }
+
+    // Number of matrices rebuilt and of rebuilds avoided thanks to the cache since the last reset
+    const PipelineStats& GetStats() const {
+        return m_stats;
+    }
+
+    void ResetStats() {
+        m_stats.NumRecomputed = 0;
+        m_stats.NumSkipped = 0;
+    }
+
 private:
+    enum {
+        DIRTY_ROTATE = 0x01,
+        DIRTY_WORLD  = 0x02,
+        DIRTY_CAMERA = 0x04,
+        DIRTY_PROJ   = 0x08,
+        DIRTY_VP     = 0x10,
+        DIRTY_WVP    = 0x20,
+        DIRTY_ALL    = 0x3F
+    };
+
+    static bool Equal(const Vector3f& l, const Vector3f& r) {
+        return l.x == r.x && l.y == r.y && l.z == r.z;
+    }
+
+    const Matrix4f& GetRotateTrans() {
+        if (m_dirty & DIRTY_ROTATE) {
+            m_rotateTransformation.InitRotateTransform(m_rotateInfo.x, m_rotateInfo.y, m_rotateInfo.z);
+            m_stats.NumRecomputed++;
+            m_dirty &= ~DIRTY_ROTATE;
+        }
+        else
+            m_stats.NumSkipped++;
+
+        return m_rotateTransformation;
+    }
+
     Vector3f m_scale;
     Vector3f m_worldPos;
     Vector3f m_rotateInfo;
@@ -94,5 +233,11 @@ private:
     Matrix4f m_WVPtransformation;
     Matrix4f m_VPTtransformation;
     Matrix4f m_WorldTransformation;
+    Matrix4f m_rotateTransformation;
+    Matrix4f m_cameraTransformation;
+    Matrix4f m_persProjTransformation;
+
+    unsigned int m_dirty;
+    PipelineStats m_stats;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef PROCESS_MEMORY_H
+#define	PROCESS_MEMORY_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+// Largest resident set (working set on Windows) of the process so far in bytes, 0 when unknown
+inline size_t GetPeakMemoryUsage() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS Counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+        return Counters.PeakWorkingSetSize;
+#else
+    struct rusage Usage;
+    // Linux reports kilobytes
+    if (getrusage(RUSAGE_SELF, &Usage) == 0)
+        return (size_t)Usage.ru_maxrss * 1024;
+#endif
+    return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+#ifndef RING_BUFFER_H
+#define	RING_BUFFER_H
+
+#include <string.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Util.h"
+#include "Math_3d.h"
+
+struct RingBufferStats {
+    unsigned int NumFrames;     // Regions handed out
+    unsigned int NumFenceWaits; // Regions the GPU was still reading when the CPU wanted them
+    long long WaitTime;         // Microseconds spent blocked on fences
+};
+
+// Streams per-frame data to the GPU through a persistently mapped buffer split into NUM_REGIONS
+// regions. Every region is guarded by a fence, so the CPU only writes to a region the GPU is
+// done with. Without GL 4.4 / ARB_buffer_storage it falls back to glBufferData from a CPU copy.
+class RingBuffer {
+public:
+    static const unsigned int NUM_REGIONS = 3;
+
+    RingBuffer() {
+        m_buffer = 0;
+        m_pData = NULL;
+        m_regionSize = 0;
+        m_curRegion = 0;
+        m_mappedSize = 0;
+        m_persistent = false;
+        ZERO_MEM(m_fences);
+        ResetStats();
+    }
+
+    ~RingBuffer() {
+        Destroy();
+    }
+
+    // Returns Size bytes the CPU can write to. *pOffset receives their offset in GetBuffer().
+    void* Map(GLsizeiptr Size, GLintptr* pOffset) {
+        if (m_buffer == 0 || Size > m_regionSize)
+            Resize(Size);
+
+        m_mappedSize = Size;
+        m_stats.NumFrames++;
+
+        if (!m_persistent) {
+            *pOffset = 0;
+            return &m_staging[0];
+        }
+
+        m_curRegion = (m_curRegion + 1) % NUM_REGIONS;
+        WaitForRegion(m_curRegion);
+
+        *pOffset = m_curRegion * m_regionSize;
+        return m_pData + *pOffset;
+    }
+
+    // Must be called once the data is written and before the draws which read it
+    void Unmap() {
+        if (!m_persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+            glBufferData(GL_ARRAY_BUFFER, m_mappedSize, &m_staging[0], GL_STREAM_DRAW);
+        }
+    }
+
+    // Must be called after the last draw which reads the current region
+    void Fence() {
+        if (m_persistent)
+            m_fences[m_curRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLuint GetBuffer() const {
+        return m_buffer;
+    }
+
+    const RingBufferStats& GetStats() const {
+        return m_stats;
+    }
+
+    void ResetStats() {
+        m_stats.NumFrames = 0;
+        m_stats.NumFenceWaits = 0;
+        m_stats.WaitTime = 0;
+    }
+
+private:
+    void Resize(GLsizeiptr Size) {
+        Destroy();
+        // Leave room to grow and keep every region aligned for the attribute fetch
+        m_regionSize = ((Size + Size / 2) + 255) & ~(GLsizeiptr)255;
+
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+
+        m_persistent = (GLEW_ARB_buffer_storage != 0);
+        if (m_persistent) {
+            const GLbitfield Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, m_regionSize * NUM_REGIONS, NULL, Flags);
+            m_pData = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, m_regionSize * NUM_REGIONS, Flags);
+            m_persistent = (m_pData != NULL);
+        }
+
+        if (!m_persistent)
+            m_staging.resize(m_regionSize / sizeof(Matrix4f) + 1);
+    }
+
+    void WaitForRegion(unsigned int Region) {
+        if (!m_fences[Region])
+            return;
+
+        GLenum Status = glClientWaitSync(m_fences[Region], 0, 0);
+        if (Status == GL_TIMEOUT_EXPIRED) {
+            m_stats.NumFenceWaits++;
+            const long long Start = GetCurrentTimeMicros();
+            do {
+                Status = glClientWaitSync(m_fences[Region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (Status == GL_TIMEOUT_EXPIRED);
+            m_stats.WaitTime += GetCurrentTimeMicros() - Start;
+        }
+
+        glDeleteSync(m_fences[Region]);
+        m_fences[Region] = 0;
+    }
+
+    void Destroy() {
+        for (unsigned int i = 0; i < NUM_REGIONS; i++)
+            WaitForRegion(i);
+
+        if (m_buffer != 0) {
+            if (m_pData) {
+                glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+                m_pData = NULL;
+            }
+            glDeleteBuffers(1, &m_buffer);
+            m_buffer = 0;
+        }
+    }
+
+    GLuint m_buffer;
+    unsigned char* m_pData;
+    GLsizeiptr m_regionSize;
+    GLsizeiptr m_mappedSize;
+    unsigned int m_curRegion;
+    bool m_persistent;
+    GLsync m_fences[NUM_REGIONS];
+    std::vector<Matrix4f> m_staging; // Keeps the CPU copy aligned like the mapped memory
+    RingBufferStats m_stats;
+};
+
+#endif
\ No newline at end of file
@@ -62,7 +62,8 @@ public:
     }
 
 protected:
-    bool AddShader(GLenum ShaderType, const char* pShaderText) {
+    // pDefines (e.g. "#define FOO\n") is inserted right after the #version line of the shader
+    bool AddShader(GLenum ShaderType, const char* pShaderText, const char* pDefines = NULL) {
         GLuint ShaderObj = glCreateShader(ShaderType);
 
         if (ShaderObj == 0) {
@@ -73,11 +74,23 @@ protected:
         //    -     
         m_shaderObjList.push_back(ShaderObj);
 
-        const GLchar* p[1];
+        const GLchar* p[3];
+        GLint Lengths[3];
+        GLsizei Count = 1;
         p[0] = pShaderText;
-        GLint Lengths[1];
         Lengths[0] = strlen(pShaderText);
-        glShaderSource(ShaderObj, 1, p, Lengths);
+
+        const char* pVersion = strstr(pShaderText, "#version");
+        const char* pVersionEnd = pVersion ? strchr(pVersion, '\n') : NULL;
+        if (pDefines && pVersionEnd) {
+            Lengths[0] = (GLint)(pVersionEnd + 1 - pShaderText);
+            p[1] = pDefines;
+            Lengths[1] = strlen(pDefines);
+            p[2] = pVersionEnd + 1;
+            Lengths[2] = strlen(p[2]);
+            Count = 3;
+        }
+        glShaderSource(ShaderObj, Count, p, Lengths);
 
         glCompileShader(ShaderObj);
 
@@ -1,32 +1,252 @@
 #include "Texture.h"
+#include "Texture_cache.h"
+#include "Util.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_FAILURE_USERMSG
 #include <STB/stb_image.h>
 
+GLuint Texture::s_placeholderObj = 0;
+unsigned int Texture::s_filter = TEXTURE_FILTER_ANISOTROPIC;
+float Texture::s_maxAnisotropy = TEXTURE_DEFAULT_MAX_ANISOTROPY;
+
+Texture::~Texture() {
+    FreeImageData();
+    if (!IsPlaceholder())
+        glDeleteTextures(1, &m_textureObj);
+}
+
 bool Texture::Load() {
+    // Decode reports the error, Upload then binds the placeholder
+    Decode();
+
+    return Upload();
+}
+
+void Texture::InitDecoder() {
     stbi_set_flip_vertically_on_load(1);
+}
+
+GLuint Texture::GetPlaceholder() {
+    if (s_placeholderObj == 0) {
+        const unsigned char Pixels[] = {
+            160, 160, 160, 255,   96,  96,  96, 255,
+             96,  96,  96, 255,  160, 160, 160, 255 };
+        glGenTextures(1, &s_placeholderObj);
+        glBindTexture(GL_TEXTURE_2D, s_placeholderObj);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, Pixels);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return s_placeholderObj;
+}
+
+void Texture::FreeImageData() {
+    if (m_pImageData) {
+        stbi_image_free(m_pImageData);
+        m_pImageData = NULL;
+    }
+    std::vector<unsigned char>().swap(m_compressedData);
+}
+
+bool Texture::Decode() {
+    if (m_compression != TEXTURE_COMPRESS_NONE)
+        return DecodeCompressed();
+
     int widht = 0, height = 0, bpp = 0;
-    unsigned char* image_data = stbi_load(m_fileName.c_str(), &widht, &height, &bpp, 0);
+    if (m_embedded) {
+        m_pImageData = stbi_load_from_memory(m_sourceData.data(), (int)m_sourceData.size(), &widht, &height, &bpp, 0);
+        std::vector<unsigned char>().swap(m_sourceData);
+    }
+    else
+        m_pImageData = stbi_load(m_fileName.c_str(), &widht, &height, &bpp, 0);
 
-    if (!image_data) {
+    if (!m_pImageData) {
         printf("Can't load texture from %s - %s\n", m_fileName.c_str(), stbi_failure_reason());
-        exit(0);
+        return false;
     }
     printf("Widht %d, height %d, bpp %d\n", widht, height, bpp);
+    m_width = widht;
+    m_height = height;
+    m_bpp = bpp;
 
-    glGenTextures(1, &m_textureObj);
-    glBindTexture(m_textureTarget, m_textureObj);
-    if (m_textureTarget == GL_TEXTURE_2D)
-        glTexImage2D(m_textureTarget, 0, GL_RGB, widht, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image_data);
-    else {
+    return true;
+}
+
+bool Texture::DecodeCompressed() {
+    const bool NormalMap = m_compression == TEXTURE_COMPRESS_NORMAL_MAP;
+
+    // Embedded images have no source file to check the cache against
+    const unsigned int MaxSize = m_streamed ? TEXTURE_STREAM_INITIAL_SIZE : 0;
+    unsigned int Format = 0;
+    if (!m_embedded && ReadTextureCache(m_fileName, NormalMap, MaxSize, Format, m_mips, m_dataLevel, m_compressedData)) {
+        m_format = Format;
+        m_width = m_mips[0].Width;
+        m_height = m_mips[0].Height;
+        m_bpp = 4;
+        return true;
+    }
+
+    int Width = 0, Height = 0, Channels = 0;
+    unsigned char* pPixels = m_embedded ? stbi_load_from_memory(m_sourceData.data(), (int)m_sourceData.size(), &Width, &Height, &Channels, 4) :
+                                          stbi_load(m_fileName.c_str(), &Width, &Height, &Channels, 4);
+    std::vector<unsigned char>().swap(m_sourceData);
+    if (!pPixels) {
+        printf("Can't load texture from %s - %s\n", m_fileName.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    if (NormalMap)
+        Format = TEXTURE_FORMAT_BC5;
+    else
+        Format = HasTransparentPixels(pPixels, Width * Height) ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC1;
+
+    const long long Start = GetCurrentTimeMicros();
+    CompressMipChain(pPixels, Width, Height, Format, NormalMap, m_mips, m_compressedData);
+    stbi_image_free(pPixels);
+    printf("Compressed %s to BC%u, %u mips, in %.2f ms\n", m_fileName.c_str(), Format, (unsigned int)m_mips.size(),
+        (GetCurrentTimeMicros() - Start) / 1000.0);
+
+    m_dataLevel = 0;
+    if (!m_embedded && WriteTextureCache(m_fileName, NormalMap, Format, m_mips, m_compressedData)) {
+        if (m_streamed) {
+            // The larger levels are read back from the cache when they are needed
+            m_dataLevel = GetLevelForSize(TEXTURE_STREAM_INITIAL_SIZE);
+            m_compressedData.erase(m_compressedData.begin(), m_compressedData.begin() + m_mips[m_dataLevel].Offset);
+        }
+    }
+    else
+        m_streamed = false;
+
+    m_format = Format;
+    m_width = Width;
+    m_height = Height;
+    m_bpp = 4;
+    return true;
+}
+
+bool Texture::LoadLevels(unsigned int FirstLevel) {
+    const TextureMip& Level = m_mips[FirstLevel];
+    std::vector<TextureMip> Mips;
+    unsigned int Format = 0, DataLevel = 0;
+    if (!ReadTextureCache(m_fileName, m_compression == TEXTURE_COMPRESS_NORMAL_MAP, std::max(Level.Width, Level.Height), Format, Mips,
+            DataLevel, m_compressedData) || Format != m_format || Mips.size() != m_mips.size()) {
+        printf("Can't stream %s from the texture cache\n", m_fileName.c_str());
+        FreeImageData();
+        m_streamed = false;
+        return false;
+    }
+
+    m_dataLevel = DataLevel;
+    return true;
+}
+
+bool Texture::Upload() {
+    if (!GetImageData()) {
+        printf("Using the placeholder for %s\n", m_fileName.c_str());
+        UsePlaceholder();
+        return true;
+    }
+
+    SetTextureObj(CreateTextureObj(GetImageData()), m_dataLevel);
+    FreeImageData();
+
+    return true;
+}
+
+void Texture::SetTextureObj(GLuint TextureObj, unsigned int ResidentLevel) {
+    if (!IsPlaceholder())
+        glDeleteTextures(1, &m_textureObj);
+    m_textureObj = TextureObj;
+    m_residentLevel = ResidentLevel;
+}
+
+GLuint Texture::CreateTextureObj(const void* pPixels) const {
+    if (m_textureTarget != GL_TEXTURE_2D) {
         printf("Support for texture target %x is not implemented\n", m_textureTarget);
         exit(1);
     }
-    glTexParameterf(m_textureTarget, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameterf(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    GLuint TextureObj = 0;
+    glGenTextures(1, &TextureObj);
+    glBindTexture(m_textureTarget, TextureObj);
+
+    // Immutable storage lets the driver allocate the whole mip chain once
+    const bool Immutable = GLEW_ARB_texture_storage != 0;
+
+    if (m_format) {
+        // The mip chain comes from the texture cache
+        const GLenum InternalFormat = m_format == TEXTURE_FORMAT_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+                                      m_format == TEXTURE_FORMAT_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RG_RGTC2;
+        const unsigned int NumLevels = (unsigned int)m_mips.size() - m_dataLevel;
+        const TextureMip& Top = m_mips[m_dataLevel];
+        if (Immutable)
+            glTexStorage2D(m_textureTarget, NumLevels, InternalFormat, Top.Width, Top.Height);
+        for (unsigned int i = 0; i < NumLevels; i++) {
+            const TextureMip& Mip = m_mips[m_dataLevel + i];
+            const unsigned char* pLevel = (const unsigned char*)pPixels + (Mip.Offset - Top.Offset);
+            if (Immutable)
+                glCompressedTexSubImage2D(m_textureTarget, i, 0, 0, Mip.Width, Mip.Height, InternalFormat, Mip.Size, pLevel);
+            else
+                glCompressedTexImage2D(m_textureTarget, i, InternalFormat, Mip.Width, Mip.Height, 0, Mip.Size, pLevel);
+        }
+        glTexParameteri(m_textureTarget, GL_TEXTURE_MAX_LEVEL, (GLint)NumLevels - 1);
+        ApplyFilter(s_filter, s_maxAnisotropy);
+        glBindTexture(m_textureTarget, 0);
+        return TextureObj;
+    }
+
+    // stbi returns as many channels as the file has
+    static const GLenum Formats[] = { GL_RGB, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    static const GLint InternalFormats[] = { GL_RGB8, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    const int Channels = m_bpp >= 1 && m_bpp <= 4 ? m_bpp : 3;
+
+    // Rows of RGB images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (Immutable) {
+        glTexStorage2D(m_textureTarget, GetNumMips(m_width, m_height), InternalFormats[Channels], m_width, m_height);
+        glTexSubImage2D(m_textureTarget, 0, 0, 0, m_width, m_height, Formats[Channels], GL_UNSIGNED_BYTE, pPixels);
+    }
+    else
+        glTexImage2D(m_textureTarget, 0, InternalFormats[Channels], m_width, m_height, 0, Formats[Channels], GL_UNSIGNED_BYTE, pPixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // The GPU filters the levels down from level 0
+    glGenerateMipmap(m_textureTarget);
+    if (Channels <= 2) {
+        // Grey (and alpha) images
+        const GLint Swizzle[] = { GL_RED, GL_RED, GL_RED, Channels == 2 ? GL_GREEN : GL_ONE };
+        glTexParameteriv(m_textureTarget, GL_TEXTURE_SWIZZLE_RGBA, Swizzle);
+    }
+    ApplyFilter(s_filter, s_maxAnisotropy);
     //glTexParameterf(m_textureTarget, GL_TEXTURE_WRAP_S, GL_CLAMP);
     //glTexParameterf(m_textureTarget, GL_TEXTURE_WRAP_T, GL_CLAMP);
     glBindTexture(m_textureTarget, 0);
 
-    return true;
+    return TextureObj;
+}
+
+void Texture::ApplyFilter(unsigned int Filter, float MaxAnisotropy) const {
+    glTexParameteri(m_textureTarget, GL_TEXTURE_MIN_FILTER, Filter == TEXTURE_FILTER_BILINEAR ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(m_textureTarget, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        float Supported = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &Supported);
+        const float Anisotropy = Filter == TEXTURE_FILTER_ANISOTROPIC ? std::max(1.0f, std::min(MaxAnisotropy, Supported)) : 1.0f;
+        glTexParameterf(m_textureTarget, GL_TEXTURE_MAX_ANISOTROPY_EXT, Anisotropy);
+    }
+}
+
+void Texture::SetDefaultFilter(unsigned int Filter, float MaxAnisotropy) {
+    s_filter = Filter;
+    s_maxAnisotropy = MaxAnisotropy;
+}
+
+void Texture::SetFilter(unsigned int Filter, float MaxAnisotropy) {
+    if (IsPlaceholder())
+        return;
+
+    glBindTexture(m_textureTarget, m_textureObj);
+    ApplyFilter(Filter, MaxAnisotropy);
+    glBindTexture(m_textureTarget, 0);
 }
\ No newline at end of file
@@ -2,25 +2,218 @@
 #define	TEXTURE_H
 
 #include <string>
+#include <vector>
 #include <GL/glew.h>
- 
+
+#include "Texture_compressor.h"
+
+#define TEXTURE_COMPRESS_NONE       0
+#define TEXTURE_COMPRESS_COLOR      1 // BC1, or BC3 when the image has alpha
+#define TEXTURE_COMPRESS_NORMAL_MAP 2 // BC5 with x and y only, the shader must rebuild z
+
+#define TEXTURE_FILTER_BILINEAR    0 // Level 0 only
+#define TEXTURE_FILTER_TRILINEAR   1
+#define TEXTURE_FILTER_ANISOTROPIC 2 // Trilinear with up to the given anisotropy
+#define TEXTURE_DEFAULT_MAX_ANISOTROPY 8.0f
+
+#define TEXTURE_STREAM_INITIAL_SIZE 64 // Largest level a streamed texture starts with
+
+class TextureLoader;
+
 class Texture {
+    friend class TextureLoader;
+
 public:
     Texture(GLenum TextureTarget, const std::string& FileName) {
         m_textureTarget = TextureTarget;
         m_fileName = FileName;
+        m_textureObj = 0;
+        m_width = 0;
+        m_height = 0;
+        m_bpp = 0;
+        m_compression = TEXTURE_COMPRESS_NONE;
+        m_format = 0;
+        m_streamed = false;
+        m_dataLevel = 0;
+        m_residentLevel = 0;
+        m_pImageData = NULL;
+        m_embedded = false;
     }
 
+    ~Texture();
+
+    // An image which can't be read is reported and replaced by the placeholder
     bool Load();
 
+    // Load split in two: Decode reads the image file and touches no GL state, so it can run on
+    // any thread. Upload creates the GL texture on the render thread and frees the pixels, or
+    // binds the placeholder when Decode failed.
+    bool Decode();
+    bool Upload();
+
+    // Shows the shared placeholder until the image is in, see TextureLoader
+    void UsePlaceholder() {
+        m_textureObj = GetPlaceholder();
+    }
+
+    bool IsPlaceholder() const {
+        return m_textureObj == 0 || m_textureObj == s_placeholderObj;
+    }
+
+    // Small grey checker shared by all textures, created on first use
+    static GLuint GetPlaceholder();
+
+    // The stb_image options are global, so they are set once on the main thread before any
+    // loader thread decodes
+    static void InitDecoder();
+
+    const std::string& GetFileName() const {
+        return m_fileName;
+    }
+
+    // TEXTURE_COMPRESS_*, set before Decode. The compressed mip chain is encoded on the first
+    // load and read from the texture cache afterwards, see Texture_cache.h.
+    void SetCompression(unsigned int Compression) {
+        m_compression = Compression;
+    }
+
+    // The GL formats of every TEXTURE_COMPRESS_* mode are available
+    static bool IsCompressionSupported() {
+        return GLEW_EXT_texture_compression_s3tc && GLEW_ARB_texture_compression_rgtc;
+    }
+
+    // Streamed textures start with the levels up to TEXTURE_STREAM_INITIAL_SIZE, TextureStreamer
+    // brings in the larger ones. Needs compression and a source file for the texture cache,
+    // otherwise the texture is loaded whole. Set before Decode.
+    void SetStreamed(bool Streamed) {
+        m_streamed = Streamed && m_compression != TEXTURE_COMPRESS_NONE && !m_embedded;
+    }
+
+    bool IsStreamed() const {
+        return m_streamed;
+    }
+
+    // Reads the levels from FirstLevel down to 1x1 from the texture cache for the next upload.
+    // Touches no GL state. A failure also turns the streaming off.
+    bool LoadLevels(unsigned int FirstLevel);
+
+    // Mip chain of a compressed texture, known after Decode
+    unsigned int GetNumLevels() const {
+        return (unsigned int)m_mips.size();
+    }
+
+    const TextureMip& GetLevel(unsigned int Level) const {
+        return m_mips[Level];
+    }
+
+    unsigned int GetLevelForSize(unsigned int MaxSize) const {
+        return ::GetLevelForSize(m_mips, MaxSize);
+    }
+
+    // Size of the levels from FirstLevel down to 1x1
+    size_t GetLevelsSize(unsigned int FirstLevel) const {
+        return m_mips.empty() ? 0 : GetCompressedDataSize() - m_mips[FirstLevel].Offset;
+    }
+
+    // Largest level in video memory
+    unsigned int GetResidentLevel() const {
+        return m_residentLevel;
+    }
+
+    // Video memory of the mip chain, compressed or not. Known after Decode.
+    size_t GetMemorySize() const {
+        if (m_format)
+            return GetLevelsSize(m_residentLevel);
+
+        size_t Size = 0;
+        unsigned int Width = m_width, Height = m_height;
+        for (unsigned int i = 0; i < GetNumMips(m_width, m_height); i++) {
+            Size += (size_t)Width * Height * m_bpp;
+            Width = std::max(Width / 2, 1u);
+            Height = std::max(Height / 2, 1u);
+        }
+        return Size;
+    }
+
+    // Every texture gets a full mip chain. The filter picks how it is sampled: TEXTURE_FILTER_*
+    // and the maximum anisotropy, clamped to what the GPU supports. The default applies to the
+    // textures created afterwards, SetFilter changes a loaded texture.
+    static void SetDefaultFilter(unsigned int Filter, float MaxAnisotropy);
+    void SetFilter(unsigned int Filter, float MaxAnisotropy);
+
+    // Makes Decode read the encoded image from memory instead of the file. The bytes are copied
+    // because Decode may run on a loader thread after the mesh has released its source file.
+    void SetSourceData(const unsigned char* pData, size_t Size) {
+        m_sourceData.assign(pData, pData + Size);
+        m_embedded = true;
+        m_streamed = false;
+    }
+
     void Bind(GLenum TextureUnit) {
         glActiveTexture(TextureUnit);
         glBindTexture(m_textureTarget, m_textureObj);
     }
 
+    GLuint GetTextureObj() const {
+        return m_textureObj;
+    }
+
+    int GetWidth() const {
+        return m_width;
+    }
+
+    int GetHeight() const {
+        return m_height;
+    }
+
 private:
+    // Creates the texture object from the decoded size and format. pPixels is an offset into the
+    // bound GL_PIXEL_UNPACK_BUFFER when one is bound. A compressed texture gets the levels from
+    // m_dataLevel on.
+    GLuint CreateTextureObj(const void* pPixels) const;
+
+    // Replaces the texture object by one which starts at ResidentLevel
+    void SetTextureObj(GLuint TextureObj, unsigned int ResidentLevel);
+
+    // Sets the filter of the bound texture
+    void ApplyFilter(unsigned int Filter, float MaxAnisotropy) const;
+
+    bool DecodeCompressed();
+
+    size_t GetCompressedDataSize() const {
+        return m_mips.empty() ? 0 : m_mips.back().Offset + m_mips.back().Size;
+    }
+
+    // Decoded pixels or blocks which Upload passes to GL
+    const unsigned char* GetImageData() const {
+        return m_format ? (m_compressedData.empty() ? NULL : &m_compressedData[0]) : m_pImageData;
+    }
+
+    size_t GetImageSize() const {
+        return m_format ? m_compressedData.size() : (size_t)m_width * m_height * m_bpp;
+    }
+
+    void FreeImageData();
+
     std::string m_fileName;
     GLenum m_textureTarget;
     GLuint m_textureObj;
+    int m_width;
+    int m_height;
+    int m_bpp;
+    unsigned int m_compression;
+    unsigned int m_format; // TEXTURE_FORMAT_* of the compressed mip chain, 0 when uncompressed
+    std::vector<TextureMip> m_mips;
+    std::vector<unsigned char> m_compressedData; // Levels from m_dataLevel on
+    bool m_streamed;
+    unsigned int m_dataLevel;
+    unsigned int m_residentLevel; // Level 0 of the texture object
+    unsigned char* m_pImageData;
+    std::vector<unsigned char> m_sourceData; // Encoded embedded image until Decode is done with it
+    bool m_embedded;
+
+    static GLuint s_placeholderObj;
+    static unsigned int s_filter;
+    static float s_maxAnisotropy;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef TEXTURE_ARRAY_H
+#define	TEXTURE_ARRAY_H
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Texture.h"
+
+// Copies a set of 2D textures of any size into the layers of one GL_TEXTURE_2D_ARRAY, so that
+// a single draw can pick the texture per sub-mesh. The copies are scaled on the GPU with
+// framebuffer blits. NULL and placeholder textures become white layers.
+class TextureArray {
+public:
+    TextureArray() {
+        m_textureObj = 0;
+        m_numLayers = 0;
+    }
+
+    ~TextureArray() {
+        Clear();
+    }
+
+    bool Init(const std::vector<Texture*>& Textures) {
+        Clear();
+
+        GLsizei Width = 1;
+        GLsizei Height = 1;
+        for (unsigned int i = 0; i < Textures.size(); i++) {
+            if (Textures[i] && !Textures[i]->IsPlaceholder()) {
+                Width = std::max(Width, (GLsizei)Textures[i]->GetWidth());
+                Height = std::max(Height, (GLsizei)Textures[i]->GetHeight());
+            }
+        }
+        m_numLayers = (unsigned int)Textures.size();
+        if (m_numLayers == 0)
+            return false;
+
+        glGenTextures(1, &m_textureObj);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureObj);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, Width, Height, m_numLayers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        GLuint Framebuffers[2];
+        glGenFramebuffers(2, Framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, Framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, Framebuffers[1]);
+
+        const GLfloat White[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (unsigned int i = 0; i < m_numLayers; i++) {
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textureObj, 0, i);
+
+            if (Textures[i] && !Textures[i]->IsPlaceholder()) {
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Textures[i]->GetTextureObj(), 0);
+                glBlitFramebuffer(0, 0, Textures[i]->GetWidth(), Textures[i]->GetHeight(), 0, 0, Width, Height,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            }
+            else
+                glClearBufferfv(GL_COLOR, 0, White);
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, Framebuffers);
+
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureObj);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        printf("Texture array %dx%d with %u layers\n", Width, Height, m_numLayers);
+        return glGetError() == GL_NO_ERROR;
+    }
+
+    void Bind(GLenum TextureUnit) {
+        glActiveTexture(TextureUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureObj);
+    }
+
+    void Clear() {
+        if (m_textureObj != 0) {
+            glDeleteTextures(1, &m_textureObj);
+            m_textureObj = 0;
+        }
+        m_numLayers = 0;
+    }
+
+private:
+    GLuint m_textureObj;
+    unsigned int m_numLayers;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#ifndef TEXTURE_CACHE_H
+#define	TEXTURE_CACHE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Mapped_file.h"
+#include "Mesh_cache.h"
+#include "Texture_compressor.h"
+
+// Block compressed mip chain of an image, stored next to the source file as <source>.texcache
+// so that the encoder runs only on the first load. Like a KTX or DDS file it holds the level
+// sizes followed by the blocks of every level. Layout: TextureCacheHeader, the TextureMip
+// table, then the blocks from the largest level to 1x1.
+
+#define TEXTURE_CACHE_MAGIC   0x48435854 // "TXCH"
+#define TEXTURE_CACHE_VERSION 1
+
+struct TextureCacheHeader {
+    unsigned int Magic;
+    unsigned int Version;
+    unsigned long long SourceSize;
+    long long SourceTime;
+    unsigned int Format; // TEXTURE_FORMAT_*
+    unsigned int NormalMap;
+    unsigned int NumMips;
+    unsigned int DataSize;
+};
+
+inline std::string GetTextureCacheFilename(const std::string& Filename) {
+    return Filename + ".texcache";
+}
+
+// Reads the level table and the blocks of the levels no larger than MaxSize, 0 reads all of them.
+// FirstLevel is the first level in Data. Fails when the cache is missing, corrupt, from another
+// version, of an unknown format, encoded for the other usage or older than the source file.
+static bool ReadTextureCache(const std::string& SourceFilename, bool NormalMap, unsigned int MaxSize, unsigned int& Format,
+    std::vector<TextureMip>& Mips, unsigned int& FirstLevel, std::vector<unsigned char>& Data) {
+    MappedFile File;
+    if (!File.Open(GetTextureCacheFilename(SourceFilename)))
+        return false;
+
+    const unsigned char* p = File.GetData();
+    const size_t Size = File.GetSize();
+    if (!p || Size < sizeof(TextureCacheHeader))
+        return false;
+
+    TextureCacheHeader Header;
+    memcpy(&Header, p, sizeof(Header));
+
+    unsigned long long SourceSize = 0;
+    long long SourceTime = 0;
+    const bool KnownFormat = Header.Format == TEXTURE_FORMAT_BC1 || Header.Format == TEXTURE_FORMAT_BC3 || Header.Format == TEXTURE_FORMAT_BC5;
+    if (Header.Magic != TEXTURE_CACHE_MAGIC || Header.Version != TEXTURE_CACHE_VERSION || !KnownFormat || Header.NormalMap != (NormalMap ? 1u : 0u) ||
+        !GetSourceFileInfo(SourceFilename, SourceSize, SourceTime) ||
+        Header.SourceSize != SourceSize || Header.SourceTime != SourceTime || Header.NumMips == 0 ||
+        sizeof(Header) + sizeof(TextureMip) * Header.NumMips + Header.DataSize != Size)
+        return false;
+
+    Mips.resize(Header.NumMips);
+    memcpy(&Mips[0], p + sizeof(Header), sizeof(TextureMip) * Header.NumMips);
+    for (unsigned int i = 0; i < Mips.size(); i++) {
+        // The levels follow each other, so the smaller levels are one range
+        const unsigned int Offset = i == 0 ? 0 : Mips[i - 1].Offset + Mips[i - 1].Size;
+        if (Mips[i].Size != GetCompressedSize(Header.Format, Mips[i].Width, Mips[i].Height) || Mips[i].Offset != Offset ||
+            (unsigned long long)Mips[i].Offset + Mips[i].Size > Header.DataSize)
+            return false;
+    }
+
+    Format = Header.Format;
+    FirstLevel = MaxSize ? GetLevelForSize(Mips, MaxSize) : 0;
+    const unsigned char* pData = p + sizeof(Header) + sizeof(TextureMip) * Header.NumMips;
+    Data.assign(pData + Mips[FirstLevel].Offset, pData + Header.DataSize);
+    return true;
+}
+
+static bool WriteTextureCache(const std::string& SourceFilename, bool NormalMap, unsigned int Format,
+    const std::vector<TextureMip>& Mips, const std::vector<unsigned char>& Data) {
+    TextureCacheHeader Header;
+    Header.Magic = TEXTURE_CACHE_MAGIC;
+    Header.Version = TEXTURE_CACHE_VERSION;
+    if (!GetSourceFileInfo(SourceFilename, Header.SourceSize, Header.SourceTime))
+        return false;
+    Header.Format = Format;
+    Header.NormalMap = NormalMap ? 1 : 0;
+    Header.NumMips = (unsigned int)Mips.size();
+    Header.DataSize = (unsigned int)Data.size();
+
+    const std::string CacheFilename = GetTextureCacheFilename(SourceFilename);
+    std::ofstream f(CacheFilename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!f) {
+        printf("Can't write texture cache '%s'\n", CacheFilename.c_str());
+        return false;
+    }
+
+    f.write((const char*)&Header, sizeof(Header));
+    f.write((const char*)&Mips[0], sizeof(Mips[0]) * Mips.size());
+    f.write((const char*)&Data[0], Data.size());
+
+    f.close();
+    if (!f) {
+        remove(CacheFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif
\ No newline at end of file
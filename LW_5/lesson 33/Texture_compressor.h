@@ -0,0 +1,280 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define	TEXTURE_COMPRESSOR_H
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// CPU encoders for the block compressed formats, run once per texture before it goes into the
+// texture cache. Every 4x4 block of RGBA8 pixels becomes 8 bytes (BC1) or 16 bytes (BC3, BC5).
+// The encoders aim for speed over quality: the color endpoints come from the principal axis of
+// the block, the single channel endpoints from its range.
+
+#define TEXTURE_FORMAT_BC1 1 // RGB, 4 bits per pixel
+#define TEXTURE_FORMAT_BC3 3 // RGBA, 8 bits per pixel
+#define TEXTURE_FORMAT_BC5 5 // Two channel normal map, 8 bits per pixel
+
+// One level of a block compressed mip chain. Offset is into the data of the chain.
+struct TextureMip {
+    unsigned int Width;
+    unsigned int Height;
+    unsigned int Offset;
+    unsigned int Size;
+};
+
+// Levels down to 1x1
+inline unsigned int GetNumMips(unsigned int Width, unsigned int Height) {
+    unsigned int NumMips = 1;
+    while (Width > 1 || Height > 1) {
+        Width = std::max(Width / 2, 1u);
+        Height = std::max(Height / 2, 1u);
+        NumMips++;
+    }
+    return NumMips;
+}
+
+// First level of the chain no larger than MaxSize in either direction, the last level when all are
+static unsigned int GetLevelForSize(const std::vector<TextureMip>& Mips, unsigned int MaxSize) {
+    for (unsigned int i = 0; i < Mips.size(); i++)
+        if (Mips[i].Width <= MaxSize && Mips[i].Height <= MaxSize)
+            return i;
+    return (unsigned int)Mips.size() - 1;
+}
+
+inline unsigned int GetBlockSize(unsigned int Format) {
+    return Format == TEXTURE_FORMAT_BC1 ? 8 : 16;
+}
+
+inline unsigned int GetCompressedSize(unsigned int Format, unsigned int Width, unsigned int Height) {
+    return ((Width + 3) / 4) * ((Height + 3) / 4) * GetBlockSize(Format);
+}
+
+static inline unsigned short PackColor565(float r, float g, float b) {
+    const unsigned int R = (unsigned int)(std::min(std::max(r, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    const unsigned int G = (unsigned int)(std::min(std::max(g, 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    const unsigned int B = (unsigned int)(std::min(std::max(b, 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)((R << 11) | (G << 5) | B);
+}
+
+static inline void UnpackColor565(unsigned short c, int* pRGB) {
+    const int R = (c >> 11) & 31;
+    const int G = (c >> 5) & 63;
+    const int B = c & 31;
+    pRGB[0] = (R << 3) | (R >> 2);
+    pRGB[1] = (G << 2) | (G >> 4);
+    pRGB[2] = (B << 3) | (B >> 2);
+}
+
+// Color images without transparent pixels get BC1, the others BC3
+static bool HasTransparentPixels(const unsigned char* pPixels, unsigned int NumPixels) {
+    for (unsigned int i = 0; i < NumPixels; i++)
+        if (pPixels[i * 4 + 3] != 255)
+            return true;
+    return false;
+}
+
+// Four color mode block of the 16 RGBA pixels in pBlock
+static void EncodeBC1Block(const unsigned char* pBlock, unsigned char* pOut) {
+    float Mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (unsigned int i = 0; i < 16; i++)
+        for (unsigned int c = 0; c < 3; c++)
+            Mean[c] += pBlock[i * 4 + c];
+    for (unsigned int c = 0; c < 3; c++)
+        Mean[c] /= 16.0f;
+
+    float Cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+    for (unsigned int i = 0; i < 16; i++) {
+        const float r = pBlock[i * 4] - Mean[0];
+        const float g = pBlock[i * 4 + 1] - Mean[1];
+        const float b = pBlock[i * 4 + 2] - Mean[2];
+        Cov[0] += r * r;
+        Cov[1] += r * g;
+        Cov[2] += r * b;
+        Cov[3] += g * g;
+        Cov[4] += g * b;
+        Cov[5] += b * b;
+    }
+
+    // A few power iterations are enough for the principal axis
+    float Axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (unsigned int Iter = 0; Iter < 4; Iter++) {
+        const float x = Cov[0] * Axis[0] + Cov[1] * Axis[1] + Cov[2] * Axis[2];
+        const float y = Cov[1] * Axis[0] + Cov[3] * Axis[1] + Cov[4] * Axis[2];
+        const float z = Cov[2] * Axis[0] + Cov[4] * Axis[1] + Cov[5] * Axis[2];
+        const float Length = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+        if (Length == 0.0f)
+            break;
+        Axis[0] = x / Length;
+        Axis[1] = y / Length;
+        Axis[2] = z / Length;
+    }
+
+    unsigned int MinPixel = 0, MaxPixel = 0;
+    float MinDot = 1e30f, MaxDot = -1e30f;
+    for (unsigned int i = 0; i < 16; i++) {
+        const float Dot = pBlock[i * 4] * Axis[0] + pBlock[i * 4 + 1] * Axis[1] + pBlock[i * 4 + 2] * Axis[2];
+        if (Dot < MinDot) {
+            MinDot = Dot;
+            MinPixel = i;
+        }
+        if (Dot > MaxDot) {
+            MaxDot = Dot;
+            MaxPixel = i;
+        }
+    }
+
+    const unsigned char* pMax = pBlock + MaxPixel * 4;
+    const unsigned char* pMin = pBlock + MinPixel * 4;
+    unsigned short c0 = PackColor565(pMax[0], pMax[1], pMax[2]);
+    unsigned short c1 = PackColor565(pMin[0], pMin[1], pMin[2]);
+    // c0 > c1 selects the four color mode, which BC3 assumes anyway
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    unsigned int Indices = 0;
+    if (c0 != c1) {
+        int Palette[4][3];
+        UnpackColor565(c0, Palette[0]);
+        UnpackColor565(c1, Palette[1]);
+        for (unsigned int c = 0; c < 3; c++) {
+            Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+            Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+        }
+
+        for (unsigned int i = 0; i < 16; i++) {
+            unsigned int Best = 0;
+            int BestDist = 0x7FFFFFFF;
+            for (unsigned int k = 0; k < 4; k++) {
+                const int dr = pBlock[i * 4] - Palette[k][0];
+                const int dg = pBlock[i * 4 + 1] - Palette[k][1];
+                const int db = pBlock[i * 4 + 2] - Palette[k][2];
+                const int Dist = dr * dr + dg * dg + db * db;
+                if (Dist < BestDist) {
+                    BestDist = Dist;
+                    Best = k;
+                }
+            }
+            Indices |= Best << (i * 2);
+        }
+    }
+
+    pOut[0] = (unsigned char)(c0 & 0xFF);
+    pOut[1] = (unsigned char)(c0 >> 8);
+    pOut[2] = (unsigned char)(c1 & 0xFF);
+    pOut[3] = (unsigned char)(c1 >> 8);
+    for (unsigned int i = 0; i < 4; i++)
+        pOut[4 + i] = (unsigned char)(Indices >> (i * 8));
+}
+
+// Eight value mode block of channel Channel of the 16 RGBA pixels, used for the BC3 alpha and
+// both BC5 channels
+static void EncodeBC4Block(const unsigned char* pBlock, unsigned int Channel, unsigned char* pOut) {
+    unsigned int Min = 255, Max = 0;
+    for (unsigned int i = 0; i < 16; i++) {
+        Min = std::min(Min, (unsigned int)pBlock[i * 4 + Channel]);
+        Max = std::max(Max, (unsigned int)pBlock[i * 4 + Channel]);
+    }
+
+    pOut[0] = (unsigned char)Max;
+    pOut[1] = (unsigned char)Min;
+
+    unsigned long long Indices = 0;
+    if (Max > Min) {
+        // Position 0..7 from Max to Min, index 0 and 1 are the endpoints and 2..7 the values
+        // between them
+        static const unsigned int PositionToIndex[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+        const unsigned int Range = Max - Min;
+        for (unsigned int i = 0; i < 16; i++) {
+            const unsigned int Position = ((Max - pBlock[i * 4 + Channel]) * 7 + Range / 2) / Range;
+            Indices |= (unsigned long long)PositionToIndex[Position] << (i * 3);
+        }
+    }
+
+    for (unsigned int i = 0; i < 6; i++)
+        pOut[2 + i] = (unsigned char)(Indices >> (i * 8));
+}
+
+// Compresses an RGBA8 image. Blocks over the right and bottom edge repeat the edge pixels.
+static void CompressImage(const unsigned char* pPixels, unsigned int Width, unsigned int Height, unsigned int Format, unsigned char* pOut) {
+    unsigned char Block[64];
+    for (unsigned int y = 0; y < Height; y += 4) {
+        for (unsigned int x = 0; x < Width; x += 4) {
+            for (unsigned int i = 0; i < 16; i++) {
+                const unsigned int px = std::min(x + (i & 3), Width - 1);
+                const unsigned int py = std::min(y + (i >> 2), Height - 1);
+                memcpy(Block + i * 4, pPixels + (py * Width + px) * 4, 4);
+            }
+
+            if (Format == TEXTURE_FORMAT_BC1)
+                EncodeBC1Block(Block, pOut);
+            else if (Format == TEXTURE_FORMAT_BC3) {
+                EncodeBC4Block(Block, 3, pOut);
+                EncodeBC1Block(Block, pOut + 8);
+            }
+            else {
+                EncodeBC4Block(Block, 0, pOut);
+                EncodeBC4Block(Block, 1, pOut + 8);
+            }
+            pOut += GetBlockSize(Format);
+        }
+    }
+}
+
+// 2x2 box filter, odd sizes repeat the last row or column. Normal maps are renormalized.
+static void DownsampleImage(const unsigned char* pSrc, unsigned int Width, unsigned int Height, bool NormalMap, std::vector<unsigned char>& Dst) {
+    const unsigned int DstWidth = std::max(Width / 2, 1u);
+    const unsigned int DstHeight = std::max(Height / 2, 1u);
+    Dst.resize(DstWidth * DstHeight * 4);
+
+    for (unsigned int y = 0; y < DstHeight; y++) {
+        const unsigned int y0 = std::min(y * 2, Height - 1);
+        const unsigned int y1 = std::min(y * 2 + 1, Height - 1);
+        for (unsigned int x = 0; x < DstWidth; x++) {
+            const unsigned int x0 = std::min(x * 2, Width - 1);
+            const unsigned int x1 = std::min(x * 2 + 1, Width - 1);
+            const unsigned char* p[4] = { pSrc + (y0 * Width + x0) * 4, pSrc + (y0 * Width + x1) * 4,
+                                          pSrc + (y1 * Width + x0) * 4, pSrc + (y1 * Width + x1) * 4 };
+            unsigned char* pDst = &Dst[(y * DstWidth + x) * 4];
+            for (unsigned int c = 0; c < 4; c++)
+                pDst[c] = (unsigned char)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+
+            if (NormalMap) {
+                float n[3];
+                for (unsigned int c = 0; c < 3; c++)
+                    n[c] = pDst[c] / 127.5f - 1.0f;
+                const float Length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (Length > 0.0f)
+                    for (unsigned int c = 0; c < 3; c++)
+                        pDst[c] = (unsigned char)((n[c] / Length + 1.0f) * 127.5f + 0.5f);
+            }
+        }
+    }
+}
+
+// Compresses the image and all its mip levels down to 1x1 into Data
+static void CompressMipChain(const unsigned char* pPixels, unsigned int Width, unsigned int Height, unsigned int Format, bool NormalMap,
+    std::vector<TextureMip>& Mips, std::vector<unsigned char>& Data) {
+    Mips.clear();
+    unsigned int Offset = 0;
+    for (unsigned int w = Width, h = Height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+        TextureMip Mip = { w, h, Offset, GetCompressedSize(Format, w, h) };
+        Mips.push_back(Mip);
+        Offset += Mip.Size;
+        if (w == 1 && h == 1)
+            break;
+    }
+    Data.resize(Offset);
+
+    std::vector<unsigned char> Levels[2];
+    const unsigned char* pLevel = pPixels;
+    for (unsigned int i = 0; i < Mips.size(); i++) {
+        CompressImage(pLevel, Mips[i].Width, Mips[i].Height, Format, &Data[Mips[i].Offset]);
+        if (i + 1 < Mips.size()) {
+            DownsampleImage(pLevel, Mips[i].Width, Mips[i].Height, NormalMap, Levels[i & 1]);
+            pLevel = &Levels[i & 1][0];
+        }
+    }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+#ifndef TEXTURE_LOADER_H
+#define	TEXTURE_LOADER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Util.h"
+#include "Texture.h"
+#include "Thread_pool.h"
+
+#define TEXTURE_LOADER_NUM_WORKERS 2
+
+// Streams textures in without stalling the render thread. The images are decoded on the loader
+// threads, which also copy the pixels into a mapped pixel buffer object. The render thread only
+// maps and unmaps the buffers and starts the uploads from them, which the driver can run
+// asynchronously. A texture shows the placeholder until the fence after its upload has
+// signaled, then the new texture object is swapped in. Images which can't be read keep the
+// placeholder. StreamAsync replaces the mip chain of a streamed texture the same way.
+class TextureLoader {
+public:
+    TextureLoader(unsigned int NumWorkers = TEXTURE_LOADER_NUM_WORKERS) : m_pool(NumWorkers) {
+        m_numInWorker = 0;
+    }
+
+    // Must be called while the GL context is still current. The textures still loading keep the
+    // placeholder.
+    ~TextureLoader() {
+        {
+            std::unique_lock<std::mutex> Lock(m_mutex);
+            m_workerCond.wait(Lock, [this]() { return m_numInWorker == 0; });
+        }
+
+        while (!m_jobs.empty())
+            Release(m_jobs.back());
+    }
+
+    // Binds the placeholder right away and loads the image in the background. A texture which is
+    // already decoded is only uploaded. A pending texture must be passed to Cancel before it is
+    // deleted.
+    void LoadAsync(Texture* pTexture) {
+        pTexture->UsePlaceholder();
+
+        Job* pJob = CreateJob(pTexture);
+
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        m_jobs.push_back(pJob);
+        if (pTexture->GetImageData()) {
+            m_ready.push_back(pJob);
+            return;
+        }
+
+        pJob->State = JOB_DECODING;
+        RunInWorker(pJob, [this, pJob]() {
+            const bool Decoded = pJob->pTexture->Decode();
+            WorkerDone(pJob, Decoded ? JOB_DECODED : JOB_FAILED);
+        });
+    }
+
+    // Reads the levels from FirstLevel on of a streamed texture from the texture cache and swaps
+    // them in for the current ones, which stay in use until then. The texture must not be pending.
+    void StreamAsync(Texture* pTexture, unsigned int FirstLevel) {
+        Job* pJob = CreateJob(pTexture);
+
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        m_jobs.push_back(pJob);
+        pJob->State = JOB_DECODING;
+        RunInWorker(pJob, [this, pJob, FirstLevel]() {
+            const bool Loaded = pJob->pTexture->LoadLevels(FirstLevel);
+            WorkerDone(pJob, Loaded ? JOB_DECODED : JOB_FAILED);
+        });
+    }
+
+    bool IsPending(const Texture* pTexture) {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        for (unsigned int i = 0; i < m_jobs.size(); i++)
+            if (m_jobs[i]->pTexture == pTexture)
+                return true;
+        return false;
+    }
+
+    // Waits until no loader thread works on the texture and forgets it. The texture keeps
+    // whatever it shows at that point.
+    void Cancel(Texture* pTexture) {
+        std::unique_lock<std::mutex> Lock(m_mutex);
+        for (unsigned int i = 0; i < m_jobs.size(); i++) {
+            Job* pJob = m_jobs[i];
+            if (pJob->pTexture == pTexture) {
+                m_workerCond.wait(Lock, [pJob]() { return !pJob->InWorker; });
+                // ProcessUploads releases the GL objects of the job
+                pJob->pTexture = NULL;
+            }
+        }
+    }
+
+    // Called on the render thread once per frame. Swaps in the textures whose upload has
+    // finished, then starts the next steps until BudgetMicros have passed.
+    void ProcessUploads(long long BudgetMicros) {
+        const long long Start = GetCurrentTimeMicros();
+
+        for (unsigned int i = 0; i < m_uploading.size();) {
+            Job* pJob = m_uploading[i];
+            const GLenum Status = pJob->pTexture ? glClientWaitSync(pJob->Fence, 0, 0) : GL_ALREADY_SIGNALED;
+            if (Status == GL_TIMEOUT_EXPIRED) {
+                i++;
+                continue;
+            }
+
+            if (pJob->pTexture) {
+                pJob->pTexture->SetTextureObj(pJob->TextureObj, pJob->Level);
+                pJob->TextureObj = 0;
+                printf("Streamed texture '%s' in %.2f ms\n", pJob->pTexture->GetFileName().c_str(),
+                    (GetCurrentTimeMicros() - pJob->Start) / 1000.0);
+            }
+            m_uploading.erase(m_uploading.begin() + i);
+            Release(pJob);
+        }
+
+        do {
+            Job* pJob = NULL;
+            {
+                std::lock_guard<std::mutex> Lock(m_mutex);
+                if (m_ready.empty())
+                    return;
+                pJob = m_ready.front();
+                m_ready.pop_front();
+            }
+
+            if (!pJob->pTexture || pJob->State == JOB_FAILED)
+                Release(pJob);
+            else if (pJob->State == JOB_DECODED)
+                StartCopy(pJob);
+            else
+                StartUpload(pJob);
+        } while (GetCurrentTimeMicros() - Start < BudgetMicros);
+    }
+
+    // Number of pending loads and streams
+    unsigned int GetNumPending() {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        return (unsigned int)m_jobs.size();
+    }
+
+private:
+    enum JobState {
+        JOB_DECODING,  // Loader thread
+        JOB_DECODED,   // Waiting for a pixel buffer
+        JOB_COPYING,   // Loader thread
+        JOB_COPIED,    // Waiting for the upload
+        JOB_UPLOADING, // Waiting for the fence
+        JOB_FAILED
+    };
+
+    struct Job {
+        Texture* pTexture; // NULL once canceled
+        JobState State;
+        bool InWorker;
+        GLuint PBO;
+        void* pMapped;
+        GLuint TextureObj;
+        GLsync Fence;
+        unsigned int Level; // Level 0 of TextureObj
+        long long Start;
+    };
+
+    static Job* CreateJob(Texture* pTexture) {
+        Job* pJob = new Job;
+        pJob->pTexture = pTexture;
+        pJob->State = JOB_DECODED;
+        pJob->InWorker = false;
+        pJob->PBO = 0;
+        pJob->pMapped = NULL;
+        pJob->TextureObj = 0;
+        pJob->Fence = 0;
+        pJob->Level = 0;
+        pJob->Start = GetCurrentTimeMicros();
+        return pJob;
+    }
+
+    template <typename TaskFunc>
+    void RunInWorker(Job* pJob, TaskFunc Task) {
+        // m_mutex is held
+        pJob->InWorker = true;
+        m_numInWorker++;
+        m_pool.Submit(Task);
+    }
+
+    void WorkerDone(Job* pJob, JobState State) {
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        pJob->State = State;
+        pJob->InWorker = false;
+        m_numInWorker--;
+        m_ready.push_back(pJob);
+        m_workerCond.notify_all();
+    }
+
+    // Render thread: maps a pixel buffer of the image size, a loader thread fills it
+    void StartCopy(Job* pJob) {
+        Texture* pTexture = pJob->pTexture;
+        const size_t Size = pTexture->GetImageSize();
+        pJob->Level = pTexture->m_dataLevel;
+
+        glGenBuffers(1, &pJob->PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pJob->PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, Size, NULL, GL_STREAM_DRAW);
+        pJob->pMapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, Size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!pJob->pMapped) {
+            // Upload from the client memory instead
+            pTexture->SetTextureObj(pTexture->CreateTextureObj(pTexture->GetImageData()), pJob->Level);
+            pTexture->FreeImageData();
+            Release(pJob);
+            return;
+        }
+
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        pJob->State = JOB_COPYING;
+        RunInWorker(pJob, [this, pJob]() {
+            memcpy(pJob->pMapped, pJob->pTexture->GetImageData(), pJob->pTexture->GetImageSize());
+            WorkerDone(pJob, JOB_COPIED);
+        });
+    }
+
+    // Render thread: the texture is created from the pixel buffer, the fence tells when the
+    // copy into it is done
+    void StartUpload(Job* pJob) {
+        Texture* pTexture = pJob->pTexture;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pJob->PBO);
+        const bool Unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        pJob->pMapped = NULL;
+        if (Unmapped)
+            pJob->TextureObj = pTexture->CreateTextureObj(NULL);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!Unmapped) {
+            // The buffer contents were lost while mapped
+            pJob->TextureObj = pTexture->CreateTextureObj(pTexture->GetImageData());
+        }
+        pTexture->FreeImageData();
+
+        pJob->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        pJob->State = JOB_UPLOADING;
+        m_uploading.push_back(pJob);
+    }
+
+    // Render thread, the job is in no queue
+    void Release(Job* pJob) {
+        if (pJob->pMapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pJob->PBO);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (pJob->PBO != 0)
+            glDeleteBuffers(1, &pJob->PBO);
+        if (pJob->TextureObj != 0)
+            glDeleteTextures(1, &pJob->TextureObj);
+        if (pJob->Fence)
+            glDeleteSync(pJob->Fence);
+
+        if (pJob->State == JOB_FAILED && pJob->pTexture)
+            printf("Keeping the current texture for '%s'\n", pJob->pTexture->GetFileName().c_str());
+
+        std::lock_guard<std::mutex> Lock(m_mutex);
+        m_jobs.erase(std::find(m_jobs.begin(), m_jobs.end(), pJob));
+        delete pJob;
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_workerCond;
+    std::vector<Job*> m_jobs;     // All pending loads
+    std::deque<Job*> m_ready;     // Waiting for the render thread
+    std::vector<Job*> m_uploading; // Render thread only
+    unsigned int m_numInWorker;
+    ThreadPool m_pool;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,210 @@
+#ifndef TEXTURE_STREAMER_H
+#define	TEXTURE_STREAMER_H
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <vector>
+
+#include "Texture.h"
+#include "Texture_loader.h"
+
+#define TEXTURE_STREAM_UNUSED_FRAMES 120 // Frames without a request before a texture may drop to the initial level
+#define TEXTURE_STREAM_MAX_PENDING   4   // Streams in flight
+
+struct TextureStreamStats {
+    size_t ResidentSize;     // Video memory of the streamed textures
+    unsigned int NumPending; // Streams in flight
+    unsigned int NumStreamedIn;
+    unsigned int NumEvicted;
+};
+
+// Keeps the streamed textures at the mip level they are seen at, within a video memory budget.
+// The renderer reports every frame how many UV units a screen pixel covers for every texture
+// it draws, the level that needs is log2 of the texels per pixel. Update streams the missing
+// larger levels in through the TextureLoader, finest first for the textures furthest from
+// their level. When the budget runs out the levels nobody needs are dropped again, starting
+// with the textures which free the most memory.
+class TextureStreamer {
+public:
+    TextureStreamer(TextureLoader* pLoader, size_t BudgetSize) {
+        m_pLoader = pLoader;
+        m_budgetSize = BudgetSize;
+        m_frame = 0;
+        m_numStreamedIn = 0;
+        m_numEvicted = 0;
+    }
+
+    // The texture must be a streamed one, see Texture::SetStreamed. It is managed once its
+    // initial load is done.
+    void Add(Texture* pTexture) {
+        StreamedTexture t;
+        t.pTexture = pTexture;
+        t.UVPerPixel = FLT_MAX;
+        t.FrameUVPerPixel = FLT_MAX;
+        t.LastUsed = m_frame;
+        t.Pending = false;
+        t.Target = 0;
+        m_textures.push_back(t);
+    }
+
+    // Before the texture is canceled in the loader and deleted
+    void Remove(Texture* pTexture) {
+        for (unsigned int i = 0; i < m_textures.size(); i++) {
+            if (m_textures[i].pTexture == pTexture) {
+                m_textures.erase(m_textures.begin() + i);
+                return;
+            }
+        }
+    }
+
+    // UV units covered by a screen pixel where the texture is drawn. The smallest value of the
+    // frame counts.
+    void RequestDensity(const Texture* pTexture, float UVPerPixel) {
+        for (unsigned int i = 0; i < m_textures.size(); i++) {
+            if (m_textures[i].pTexture == pTexture) {
+                m_textures[i].FrameUVPerPixel = std::min(m_textures[i].FrameUVPerPixel, UVPerPixel);
+                m_textures[i].LastUsed = m_frame;
+                return;
+            }
+        }
+    }
+
+    // Called on the render thread once per frame after the requests
+    void Update() {
+        std::vector<Candidate> Evict;
+        std::vector<Candidate> Load;
+        size_t Projected = 0;
+        unsigned int NumPending = 0;
+
+        for (unsigned int i = 0; i < m_textures.size(); i++) {
+            StreamedTexture& t = m_textures[i];
+            // A frame without a request keeps the last one until the texture counts as unused
+            if (t.FrameUVPerPixel != FLT_MAX)
+                t.UVPerPixel = t.FrameUVPerPixel;
+            t.FrameUVPerPixel = FLT_MAX;
+
+            // A loader thread writes the image data of a pending texture, only its level table
+            // stays the same
+            if (m_pLoader->IsPending(t.pTexture)) {
+                if (t.Pending) {
+                    Projected += t.pTexture->GetLevelsSize(t.Target);
+                    NumPending++;
+                }
+                continue;
+            }
+            t.Pending = false;
+            if (!t.pTexture->IsStreamed() || t.pTexture->GetNumLevels() == 0) {
+                // Failed to load or to stream, stays as it is
+                Projected += t.pTexture->GetMemorySize();
+                continue;
+            }
+
+            const unsigned int Resident = t.pTexture->GetResidentLevel();
+            const unsigned int Needed = GetNeededLevel(t);
+            Projected += t.pTexture->GetLevelsSize(Resident);
+            if (Resident < Needed)
+                Evict.push_back(Candidate(i, Needed, t.pTexture->GetLevelsSize(Resident) - t.pTexture->GetLevelsSize(Needed)));
+            else if (Resident > Needed)
+                Load.push_back(Candidate(i, Needed, Resident - Needed));
+        }
+
+        // The streams are counted at their new size, the old levels stay in video memory until
+        // the new ones are swapped in. TEXTURE_STREAM_MAX_PENDING bounds that overshoot.
+        if (Projected > m_budgetSize) {
+            std::sort(Evict.begin(), Evict.end());
+            for (unsigned int i = 0; i < Evict.size() && Projected > m_budgetSize && NumPending < TEXTURE_STREAM_MAX_PENDING; i++) {
+                StreamedTexture& t = m_textures[Evict[i].Index];
+                Projected -= Evict[i].Priority;
+                Stream(t, Evict[i].Level);
+                NumPending++;
+                m_numEvicted++;
+            }
+        }
+
+        std::sort(Load.begin(), Load.end());
+        for (unsigned int i = 0; i < Load.size() && NumPending < TEXTURE_STREAM_MAX_PENDING; i++) {
+            StreamedTexture& t = m_textures[Load[i].Index];
+            const unsigned int Resident = t.pTexture->GetResidentLevel();
+            const size_t ResidentSize = t.pTexture->GetLevelsSize(Resident);
+            for (unsigned int Level = Load[i].Level; Level < Resident; Level++) {
+                const size_t Size = t.pTexture->GetLevelsSize(Level);
+                if (Projected - ResidentSize + Size <= m_budgetSize) {
+                    Projected += Size - ResidentSize;
+                    Stream(t, Level);
+                    NumPending++;
+                    m_numStreamedIn++;
+                    break;
+                }
+            }
+        }
+
+        m_frame++;
+    }
+
+    void GetStats(TextureStreamStats& Stats) {
+        Stats.ResidentSize = 0;
+        Stats.NumPending = 0;
+        for (unsigned int i = 0; i < m_textures.size(); i++) {
+            // The levels of a pending texture can't be read
+            if (m_pLoader->IsPending(m_textures[i].pTexture))
+                Stats.NumPending += m_textures[i].Pending;
+            else
+                Stats.ResidentSize += m_textures[i].pTexture->GetMemorySize();
+        }
+        Stats.NumStreamedIn = m_numStreamedIn;
+        Stats.NumEvicted = m_numEvicted;
+    }
+
+private:
+    struct StreamedTexture {
+        Texture* pTexture;
+        float UVPerPixel;      // Smallest request of the last frame with one, FLT_MAX before the first
+        float FrameUVPerPixel; // Smallest request of the current frame, FLT_MAX without one
+        unsigned int LastUsed; // Frame of the last request
+        bool Pending;          // Streaming to Target
+        unsigned int Target;
+    };
+
+    // Sorted by decreasing Priority
+    struct Candidate {
+        Candidate(unsigned int i, unsigned int l, size_t p) : Index(i), Level(l), Priority(p) {}
+
+        bool operator<(const Candidate& c) const {
+            return Priority > c.Priority;
+        }
+
+        unsigned int Index;
+        unsigned int Level;
+        size_t Priority;
+    };
+
+    // Never coarser than the initial level, which every streamed texture keeps
+    unsigned int GetNeededLevel(const StreamedTexture& t) const {
+        const unsigned int Initial = t.pTexture->GetLevelForSize(TEXTURE_STREAM_INITIAL_SIZE);
+        if (m_frame - t.LastUsed > TEXTURE_STREAM_UNUSED_FRAMES || t.UVPerPixel == FLT_MAX)
+            return Initial;
+
+        // The sampler picks the level from the larger texel footprint, the floor keeps the
+        // level it blends with
+        const TextureMip& Top = t.pTexture->GetLevel(0);
+        const float TexelsPerPixel = t.UVPerPixel * sqrtf((float)Top.Width * Top.Height);
+        const float Level = TexelsPerPixel > 1.0f ? floorf(log2f(TexelsPerPixel)) : 0.0f;
+        return std::min((unsigned int)Level, Initial);
+    }
+
+    void Stream(StreamedTexture& t, unsigned int Level) {
+        t.Pending = true;
+        t.Target = Level;
+        m_pLoader->StreamAsync(t.pTexture, Level);
+    }
+
+    TextureLoader* m_pLoader;
+    size_t m_budgetSize;
+    std::vector<StreamedTexture> m_textures;
+    unsigned int m_frame;
+    unsigned int m_numStreamedIn;
+    unsigned int m_numEvicted;
+};
+
+#endif
\ No newline at end of file
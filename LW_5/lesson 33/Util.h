@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <chrono>
 
 #ifdef WIN32
 #define SNPRINTF _snprintf_s
@@ -35,4 +36,8 @@
 
 #define GLCheckError() (glGetError() == GL_NO_ERROR)
 
+inline long long GetCurrentTimeMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #endif
\ No newline at end of file
@@ -1,7 +1,11 @@
 ﻿#include <math.h>
+#include <float.h>
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 #include <time.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
 
 #include "Engine_common.h"
 #include "Util.h"
@@ -11,13 +15,28 @@
 #include "Lighting_technique.h"
 #include "Glut_backend.h"
 #include "Mesh.h"
+#include "Mesh_loader.h"
+#include "Texture_loader.h"
+#include "Texture_streamer.h"
+#include "Gpu_timer.h"
+#include "Thread_pool.h"
+#include "Benchmark.h"
 
 #define WINDOW_WIDTH  1280  
 #define WINDOW_HEIGHT 1024
 
-#define NUM_ROWS 50
-#define NUM_COLS 20
-#define NUM_INSTANCES NUM_ROWS * NUM_COLS
+#define DEFAULT_NUM_ROWS 50
+#define DEFAULT_NUM_COLS 20
+
+#define MESH_UPLOAD_BUDGET_MICROS 2000 // GL time per frame given to the background mesh loads
+#define TEXTURE_UPLOAD_BUDGET_MICROS 1000 // Same for the streamed textures
+
+#define INSTANCE_CULLED MESH_MAX_LODS // LOD of the instances outside the view frustum
+
+static const char* GetFilterName(unsigned int Filter) {
+    static const char* Names[] = { "bilinear", "trilinear", "anisotropic" };
+    return Names[Filter];
+}
 
 float RandomFloat() {
     return (float)(std::rand()) / (float)(std::rand());
@@ -25,7 +44,15 @@ float RandomFloat() {
 
 class Tutorial33 : public ICallbacks {
 public:
-    Tutorial33() {
+    Tutorial33(unsigned int NumRows, unsigned int NumCols, bool CompactInstances, unsigned int MeshFlags, float MaxAnisotropy, bool BenchFilter,
+        size_t TextureBudget) {
+        m_numRows = NumRows;
+        m_numCols = NumCols;
+        m_numInstances = NumRows * NumCols;
+        m_compactInstances = CompactInstances;
+        m_meshFlags = MeshFlags;
+        m_instanceRotation = Vector3f(0.0f, 90.0f, 0.0f);
+        m_instanceScale = Vector3f(0.005f, 0.005f, 0.005f);
         m_pGameCamera = NULL;
         m_pEffect = NULL;
         m_scale = 0.0f;
@@ -41,14 +68,32 @@ public:
         m_persProjInfo.zFar = 100.0f;
 
         m_pMesh = NULL;
+        m_pMeshLoader = NULL;
+        m_pTextureLoader = NULL;
+        m_pTextureStreamer = NULL;
+        m_textureBudget = TextureBudget;
         m_frameCount = 0;
         m_fps = 0.0f;
+        m_cullInstances = true;
+        m_numVisible = 0;
+        m_visibleFrameCount = 0;
+        m_culledFrameCount = 0;
+        m_textureMemoryReported = false;
+        // The filter benchmark goes from the cheapest filter to the best one
+        m_benchFilter = BenchFilter;
+        m_textureFilter = BenchFilter ? TEXTURE_FILTER_BILINEAR : TEXTURE_FILTER_ANISOTROPIC;
+        m_maxAnisotropy = MaxAnisotropy;
+        Texture::SetDefaultFilter(m_textureFilter, m_maxAnisotropy);
     }
 
     ~Tutorial33() {
+        // Stops the loads before the mesh goes away
+        SAFE_DELETE(m_pMeshLoader);
         SAFE_DELETE(m_pEffect);
         SAFE_DELETE(m_pGameCamera);
         SAFE_DELETE(m_pMesh);
+        SAFE_DELETE(m_pTextureStreamer);
+        SAFE_DELETE(m_pTextureLoader);
     }
 
     bool Init() {
@@ -57,7 +102,36 @@ public:
         Vector3f Up(0.0, 1.0f, 0.0f);
         m_pGameCamera = new Camera(WINDOW_WIDTH, WINDOW_HEIGHT, Pos, Target, Up);
 
-        m_pEffect = new LightingTechnique();
+        // The mesh loads in the background, the effect is created once it is in because the
+        // shaders depend on how the mesh is drawn
+        m_pMeshLoader = new MeshLoader();
+        m_pTextureLoader = new TextureLoader();
+        m_pMesh = new Mesh();
+        // Nothing else runs on the frame pool until the mesh is in
+        m_pMesh->SetImportThreadPool(&m_threadPool);
+        m_pMesh->SetTextureLoader(m_pTextureLoader);
+        if (m_textureBudget > 0) {
+            m_pTextureStreamer = new TextureStreamer(m_pTextureLoader, m_textureBudget);
+            m_pMesh->SetTextureStreamer(m_pTextureStreamer);
+        }
+        m_pMeshLoader->LoadMeshAsync(m_pMesh, "C:/tmp/Spider.obj", m_meshFlags);
+
+#ifdef FREETYPE
+        if (!m_fontRenderer.InitFontRenderer())
+            return false;
+#endif
+        m_pipeline.SetPerspectiveProj(m_persProjInfo);
+        m_pipeline.Rotate(m_instanceRotation.x, m_instanceRotation.y, m_instanceRotation.z);
+        m_pipeline.Scale(m_instanceScale);
+
+        m_time = glutGet(GLUT_ELAPSED_TIME);
+        CalcPositions();
+
+        return true;
+    }
+
+    bool InitEffect() {
+        m_pEffect = new LightingTechnique(m_compactInstances, m_pMesh->IsMultiDraw());
         if (!m_pEffect->Init()) {
             printf("Error initializing the lighting technique\n");
             return false;
@@ -72,16 +146,15 @@ public:
         m_pEffect->SetColor(2, Vector4f(1.0f, 0.5f, 1.0f, 0.0f));
         m_pEffect->SetColor(3, Vector4f(1.0f, 1.0f, 1.0f, 0.0f));
 
-        m_pMesh = new Mesh();
-        if (!m_pMesh->LoadMesh("C:/tmp/Spider.obj"))
-            return false;
+        Vector3f PosOffset, PosScale;
+        const bool Quantized = m_pMesh->GetPositionDecode(PosOffset, PosScale);
+        m_pEffect->SetVertexDecode(PosOffset, PosScale, Quantized);
 
-#ifdef FREETYPE
-        if (!m_fontRenderer.InitFontRenderer())
-            return false;
-#endif
-        m_time = glutGet(GLUT_ELAPSED_TIME);
-        CalcPositions();
+        if (m_pMesh->IsMultiDraw()) {
+            std::vector<int> EntryMaterials;
+            m_pMesh->GetEntryMaterials(EntryMaterials);
+            m_pEffect->SetEntryMaterials((unsigned int)EntryMaterials.size(), &EntryMaterials[0]);
+        }
 
         return true;
     }
@@ -93,33 +166,85 @@ public:
     virtual void RenderSceneCB() {
         CalcFPS();
 
+        m_pMeshLoader->ProcessUploads(MESH_UPLOAD_BUDGET_MICROS);
+        m_pTextureLoader->ProcessUploads(TEXTURE_UPLOAD_BUDGET_MICROS);
+
         m_scale += 0.005f;
 
         m_pGameCamera->OnRender();
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        // The window stays responsive while the mesh is loading
+        if (!m_pMesh->IsReady()) {
+            if (m_pMesh->GetLoadState() == MESH_STATE_FAILED)
+                glutLeaveMainLoop();
+            glutSwapBuffers();
+            return;
+        }
+
+        if (!m_pEffect && !InitEffect()) {
+            glutLeaveMainLoop();
+            return;
+        }
+
         m_pEffect->Enable();
         m_pEffect->SetEyeWorldPos(m_pGameCamera->GetPos());
 
-        Pipeline p;
-        p.SetCamera(m_pGameCamera->GetPos(), m_pGameCamera->GetTarget(), m_pGameCamera->GetUp());
-        p.SetPerspectiveProj(m_persProjInfo);
-        p.Rotate(0.0f, 90.0f, 0.0f);
-        p.Scale(0.005f, 0.005f, 0.005f);
+        m_pipeline.SetCamera(m_pGameCamera->GetPos(), m_pGameCamera->GetTarget(), m_pGameCamera->GetUp());
+        m_frustum.Init(m_pipeline.GetVPTrans());
+
+        AnimateInstances();
+        SortInstancesByLod();
+
+        if (m_pTextureStreamer) {
+            RequestTextureDensity();
+            m_pTextureStreamer->Update();
+        }
 
-        Matrix4f WVPMatrics[NUM_INSTANCES];
-        Matrix4f WorldMatrices[NUM_INSTANCES];
+        // The LOD 0 bucket is drawn as the meshlets which survive the cone and frustum tests
+        if (m_pMesh->HasMeshlets()) {
+            m_pMesh->CullMeshlets(m_frustum, m_pGameCamera->GetPos(), m_lodCounts[0], [&](unsigned int i) {
+                InstanceTRS Instance;
+                Instance.Pos = m_sortedPositions[i];
+                Instance.Rot = m_instanceRot;
+                Instance.Scale = m_instanceScale;
+                return Instance;
+            }, &m_threadPool);
+        }
 
-        for (unsigned int i = 0; i < NUM_INSTANCES; i++) {
-            Vector3f Pos(m_positions[i]);
-            Pos.y += sinf(m_scale) * m_velocity[i];
-            p.WorldPos(Pos);
-            WVPMatrics[i] = p.GetWVPTrans().Transpose();
-            WorldMatrices[i] = p.GetWorldTrans().Transpose();
+        if (m_numVisible == 0) {
+            RenderFPS();
+            glutSwapBuffers();
+            return;
         }
 
-        m_pMesh->Render(NUM_INSTANCES, WVPMatrics, WorldMatrices);
+        // Every worker writes its range of the visible LOD sorted instances straight into the
+        // mapped instance buffer region which the GPU is not reading from
+        if (m_compactInstances) {
+            m_pEffect->SetVP(m_pipeline.GetVPTrans());
+
+            InstanceTRS* pInstances = m_pMesh->MapInstanceTRS(m_numVisible);
+            m_threadPool.ParallelFor(m_numVisible, [&](unsigned int Begin, unsigned int End) {
+                for (unsigned int i = Begin; i < End; i++) {
+                    pInstances[i].Pos = m_sortedPositions[i];
+                    pInstances[i].Rot = m_instanceRot;
+                    pInstances[i].Scale = m_instanceScale;
+                }
+            });
+        }
+        else {
+            m_pipeline.PrepareInstanceTrans();
+
+            Matrix4f* pMatrices = m_pMesh->MapInstanceMatrices(m_numVisible);
+            m_threadPool.ParallelFor(m_numVisible, [&](unsigned int Begin, unsigned int End) {
+                m_pipeline.CalcInstanceTrans(Begin, End, &m_sortedPositions[0], NULL, NULL, pMatrices, pMatrices + m_numVisible);
+            });
+        }
+
+        m_gpuTimer.Begin();
+        m_pMesh->RenderMappedInstances(m_lodCounts);
+        m_gpuTimer.End();
 
         RenderFPS();
 
@@ -139,6 +264,14 @@ public:
         case 'q':
             glutLeaveMainLoop();
             break;
+        case 'c':
+            m_cullInstances = !m_cullInstances;
+            printf("Frustum culling %s\n", m_cullInstances ? "on" : "off");
+            break;
+        case 'f':
+            if (m_pMesh->IsReady())
+                SetTextureFilter((m_textureFilter + 1) % 3);
+            break;
         }
     }
 
@@ -149,17 +282,167 @@ public:
     virtual void MouseCB(int Button, int State, int x, int y) {}
 
 private:
+    // Moves the instances, culls them against the view frustum and picks the LOD of every
+    // visible instance from the projected size of its bounding sphere
+    void AnimateInstances() {
+        const float Offset = sinf(m_scale);
+        const Vector3f CameraPos = m_pGameCamera->GetPos();
+        const float MaxScale = std::max(m_instanceScale.x, std::max(m_instanceScale.y, m_instanceScale.z));
+        const float Radius = m_pMesh->GetBoundingRadius() * MaxScale;
+        // Projected diameter in pixels is Radius * ProjScale / Distance
+        const float ProjScale = m_persProjInfo.Height / tanf(ToRadian(m_persProjInfo.FOV / 2.0f));
+
+        m_threadPool.ParallelFor(m_numInstances, [&](unsigned int Begin, unsigned int End) {
+            for (unsigned int i = Begin; i < End; i++) {
+                m_curPositions[i] = m_positions[i];
+                m_curPositions[i].y += Offset * m_velocity[i];
+
+                if (m_cullInstances && !m_pMesh->IsInstanceVisible(m_frustum, m_curPositions[i], m_instanceRot, m_instanceScale)) {
+                    m_instanceLods[i] = INSTANCE_CULLED;
+                    continue;
+                }
+
+                const Vector3f d = m_curPositions[i] - CameraPos;
+                const float Distance = std::max(sqrtf(d.x * d.x + d.y * d.y + d.z * d.z), m_persProjInfo.zNear);
+                m_instanceLods[i] = m_pMesh->SelectLod(Radius * ProjScale / Distance);
+            }
+        });
+    }
+
+    // The closest instances are in the first LOD bucket which has any, which starts the sorted
+    // positions. The textures must be sharp at the point of the bounding sphere nearest to the
+    // camera.
+    void RequestTextureDensity() {
+        unsigned int Lod = 0;
+        while (Lod < MESH_MAX_LODS && m_lodCounts[Lod] == 0)
+            Lod++;
+        if (Lod == MESH_MAX_LODS)
+            return;
+
+        const Vector3f CameraPos = m_pGameCamera->GetPos();
+        float MinDistance = FLT_MAX;
+        for (unsigned int i = 0; i < m_lodCounts[Lod]; i++) {
+            const Vector3f d = m_sortedPositions[i] - CameraPos;
+            MinDistance = std::min(MinDistance, sqrtf(d.x * d.x + d.y * d.y + d.z * d.z));
+        }
+
+        const float MaxScale = std::max(m_instanceScale.x, std::max(m_instanceScale.y, m_instanceScale.z));
+        const float Distance = std::max(MinDistance - m_pMesh->GetBoundingRadius() * MaxScale, m_persProjInfo.zNear);
+        // Pixels per world space unit at Distance, see AnimateInstances
+        const float ProjScale = m_persProjInfo.Height / tanf(ToRadian(m_persProjInfo.FOV / 2.0f));
+        m_pMesh->RequestTextureDensity(ProjScale * MaxScale / (2.0f * Distance));
+    }
+
+    // Counting sort of the instance positions by LOD so that every LOD is one contiguous draw.
+    // The culled instances are dropped, which compacts the visible ones before the upload.
+    void SortInstancesByLod() {
+        unsigned int Counts[MESH_MAX_LODS + 1];
+        unsigned int First[MESH_MAX_LODS + 1];
+        for (unsigned int Lod = 0; Lod <= MESH_MAX_LODS; Lod++)
+            Counts[Lod] = 0;
+        for (unsigned int i = 0; i < m_numInstances; i++)
+            Counts[m_instanceLods[i]]++;
+
+        First[0] = 0;
+        for (unsigned int Lod = 1; Lod <= MESH_MAX_LODS; Lod++)
+            First[Lod] = First[Lod - 1] + Counts[Lod - 1];
+        for (unsigned int i = 0; i < m_numInstances; i++)
+            if (m_instanceLods[i] != INSTANCE_CULLED)
+                m_sortedPositions[First[m_instanceLods[i]]++] = m_curPositions[i];
+
+        m_numVisible = m_numInstances - Counts[INSTANCE_CULLED];
+        for (unsigned int Lod = 0; Lod < MESH_MAX_LODS; Lod++) {
+            m_lodCounts[Lod] = Counts[Lod];
+            m_lodFrameCounts[Lod] += m_lodCounts[Lod];
+        }
+        m_visibleFrameCount += m_numVisible;
+        m_culledFrameCount += Counts[INSTANCE_CULLED];
+    }
+
     void CalcFPS() {
         m_frameCount++;
 
         int time = glutGet(GLUT_ELAPSED_TIME);
         if (time - m_time > 1000) {
             m_fps = (float)m_frameCount * 1000.0f / (time - m_time);
+
+            const PipelineStats& Stats = m_pipeline.GetStats();
+            printf("FPS: %.2f (%.3f ms), matrices per frame: %u rebuilt, %u skipped\n", m_fps, 1000.0f / m_fps,
+                Stats.NumRecomputed / m_frameCount, Stats.NumSkipped / m_frameCount);
+            m_pipeline.ResetStats();
+
+            // The loader thread still builds the entries and LODs of a mesh which isn't ready
+            if (m_pMesh->IsReady())
+                PrintMeshStats();
+
             m_time = time;
             m_frameCount = 0;
         }
     }
 
+    // Per second stats of the draws, only once the mesh is ready
+    void PrintMeshStats() {
+        const RingBufferStats& StreamStats = m_pMesh->GetInstanceStreamStats();
+        printf("Instance fence waits: %u (%.2f ms)\n", StreamStats.NumFenceWaits, StreamStats.WaitTime / 1000.0);
+        m_pMesh->ResetInstanceStreamStats();
+
+        // Compare with and without -bc for the cost of the texture sampling
+        printf("GPU draw time: %.3f ms\n", m_gpuTimer.GetAverageMillis());
+        if (m_benchFilter && m_textureMemoryReported)
+            StepFilterBenchmark(m_gpuTimer.GetAverageMillis());
+        m_gpuTimer.Reset();
+        if (m_pTextureStreamer) {
+            TextureStreamStats TexStats;
+            m_pTextureStreamer->GetStats(TexStats);
+            printf("Streamed textures: %.2f of %.2f MB, %u pending, %u streamed in, %u evicted\n", TexStats.ResidentSize / (1024.0 * 1024.0),
+                m_textureBudget / (1024.0 * 1024.0), TexStats.NumPending, TexStats.NumStreamedIn, TexStats.NumEvicted);
+        }
+        if (!m_textureMemoryReported && m_pTextureLoader->GetNumPending() == 0) {
+            printf("Texture memory: %.2f MB\n", m_pMesh->GetTextureMemory() / (1024.0 * 1024.0));
+            m_textureMemoryReported = true;
+        }
+
+        printf("Instances per LOD:");
+        for (unsigned int Lod = 0; Lod < m_pMesh->GetNumLods(); Lod++) {
+            printf(" %u", m_lodFrameCounts[Lod] / m_frameCount);
+            m_lodFrameCounts[Lod] = 0;
+        }
+        printf("\n");
+
+        printf("Instances visible: %u, culled: %u\n", m_visibleFrameCount / m_frameCount, m_culledFrameCount / m_frameCount);
+        m_visibleFrameCount = 0;
+        m_culledFrameCount = 0;
+
+        if (m_pMesh->HasMeshlets()) {
+            const CullStats& Culling = m_pMesh->GetCullStats();
+            printf("Meshlets per frame: %u drawn, %u outside the frustum, %u back facing\n", Culling.NumMeshletsVisible / m_frameCount,
+                Culling.NumMeshletsOutside / m_frameCount, Culling.NumMeshletsBackFacing / m_frameCount);
+            m_pMesh->ResetCullStats();
+        }
+    }
+
+    void SetTextureFilter(unsigned int Filter) {
+        m_textureFilter = Filter;
+        m_pMesh->SetTextureFilter(m_textureFilter, m_maxAnisotropy);
+        printf("Texture filter: %s\n", GetFilterName(m_textureFilter));
+    }
+
+    // -bench-filter: one second of draws per texture filter once the textures are in, then the
+    // GPU times side by side
+    void StepFilterBenchmark(double GpuMillis) {
+        m_filterTimes[m_textureFilter] = GpuMillis;
+        if (m_textureFilter < TEXTURE_FILTER_ANISOTROPIC) {
+            SetTextureFilter(m_textureFilter + 1);
+            return;
+        }
+
+        printf("GPU draw time per texture filter: %s %.3f ms, %s %.3f ms, %s x%.0f %.3f ms\n",
+            GetFilterName(TEXTURE_FILTER_BILINEAR), m_filterTimes[TEXTURE_FILTER_BILINEAR],
+            GetFilterName(TEXTURE_FILTER_TRILINEAR), m_filterTimes[TEXTURE_FILTER_TRILINEAR],
+            GetFilterName(TEXTURE_FILTER_ANISOTROPIC), m_maxAnisotropy, m_filterTimes[TEXTURE_FILTER_ANISOTROPIC]);
+        glutLeaveMainLoop();
+    }
+
     void RenderFPS() {
         char text[32];
         SNPRINTF(text, sizeof(text), "FPS: %.2f", m_fps);
@@ -169,9 +452,18 @@ private:
     }
 
     void CalcPositions() {
-        for (unsigned int i = 0; i < NUM_ROWS; i++) {
-            for (unsigned int j = 0; j < NUM_COLS; j++) {
-                unsigned int Index = i * NUM_COLS + j;
+        m_positions.resize(m_numInstances);
+        m_velocity.resize(m_numInstances);
+        m_curPositions.resize(m_numInstances);
+        m_sortedPositions.resize(m_numInstances);
+        m_instanceLods.resize(m_numInstances);
+        for (unsigned int Lod = 0; Lod < MESH_MAX_LODS; Lod++)
+            m_lodFrameCounts[Lod] = 0;
+        m_instanceRot.InitRotation(m_instanceRotation.x, m_instanceRotation.y, m_instanceRotation.z);
+
+        for (unsigned int i = 0; i < m_numRows; i++) {
+            for (unsigned int j = 0; j < m_numCols; j++) {
+                unsigned int Index = i * m_numCols + j;
                 m_positions[Index].x = (float)j;
                 m_positions[Index].y = RandomFloat() * 5.0f;
                 m_positions[Index].z = (float)i;
@@ -187,25 +479,112 @@ private:
     float m_scale;
     DirectionalLight m_directionalLight;
     Mesh* m_pMesh;
+    MeshLoader* m_pMeshLoader;
+    TextureLoader* m_pTextureLoader;
+    TextureStreamer* m_pTextureStreamer;
+    size_t m_textureBudget; // Bytes, 0 without streaming
     PersProjInfo m_persProjInfo;
+    Pipeline m_pipeline;
 #ifdef FREETYPE
     FontRenderer m_fontRenderer;
 #endif
     int m_time;
     int m_frameCount;
     float m_fps;
-    Vector3f m_positions[NUM_INSTANCES];
-    float m_velocity[NUM_INSTANCES];
+    unsigned int m_numRows;
+    unsigned int m_numCols;
+    unsigned int m_numInstances;
+    bool m_compactInstances;
+    unsigned int m_meshFlags;
+    Vector3f m_instanceRotation;
+    Vector3f m_instanceScale;
+    std::vector<Vector3f> m_positions;
+    std::vector<float> m_velocity;
+    std::vector<Vector3f> m_curPositions;
+    std::vector<Vector3f> m_sortedPositions;
+    std::vector<unsigned int> m_instanceLods; // INSTANCE_CULLED outside the frustum
+    unsigned int m_lodCounts[MESH_MAX_LODS];
+    unsigned int m_lodFrameCounts[MESH_MAX_LODS];
+    Quaternion m_instanceRot;
+    Frustum m_frustum;
+    bool m_cullInstances;
+    unsigned int m_numVisible;
+    unsigned int m_visibleFrameCount;
+    unsigned int m_culledFrameCount;
+    GpuTimer m_gpuTimer;
+    bool m_textureMemoryReported;
+    unsigned int m_textureFilter;
+    float m_maxAnisotropy;
+    bool m_benchFilter;
+    double m_filterTimes[3];
+    ThreadPool m_threadPool;
 };
 
 int main(int argc, char** argv) {
     srand(time(nullptr));
+    Texture::InitDecoder();
+
+    // Usage: lesson 33 [-bench] [-bench-glb file.glb] [-bench-obj file.obj] [-bench-tex image] [-trs] [-quantize] [-mdi] [-meshlets] [-bc] [-aniso n] [-bench-filter] [-stream MB] [rows cols]
+    unsigned int NumRows = DEFAULT_NUM_ROWS;
+    unsigned int NumCols = DEFAULT_NUM_COLS;
+    bool CompactInstances = false;
+    float MaxAnisotropy = TEXTURE_DEFAULT_MAX_ANISOTROPY;
+    bool BenchFilter = false;
+    size_t TextureBudget = 0;
+    unsigned int MeshFlags = MESH_LOAD_WELD | MESH_LOAD_OPTIMIZE | MESH_LOAD_LODS;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-bench") == 0) {
+            RunBenchmarks();
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-glb") == 0 && i + 1 < argc) {
+            BenchmarkGlbLoad(argv[i + 1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-obj") == 0 && i + 1 < argc) {
+            BenchmarkObjLoad(argv[i + 1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-bench-tex") == 0 && i + 1 < argc) {
+            BenchmarkTextureLoad(argv[i + 1]);
+            return 0;
+        }
+        else if (strcmp(argv[i], "-trs") == 0)
+            CompactInstances = true;
+        else if (strcmp(argv[i], "-quantize") == 0)
+            MeshFlags |= MESH_LOAD_QUANTIZE;
+        else if (strcmp(argv[i], "-mdi") == 0)
+            MeshFlags |= MESH_LOAD_MULTI_DRAW;
+        else if (strcmp(argv[i], "-meshlets") == 0)
+            MeshFlags |= MESH_LOAD_MESHLETS;
+        else if (strcmp(argv[i], "-bc") == 0)
+            MeshFlags |= MESH_LOAD_COMPRESS_TEXTURES;
+        else if (strcmp(argv[i], "-aniso") == 0 && i + 1 < argc)
+            MaxAnisotropy = (float)atof(argv[++i]);
+        else if (strcmp(argv[i], "-bench-filter") == 0)
+            BenchFilter = true;
+        else if (strcmp(argv[i], "-stream") == 0 && i + 1 < argc) {
+            // Streaming works on the block compressed mip chains
+            TextureBudget = (size_t)(atof(argv[++i]) * 1024.0 * 1024.0);
+            MeshFlags |= MESH_LOAD_COMPRESS_TEXTURES;
+        }
+        else if (i + 1 < argc) {
+            NumRows = (unsigned int)atoi(argv[i]);
+            NumCols = (unsigned int)atoi(argv[i + 1]);
+            if (NumRows == 0 || NumCols == 0) {
+                printf("Invalid instance grid %s x %s\n", argv[i], argv[i + 1]);
+                return 1;
+            }
+            i++;
+        }
+    }
 
     GLUTBackendInit(argc, argv);
     if (!GLUTBackendCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, 32, false, "Tutorial 33"))
         return 1;
 
-    Tutorial33* pApp = new Tutorial33();
+    Tutorial33* pApp = new Tutorial33(NumRows, NumCols, CompactInstances, MeshFlags, MaxAnisotropy, BenchFilter, TextureBudget);
     if (!pApp->Init())
         return 1;
     pApp->Run();